@@ -0,0 +1,131 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+#include "hasher.h"
+
+namespace Backup {
+
+/*
+ * 分块备份文件格式 (FBK2)，所有整数均为小端序:
+ *
+ *   [ArchiveHeader 32B]
+ *   [ChunkRecordHeader 16B][存储数据 storedSize B]   x chunkCount       (tar 流)
+ *   [ChunkRecordHeader 16B][存储数据 storedSize B]   x manifestChunks   (文件清单)
+ *   [ChunkIndexEntry 32B]                              x (chunkCount + manifestChunks)
+ *   [ArchiveFooter 48B]
+ *
+ * 每个块独立压缩（Compressor 格式），启用加密时再以块序号派生的 IV 独立加密，
+ * 因此各块可以并行编解码，也可以通过尾部索引随机访问。
+ * 文件清单记录 tar 流中每个条目的路径、头部偏移与内容 SHA-256，与 tar 流共用块编码，
+ * 块序号接在 tar 流之后；索引中清单块的 rawOffset 从 0 开始计算。
+ * 头部 flags 记录是否加密 (ARCHIVE_FLAG_ENCRYPTED) 与是否为增量备份 (ARCHIVE_FLAG_DELTA)。
+ */
+extern const char ARCHIVE_MAGIC[4];         // "FBK2"
+extern const char ARCHIVE_FOOTER_MAGIC[4];  // "FBKE"
+const uint16_t ARCHIVE_VERSION = 2;
+const uint16_t ARCHIVE_FLAG_ENCRYPTED = 0x0001;
+const uint16_t ARCHIVE_FLAG_DELTA = 0x0002;     // 增量备份（tar 流最后一个条目是墓碑列表）
+
+const size_t ARCHIVE_HEADER_SIZE = 32;
+const size_t CHUNK_RECORD_HEADER_SIZE = 16;
+const size_t CHUNK_INDEX_ENTRY_SIZE = 32;
+const size_t ARCHIVE_FOOTER_SIZE = 48;
+const size_t MANIFEST_HEADER_SIZE = 12;
+
+struct ArchiveHeader {
+    uint16_t version = ARCHIVE_VERSION;
+    uint16_t flags = 0;
+    uint8_t algorithm = 0;      // CompressionAlgorithm
+    uint32_t chunkSize = 0;     // 原始数据分块大小
+    uint8_t keyCheck[8] = {0};  // 密钥校验值（仅加密时有效）
+};
+
+struct ChunkRecordHeader {
+    uint32_t rawSize = 0;       // 解压后大小
+    uint32_t storedSize = 0;    // 存储（压缩+加密）后大小
+    uint32_t rawCrc = 0;        // 原始数据 CRC32
+    uint32_t storedCrc = 0;     // 存储数据 CRC32
+};
+
+struct ChunkIndexEntry {
+    uint64_t offset = 0;        // 块记录在文件中的偏移
+    uint64_t rawOffset = 0;     // 块在原始 tar 流中的偏移
+    uint32_t rawSize = 0;
+    uint32_t storedSize = 0;
+    uint32_t rawCrc = 0;
+    uint32_t storedCrc = 0;
+};
+
+struct ArchiveFooter {
+    uint64_t indexOffset = 0;   // 块索引在文件中的偏移
+    uint64_t chunkCount = 0;    // tar 流的块数
+    uint64_t manifestChunks = 0;// 文件清单的块数
+    uint64_t rawSize = 0;       // 原始 tar 流总大小
+    uint64_t manifestSize = 0;  // 文件清单原始大小
+    uint32_t indexCrc = 0;      // 块索引 CRC32
+
+    uint64_t totalChunks() const { return chunkCount + manifestChunks; }
+};
+
+/**
+ * @brief 文件清单中的一项，对应 tar 流中的一个条目
+ */
+struct ManifestEntry {
+    std::string path;           // tar 中的路径
+    char typeflag = '0';        // tar 条目类型
+    uint64_t size = 0;          // 内容大小
+    time_t mtime = 0;           // 修改时间
+    uint64_t headerOffset = 0;  // tar 头部在 tar 流中的偏移
+    bool hasHash = false;       // 是否记录了内容哈希（仅常规文件）
+    Sha256Digest sha256{};      // 内容 SHA-256
+};
+
+/**
+ * @brief 计算 CRC32 (IEEE 802.3)
+ * @param data: 数据指针
+ * @param len: 数据长度
+ * @param crc: 上一段数据的 CRC，用于增量计算
+ */
+uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+// --- 编码 / 解码，解码失败（魔数或校验和错误）抛出 std::runtime_error ---
+void encodeArchiveHeader(const ArchiveHeader& header, uint8_t* out);
+ArchiveHeader decodeArchiveHeader(const uint8_t* in);
+
+void encodeChunkRecordHeader(const ChunkRecordHeader& record, uint8_t* out);
+ChunkRecordHeader decodeChunkRecordHeader(const uint8_t* in);
+
+void encodeChunkIndexEntry(const ChunkIndexEntry& entry, uint8_t* out);
+ChunkIndexEntry decodeChunkIndexEntry(const uint8_t* in);
+
+void encodeArchiveFooter(const ArchiveFooter& footer, uint8_t* out);
+ArchiveFooter decodeArchiveFooter(const uint8_t* in);
+
+std::vector<uint8_t> encodeManifest(const std::vector<ManifestEntry>& entries);
+
+// 分段编码：头部之后依次拼接各项的编码，结果与 encodeManifest 相同（用于逐项写出的场景）
+void encodeManifestHeader(uint64_t count, uint8_t* out);
+void appendManifestEntry(const ManifestEntry& entry, std::vector<uint8_t>& out);
+
+// 分段解码：头部返回条目数；单项返回消耗的字节数，数据不足一项时返回 0（用于逐块读取的场景）
+uint64_t decodeManifestHeader(const uint8_t* in, size_t len);
+size_t decodeManifestEntry(const uint8_t* in, size_t len, ManifestEntry& entry);
+std::vector<ManifestEntry> decodeManifest(const uint8_t* in, size_t len);
+
+/**
+ * @brief 判断文件是否为分块格式 (FBK2)，否则视为旧的整体格式
+ * @param path: 备份文件路径
+ */
+bool isChunkedArchive(const std::string& path);
+
+/**
+ * @brief 读取并校验分块格式备份文件的头部（不需要密码），文件过短或头部损坏时抛出 std::runtime_error
+ * @param path: 备份文件路径
+ */
+ArchiveHeader readArchiveHeader(const std::string& path);
+
+} // namespace Backup
@@ -3,11 +3,76 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <memory>
+#include <filesystem>
+#include <atomic>
 #include "common.h"
 #include "filter.h"
+#include "traverser.h"
+#include "packer.h"
+#include "throttle.h"
 
 namespace Backup {
 
+class Encryptor;
+struct PipelineOptions;
+
+/**
+ * @brief 验证模式
+ */
+enum class VerifyMode {
+    FULL,   // 校验所有块的校验和与 tar 结构
+    DEEP,   // 在 FULL 基础上，按文件清单重新计算并比对每个文件的 SHA-256
+    SAMPLE  // 校验头部/尾部/索引结构，只随机解码一部分块（例行巡检）
+};
+
+/**
+ * @brief 验证结果统计
+ */
+struct VerifyReport {
+    uint64_t chunksTotal = 0;     // tar 流的块总数
+    uint64_t chunksChecked = 0;   // 实际解码校验的块数
+    uint64_t entries = 0;         // 检查过的 tar 条目数
+    uint64_t bytes = 0;           // 检查过的文件内容字节数
+    uint64_t filesHashed = 0;     // 比对过哈希的文件数
+    double coverage = 0.0;        // 解码校验的块占比；SAMPLE 模式下即单个损坏块被发现的概率
+};
+
+/**
+ * @brief 备份与源目录的差异类型
+ */
+enum class DiffKind {
+    ADDED,      // 源目录中有，备份中没有
+    REMOVED,    // 备份中有，源目录中已不存在
+    CHANGED     // 两边都有但不一致
+};
+
+/**
+ * @brief 单个路径的差异
+ */
+struct DiffEntry {
+    std::string path;           // tar 中的路径（含根目录名）
+    DiffKind kind;
+    std::string detail;         // CHANGED 时的原因: type / size / link / content / mode / mtime
+};
+
+/**
+ * @brief 备份与源目录的比对结果
+ */
+struct DiffReport {
+    std::vector<DiffEntry> entries;   // 按路径排序
+    uint64_t compared = 0;            // 备份中的条目数
+    uint64_t hashed = 0;              // 比对过内容哈希的文件数
+
+    bool identical() const { return entries.empty(); }
+};
+
+/**
+ * @brief 增量备份中记录已删除路径（墓碑）的条目名称
+ * 位于 tar 流最后，内容为以 '\0' 分隔的相对源目录的路径
+ */
+extern const char* DELTA_TOMBSTONE_NAME;
+
 /**
  * @brief 备份系统核心控制类
  * 负责协调 Traverser, Packer, Compressor, Encryptor 完成完整的备份与还原流程
@@ -35,18 +100,80 @@ public:
      */
     void setFilter(const Filter& filter);
 
+    /**
+     * @brief 设置打包时读取文件内容的顺序（机械硬盘/RAID 上建议 INODE 或 PHYSICAL）
+     * 只影响读取顺序，归档中的条目顺序不变
+     * @param order: 读取顺序
+     */
+    void setReadOrder(ReadOrder order);
+
+    /**
+     * @brief 设置是否只备份源目录所在的文件系统（不进入其他挂载点）
+     * @param enabled: true 时挂载点只作为空目录记录
+     */
+    void setOneFileSystem(bool enabled);
+
+    /**
+     * @brief 设置不进入的文件系统类型（例如 "proc"、"sysfs"、"tmpfs"、"nfs"）
+     * @param fsTypes: 文件系统类型名称，未知的名称在备份时抛出异常
+     */
+    void setExcludedFileSystems(const std::vector<std::string>& fsTypes);
+
+    /**
+     * @brief 设置备份的资源限制（线程数、读取带宽、系统压力过高时暂停）
+     * 线程优先级（ioIdle、niceLevel）作用于线程而不是本对象，由调用者通过 Throttle::applyThreadPriority 应用
+     * @param policy: 资源限制
+     */
+    void setResourcePolicy(const ResourcePolicy& policy);
+
+    /**
+     * @brief 设置取消标记：备份过程中标记变为 true 时停止并抛出异常，不留下不完整的备份文件
+     * @param cancel: 由调用者持有，生命周期须覆盖备份过程；nullptr 表示不可取消
+     */
+    void setCancelFlag(const std::atomic<bool>* cancel);
+
     /**
      * @brief 执行备份操作
      * 流程: 遍历 -> 打包 -> 压缩 -> 加密 -> 写入文件
+     * 打包之后的各阶段以流水线方式并发执行，内存占用与归档大小无关
      * @param srcDir: 源目录路径
      * @param dstFile: 目标备份文件路径
      * @return true 成功, false 失败
      */
     bool backup(const std::string& srcDir, const std::string& dstPath);
 
+    /**
+     * @brief 执行增量备份：只打包变化的文件，并记录已删除的路径
+     * 归档格式与完整备份相同（根目录条目 + 变化的条目 + 墓碑条目），耗时与变化量成正比，与源目录大小无关。
+     * 已不存在的变化路径按删除处理；被删除路径的上级目录在源目录中也已不存在时一并记为删除。
+     * 新建的空目录不会被记录，由之后的完整备份补上
+     * @param srcDir: 源目录路径
+     * @param changed: 新增或修改的路径（相对源目录）
+     * @param removed: 已删除的路径（相对源目录）
+     * @param dstFile: 目标备份文件路径
+     * @return true 成功, false 失败
+     */
+    bool backupDelta(const std::string& srcDir, const std::vector<std::string>& changed,
+                     const std::vector<std::string>& removed, const std::string& dstFile);
+
+    /**
+     * @brief 判断备份文件是否为增量备份（按头部的 ARCHIVE_FLAG_DELTA 标记判断，旧格式总是完整备份）
+     * @param backupFile: 备份文件路径
+     */
+    bool isDeltaArchive(const std::string& backupFile);
+
+    /**
+     * @brief 还原一条备份链：先还原完整备份，再依次应用其后的增量备份（覆盖变化的文件、删除墓碑中的路径）
+     * @param archives: 按时间顺序排列的备份文件，第一个必须是完整备份
+     * @param dstDir: 还原目标目录
+     * @return true 成功, false 失败
+     */
+    bool restoreChain(const std::vector<std::string>& archives, const std::string& dstDir);
+
     /**
      * @brief 执行还原操作
      * 流程: 读取文件 -> 解密 -> 解压 -> 解包 -> 写入目录
+     * 分块格式的备份以流水线方式还原，解包与后续块的解码同时进行
      * @param srcFile: 备份文件路径
      * @param dstDir: 还原目标目录
      * @return true 成功, false 失败
@@ -55,25 +182,86 @@ public:
 
     /**
      * @brief 验证备份文件（基本要求：备份验证）
-     * 流程: 模拟还原流程（不写入磁盘），校验解包后的文件哈希或结构
-     * 目前实现简化版：能否成功解密并解压出合法的 Tar 包结构
+     * 等价于 verify(backupFile, VerifyMode::DEEP)，失败时抛出异常
      * @param backupFile: 备份文件路径
-     * @return true 验证通过, false 文件损坏或密码错误
+     * @return true 验证通过
      */
     bool verify(const std::string& backupFile);
 
+    /**
+     * @brief 流式验证备份文件，不写入磁盘、不在内存中保留整个归档
+     * 流程: 并行解码并校验每个块 -> 逐个校验 tar 头部校验和与数据对齐 ->（DEEP）比对文件哈希
+     * SAMPLE 模式只校验结构并随机解码约 fraction 比例的块，块内的 tar 头部与完整文件按清单比对
+     * 文件损坏、结构错误或密码错误时抛出 std::runtime_error
+     * @param backupFile: 备份文件路径
+     * @param mode: 验证模式
+     * @param fraction: SAMPLE 模式下的抽样比例 (0, 1]，其他模式忽略
+     * @return 验证统计
+     */
+    VerifyReport verify(const std::string& backupFile, VerifyMode mode, double fraction = 1.0);
+
+    /**
+     * @brief 比对备份与当前源目录，不还原到磁盘
+     * 流程: 排序遍历源目录 + 流式读取备份，两边按先序归并 -> 先比对元数据 -> 元数据不同（大小相同）或 deep 时比对内容哈希
+     * 内存占用与文件数无关；旧的整体格式先在内存中按先序排列条目
+     * 启用了过滤器时，源目录先经过同样的过滤，与备份时的文件集合一致
+     * @param backupFile: 备份文件路径
+     * @param srcDir: 源目录路径
+     * @param deep: 为 true 时所有常规文件都比对内容哈希
+     * @return 差异列表
+     */
+    DiffReport diff(const std::string& backupFile, const std::string& srcDir, bool deep = false);
+
 private:
     int m_compressionAlgo;      // 当前选用的压缩算法
     std::string m_password;     // 加密密码
     bool m_isEncrypted;         // 是否启用加密
     Filter m_filter;            // 备份过滤器
+    std::shared_ptr<const CompiledFilter> m_compiledFilter;  // 编译后的过滤器（setFilter 时生成）
+    ReadOrder m_readOrder;      // 打包时的读取顺序
+    bool m_oneFileSystem;       // 不跨越文件系统
+    std::vector<std::string> m_excludedFileSystems;  // 不进入的文件系统类型
+    const std::atomic<bool>* m_cancel = nullptr;     // 取消标记（不持有）
+    ResourcePolicy m_resources;                      // 备份的资源限制
+
+    // 按资源限制生成流水线参数
+    PipelineOptions pipelineOptions() const;
+
+    // 按资源限制包装 tar 流的接收者（无限制时原样返回）
+    static ArchiveSink throttled(Throttle& throttle, const ArchiveSink& sink, const ResourcePolicy& policy);
+
+    // 取消标记已置位时抛出异常
+    void checkCancelled() const;
+
+    // 遍历选项（启用过滤器时带上排除规则）
+    TraverseOptions traverseOptions() const;
+
+    // 根据当前密码创建加密器（未设置密码时返回 nullptr）
+    std::unique_ptr<Encryptor> makeEncryptor();
+
+    // 旧的整体格式：整文件解密 + 解压，返回 tar 数据
+    std::vector<uint8_t> decodeLegacy(const std::string& path);
+
+    // 还原单个备份，返回还原后的根目录
+    std::filesystem::path restoreArchive(const std::string& srcFile, const std::string& dstDir);
+
+    // 把增量备份应用到已还原的根目录上
+    void applyDelta(const std::string& deltaFile, const std::filesystem::path& targetRoot);
+
+    // 增量备份中的相对路径在目标根目录下的位置；绝对路径、含 ".." 或经过符号链接的路径抛出 std::runtime_error
+    static std::filesystem::path pathInside(const std::filesystem::path& root, const std::filesystem::path& relative);
+
+    // 计算还原的最终目录（同名时追加 _1, _2 ...），返回实际解包目录
+    static std::string prepareRestoreDir(const std::string& dstDir, const std::string& rootName, std::filesystem::path& finalDestPath);
+
+    // 抽样验证（仅分块格式）
+    VerifyReport verifySample(const std::string& backupFile, double fraction);
 
-    // 辅助函数：读写文件
-    std::vector<uint8_t> readFile(const std::string& path);
-    bool writeFile(const std::string& path, const std::vector<uint8_t>& data);
+    // 源目录在备份中的根目录名称
+    static std::string sourceRootName(const std::string& srcDir);
 
-    // 应用过滤器
-    std::vector<FileInfo> applyFilter(const std::vector<FileInfo>& files);
+    // 从第一个 tar 头部中读取根目录名称
+    static std::string readRootName(const uint8_t* tarData, size_t size);
 };
 
 } // namespace Backup
\ No newline at end of file
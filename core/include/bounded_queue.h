@@ -0,0 +1,144 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+namespace Backup {
+
+/**
+ * @brief 有界阻塞队列（流水线各阶段之间的缓冲区）
+ * 队列满时 push 阻塞，从而把背压传递给上游阶段；close 后所有等待者立即返回。
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : m_capacity(capacity ? capacity : 1) {}
+
+    /**
+     * @brief 入队（队列满时阻塞）
+     * @return 队列已关闭时返回 false
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed) return false;
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief 出队（队列空时阻塞）
+     * @return 队列已关闭且已取空时返回 false
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    // 关闭队列：不再接受新元素，已入队的元素仍可被取出
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+    // 中止：丢弃所有元素并唤醒所有等待者
+    void abort() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_items.clear();
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+private:
+    size_t m_capacity;
+    bool m_closed = false;
+    std::deque<T> m_items;
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+};
+
+/**
+ * @brief 有界重排序缓冲区
+ * 并行工作线程乱序完成的块按序号放入，消费者严格按序号取出。
+ * 序号超出窗口 [next, next + window) 的 put 会阻塞，保证内存占用有上限。
+ */
+template <typename T>
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(size_t window) : m_window(window ? window : 1) {}
+
+    /**
+     * @brief 放入序号为 seq 的元素
+     * @return 缓冲区已中止时返回 false
+     */
+    bool put(uint64_t seq, T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_canPut.wait(lock, [&] { return m_aborted || seq < m_next + m_window; });
+        if (m_aborted) return false;
+        m_items.emplace(seq, std::move(item));
+        if (seq == m_next) m_canTake.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief 按序取出下一个元素
+     * @return 全部元素已取完（finish 之后）或已中止时返回 false
+     */
+    bool take(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_canTake.wait(lock, [this] {
+            return m_aborted || m_items.count(m_next) || (m_finished && m_next >= m_total);
+        });
+        if (m_aborted) return false;
+        auto it = m_items.find(m_next);
+        if (it == m_items.end()) return false;
+        item = std::move(it->second);
+        m_items.erase(it);
+        ++m_next;
+        m_canPut.notify_all();
+        return true;
+    }
+
+    // 生产者全部结束后调用：total 为元素总数
+    void finish(uint64_t total) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished = true;
+        m_total = total;
+        m_canTake.notify_all();
+    }
+
+    void abort() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_aborted = true;
+        m_items.clear();
+        m_canPut.notify_all();
+        m_canTake.notify_all();
+    }
+
+private:
+    size_t m_window;
+    uint64_t m_next = 0;
+    uint64_t m_total = 0;
+    bool m_finished = false;
+    bool m_aborted = false;
+    std::map<uint64_t, T> m_items;
+    std::mutex m_mutex;
+    std::condition_variable m_canPut;
+    std::condition_variable m_canTake;
+};
+
+} // namespace Backup
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <set>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+
+namespace Backup {
+
+/**
+ * @brief 一段时间内累积的变化
+ */
+struct ChangeSet {
+    std::set<std::string> paths;    // 发生变化的相对路径（文件或目录）
+    bool rescan = false;            // 事件可能丢失（队列溢出、目录被移走等），需要完整重新扫描
+
+    bool empty() const { return paths.empty() && !rescan; }
+};
+
+/**
+ * @brief 事件驱动的目录变化监视器（Linux 下基于递归 inotify）
+ * 后台线程阻塞等待内核事件，把变化的路径累积到集合中并通过回调通知调用者，
+ * 空闲时不占用 CPU。新建或移入的目录会自动加入监视，其中已有的文件同时记为变化。
+ * 队列溢出或目录被移出时置 rescan 标记；监视数量超过系统上限时 active() 变为 false，
+ * 调用者应退回到定期完整扫描。
+ */
+class ChangeWatcher {
+public:
+    using Callback = std::function<void()>;
+
+    /**
+     * @param rootDir: 被监视的根目录
+     * @param onChange: 有新变化时在后台线程中调用（应当只做轻量的通知）
+     */
+    explicit ChangeWatcher(const std::string& rootDir, Callback onChange = Callback());
+    ~ChangeWatcher();
+
+    ChangeWatcher(const ChangeWatcher&) = delete;
+    ChangeWatcher& operator=(const ChangeWatcher&) = delete;
+
+    // 当前平台是否支持事件驱动监视
+    static bool supported();
+
+    /**
+     * @brief 为整棵目录树建立监视并启动后台线程
+     * @return 平台不支持、根目录无法监视或监视数量超限时返回 false
+     */
+    bool start();
+    void stop();
+
+    // 是否仍在正常监视（失败后调用者应改用完整扫描）
+    bool active() const { return m_active; }
+
+    bool hasChanges() const;
+
+    /**
+     * @brief 取出并清空累积的变化
+     */
+    ChangeSet takeChanges();
+
+    size_t watchCount() const { return m_watchCount; }
+
+private:
+    void run();
+    void handleEvents(const char* buffer, size_t len);
+    bool addWatchTree(const std::string& relativeDir, bool markFiles);
+    void removeWatchTree(const std::string& relativeDir);
+    void markChanged(const std::string& relativePath);
+    void markRescan();
+    std::string fullPath(const std::string& relativePath) const;
+
+    std::string m_root;
+    Callback m_onChange;
+    int m_fd = -1;                  // inotify 描述符
+    int m_wakeFd = -1;              // 用于唤醒后台线程退出
+    std::thread m_thread;
+    std::atomic<bool> m_active{false};
+
+    // 监视描述符 -> 目录相对路径（只在后台线程与 start 中访问）
+    std::unordered_map<int, std::string> m_watches;
+    std::atomic<size_t> m_watchCount{0};
+
+    mutable std::mutex m_mutex;     // 保护 m_changes
+    ChangeSet m_changes;
+};
+
+} // namespace Backup
@@ -31,6 +31,9 @@ struct FileInfo {
     std::string linkTarget;     // 符号链接的目标路径（仅用于符号链接）
     unsigned int deviceMajor;   // 设备主号（仅用于字符设备和块设备）
     unsigned int deviceMinor;   // 设备副号（仅用于字符设备和块设备）
+    uint64_t inode = 0;         // inode 号（用于按 inode 顺序读取，0 表示未知）
+    int64_t mtimeNs = 0;        // 修改时间（纳秒，用于变化检测，0 表示未知）
+    int64_t ctimeNs = 0;        // 状态变化时间（纳秒）
 };
 
 } // namespace Backup
\ No newline at end of file
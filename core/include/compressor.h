@@ -45,6 +45,14 @@ public:
      */
     std::vector<uint8_t> decompress(const std::vector<uint8_t>& input);
 
+    /**
+     * @brief 解压缩数据（直接读取外部缓冲区，例如内存映射的备份文件）
+     * @param input: 压缩数据指针
+     * @param len: 压缩数据长度
+     * @return 解压缩后的数据缓冲区
+     */
+    std::vector<uint8_t> decompress(const uint8_t* input, size_t len);
+
 private:
 
     // 联合压缩实现
@@ -37,6 +37,39 @@ public:
      */
     std::vector<uint8_t> decrypt(const std::vector<uint8_t>& inData);
 
+    /**
+     * @brief 解密外部缓冲区中的数据块（例如内存映射的备份文件）。
+     * @param inData: 密文数据指针。
+     * @param len: 密文长度。
+     * @return 明文数据。
+     */
+    std::vector<uint8_t> decrypt(const uint8_t* inData, size_t len);
+
+    /**
+     * @brief 加密分块格式中的单个数据块。
+     * 每个块使用由块序号派生的独立 IV；每次调用使用独立的上下文，可被多个线程并发调用。
+     * @param data: 明文数据指针。
+     * @param len: 明文长度。
+     * @param chunkIndex: 块序号。
+     * @return 密文数据（包含填充）。
+     */
+    std::vector<uint8_t> encryptChunk(const uint8_t* data, size_t len, uint64_t chunkIndex) const;
+
+    /**
+     * @brief 解密分块格式中的单个数据块（线程安全）。
+     * @param data: 密文数据指针。
+     * @param len: 密文长度。
+     * @param chunkIndex: 块序号。
+     * @return 明文数据。
+     */
+    std::vector<uint8_t> decryptChunk(const uint8_t* data, size_t len, uint64_t chunkIndex) const;
+
+    /**
+     * @brief 生成 8 字节密钥校验值，写入备份头部以便在解密前识别错误密码。
+     * @param out: 输出缓冲区（8 字节）。
+     */
+    void keyCheck(uint8_t* out) const;
+
 private:
     // 实现结构体的前向声明（PImpl 惯用法）
     struct Impl;
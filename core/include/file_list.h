@@ -0,0 +1,134 @@
+#pragma once
+
+#include "common.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+namespace Backup {
+
+/**
+ * @brief 字符串驻留池：相同的字符串只保存一份，以下标引用
+ */
+class StringPool {
+public:
+    uint32_t intern(const std::string& value);
+    const std::string& get(uint32_t id) const { return m_values[id]; }
+    size_t size() const { return m_values.size(); }
+    size_t memoryUsage() const;
+
+private:
+    std::vector<std::string> m_values;
+    std::unordered_map<std::string, uint32_t> m_ids;
+};
+
+/**
+ * @brief 紧凑的文件列表
+ * 每个条目只保存文件名（存放在连续的字符区中）与父目录下标，完整路径按需拼接；
+ * 用户名/组名驻留，数值字段按列（结构数组）存放，链接目标与设备号稀疏存放。
+ * 单个条目约 75 字节 + 文件名长度，而 FileInfo 至少需要五个 std::string。
+ * 条目必须按先序追加（父目录在子条目之前）。
+ */
+class FileList {
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    FileList() = default;
+
+    /**
+     * @brief 设置遍历根目录，absolutePath(i) = root + "/" + 相对路径
+     */
+    void setRoot(const std::string& rootDir) { m_root = rootDir; }
+    const std::string& root() const { return m_root; }
+
+    /**
+     * @brief 设置相对路径前缀（例如备份时的根目录名），relativePath(i) = prefix + "/" + 相对路径
+     * 只保存一份，不改写任何条目
+     */
+    void setPathPrefix(const std::string& prefix) { m_prefix = prefix; }
+    const std::string& pathPrefix() const { return m_prefix; }
+
+    /**
+     * @brief 追加一个条目，只使用 relativePath 的最后一段作为文件名
+     * @param info: 文件元数据
+     * @param parent: 父目录条目的下标，顶层条目为 NO_PARENT
+     * @return 新条目的下标
+     */
+    uint32_t append(const FileInfo& info, uint32_t parent = NO_PARENT);
+
+    void reserve(size_t entries, size_t nameBytes = 0);
+
+    size_t size() const { return m_parent.size(); }
+    bool empty() const { return m_parent.empty(); }
+
+    // --- 按列访问（name 为相对父条目的路径，通常是单段文件名）---
+    uint32_t parent(size_t i) const { return m_parent[i]; }
+    std::string name(size_t i) const { return std::string(m_names.data() + m_nameOffset[i], m_nameLength[i]); }
+    FileType type(size_t i) const { return static_cast<FileType>(m_type[i]); }
+    uint64_t fileSize(size_t i) const { return m_size[i]; }
+    mode_t permissions(size_t i) const { return m_permissions[i]; }
+    time_t lastModified(size_t i) const { return m_mtime[i]; }
+    uint64_t inode(size_t i) const { return m_inode[i]; }
+    int64_t mtimeNs(size_t i) const { return m_mtimeNs[i]; }
+    int64_t ctimeNs(size_t i) const { return m_ctimeNs[i]; }
+    uid_t uid(size_t i) const { return m_uid[i]; }
+    gid_t gid(size_t i) const { return m_gid[i]; }
+    const std::string& userName(size_t i) const { return m_strings.get(m_user[i]); }
+    const std::string& groupName(size_t i) const { return m_strings.get(m_group[i]); }
+    std::string linkTarget(size_t i) const;
+
+    // 拼接完整路径（沿父目录链向上）
+    std::string relativePath(size_t i) const;
+    std::string absolutePath(size_t i) const;
+
+    /**
+     * @brief 还原为完整的 FileInfo（临时对象，用于打包或过滤单个条目）
+     */
+    FileInfo at(size_t i) const;
+
+    /**
+     * @brief 按条件筛选，返回新的列表（父目录下标重新映射）
+     * 每个条目独立判定，结果与逐个过滤 FileInfo 列表相同
+     */
+    FileList filter(const std::function<bool(const FileInfo&)>& keep) const;
+
+    /**
+     * @brief 转换为 FileInfo 列表（兼容旧接口）
+     */
+    std::vector<FileInfo> toVector() const;
+
+    // 估算占用的内存（字节）
+    size_t memoryUsage() const;
+
+private:
+    std::string buildPath(size_t i, const std::string& prefix) const;
+    uint32_t appendEntry(const FileInfo& info, uint32_t parent, const char* name, size_t nameLength);
+
+    std::string m_root;
+    std::string m_prefix;
+
+    std::vector<char> m_names;              // 文件名字符区
+    std::vector<uint32_t> m_parent;
+    std::vector<uint64_t> m_nameOffset;
+    std::vector<uint16_t> m_nameLength;
+    std::vector<uint8_t> m_type;
+    std::vector<uint64_t> m_size;
+    std::vector<uint32_t> m_permissions;
+    std::vector<int64_t> m_mtime;
+    std::vector<uint64_t> m_inode;
+    std::vector<int64_t> m_mtimeNs;
+    std::vector<int64_t> m_ctimeNs;
+    std::vector<uint32_t> m_uid;
+    std::vector<uint32_t> m_gid;
+    std::vector<uint32_t> m_user;           // StringPool 下标
+    std::vector<uint32_t> m_group;
+
+    StringPool m_strings;
+    std::unordered_map<uint32_t, std::string> m_links;                          // 仅符号链接
+    std::unordered_map<uint32_t, std::pair<unsigned int, unsigned int>> m_devices;  // 仅设备号非 0 的条目
+};
+
+} // namespace Backup
@@ -2,8 +2,12 @@
 
 #include <string>
 #include <vector>
+#include <array>
+#include <regex>
+#include <unordered_set>
 #include <cstdint>
 #include <ctime>
+#include "common.h"
 
 namespace Backup {
 
@@ -21,5 +25,94 @@ namespace Backup {
         time_t endTime = 0;
 
         std::string userName;
+
+        // gitignore 风格的排除规则（相对源目录），由 Traverser 在遍历时求值，
+        // 被排除的目录不会被打开，其下的文件也不会被 stat。
+        // 支持 * ? [...] **，"!" 取反，结尾 "/" 只匹配目录，以 "/" 开头或中间含 "/" 时相对根目录匹配
+        std::vector<std::string> excludePatterns;
+    };
+
+    /**
+     * @brief Aho-Corasick 多关键词匹配自动机
+     * 构建为稠密状态转移表，匹配时每个字节只查一次表，与关键词个数无关。
+     */
+    class KeywordMatcher {
+    public:
+        KeywordMatcher() = default;
+        explicit KeywordMatcher(const std::vector<std::string>& keywords);
+
+        bool empty() const { return m_next.empty(); }
+
+        // text 中是否包含任意一个关键词
+        bool search(const std::string& text) const;
+
+    private:
+        std::vector<std::array<int32_t, 256>> m_next;  // 状态转移表（已合并失败链接）
+        std::vector<bool> m_output;                    // 该状态是否匹配到关键词
+    };
+
+    /**
+     * @brief 编译后的过滤器
+     * 所有规则在构造时编译一次：后缀放入按长度分组的哈希集合，关键词构建 Aho-Corasick 自动机，
+     * 正则只编译一次（std::regex::optimize），排除规则按类型分为字面量 / 后缀 / 通配三类。
+     * 构造后只读，可在多个线程中共享。
+     */
+    class CompiledFilter {
+    public:
+        CompiledFilter() = default;
+
+        /**
+         * @brief 编译过滤规则，正则或排除规则无效时抛出 std::runtime_error
+         */
+        explicit CompiledFilter(const Filter& filter);
+
+        bool enabled() const { return m_enabled; }
+        bool hasExcludes() const { return !m_rules.empty(); }
+
+        /**
+         * @brief 排除规则判定（遍历时调用，无需 stat）
+         * @param relativePath: 相对源目录的路径
+         * @param isDirectory: 是否为目录
+         * @return true 表示应排除（目录则整棵子树被剪除）
+         */
+        bool excluded(const std::string& relativePath, bool isDirectory) const;
+
+        /**
+         * @brief 其余过滤条件（大小、时间、用户、后缀、关键词、正则），目录总是保留
+         * 按代价从低到高依次判断，正则放在最后
+         */
+        bool matches(const FileInfo& file) const;
+
+    private:
+        struct ExcludeRule {
+            enum class Kind { NAME, SUFFIX, GLOB };
+            Kind kind = Kind::GLOB;
+            std::string pattern;    // NAME: 文件名；SUFFIX: 后缀（不含 '*'）；GLOB: 通配模式
+            bool negate = false;
+            bool dirOnly = false;
+            bool anchored = false;  // 匹配完整相对路径，而不是文件名
+        };
+
+        bool ruleMatches(const ExcludeRule& rule, const std::string& path, const std::string& name, bool isDirectory) const;
+
+        bool m_enabled = false;
+        Filter m_filter;
+
+        std::vector<std::unordered_set<std::string>> m_suffixesByLength;  // 下标为后缀长度
+        KeywordMatcher m_keywords;
+        bool m_useRegex = false;
+        std::regex m_regex;
+
+        std::vector<ExcludeRule> m_rules;
+        bool m_hasNegation = false;
+        // 无取反规则时的快速路径
+        std::unordered_set<std::string> m_excludeNames;
+        std::unordered_set<std::string> m_excludeDirNames;
+        std::vector<std::string> m_excludeNameSuffixes;
     };
-}
\ No newline at end of file
+
+    /**
+     * @brief gitignore 风格的通配匹配：* ? 不跨越 '/'，** 可以匹配任意层目录，支持 [...] 与 '\' 转义
+     */
+    bool globMatch(const std::string& pattern, const std::string& text);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace Backup {
+
+using Sha256Digest = std::array<uint8_t, 32>;
+
+/**
+ * @brief 基于 OpenSSL 的增量 SHA-256 计算器
+ * 用于在打包时计算每个文件的内容哈希，以及在验证/比对时重新计算。
+ */
+class Sha256 {
+public:
+    Sha256();
+    ~Sha256();
+
+    Sha256(const Sha256&) = delete;
+    Sha256& operator=(const Sha256&) = delete;
+
+    // 开始新的计算（丢弃之前的状态）
+    void reset();
+
+    // 追加数据
+    void update(const uint8_t* data, size_t len);
+
+    // 结束计算并返回摘要，之后需要 reset() 才能再次使用
+    Sha256Digest finish();
+
+    /**
+     * @brief 计算文件内容的 SHA-256，文件无法读取时抛出 std::runtime_error
+     * @param path: 文件路径
+     */
+    static Sha256Digest ofFile(const std::string& path);
+
+private:
+    // 实现结构体的前向声明（PImpl 惯用法）
+    struct Impl;
+    Impl* pImpl;
+};
+
+} // namespace Backup
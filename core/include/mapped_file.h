@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace Backup {
+
+/**
+ * @brief 只读内存映射文件 (RAII)
+ * 用于还原与验证：解密、解压阶段直接从映射区读取数据，避免整文件的堆分配与拷贝。
+ */
+class MappedFile {
+public:
+    enum class Access {
+        SEQUENTIAL,  // 顺序读取整个文件 (MADV_SEQUENTIAL | MADV_WILLNEED)
+        RANDOM       // 按索引随机读取部分块 (MADV_RANDOM)
+    };
+
+    /**
+     * @brief 映射整个文件，失败时抛出 std::runtime_error
+     * @param path: 文件路径
+     * @param access: 访问模式，用于向内核提供预读建议
+     */
+    explicit MappedFile(const std::string& path, Access access = Access::SEQUENTIAL);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+} // namespace Backup
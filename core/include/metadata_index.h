@@ -0,0 +1,135 @@
+#pragma once
+
+#include "common.h"
+#include "hasher.h"
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <sys/stat.h>
+
+namespace Backup {
+
+/**
+ * @brief 元数据索引中一个文件的记录
+ */
+struct MetadataRecord {
+    uint64_t size = 0;
+    int64_t mtimeNs = 0;        // 修改时间（纳秒）
+    int64_t ctimeNs = 0;        // 状态变化时间（纳秒）
+    uint64_t inode = 0;
+    bool hasHash = false;       // 是否记录了内容哈希
+    Sha256Digest sha256{};      // 内容 SHA-256
+
+    // 元数据是否相同（不比较内容哈希）
+    bool sameMetadata(const MetadataRecord& other) const {
+        return size == other.size && mtimeNs == other.mtimeNs && ctimeNs == other.ctimeNs && inode == other.inode;
+    }
+};
+
+/**
+ * @brief 持久化的文件元数据索引（每个任务一个文件）
+ * 路径哈希 -> (size, mtime_ns, ctime_ns, inode, 内容哈希)，以开放寻址哈希表的形式直接存放在
+ * 内存映射的文件中：打开时无需解析，更新直接写入映射区，进程重启后立即可用。
+ * 每个文件在热路径上只占 48 字节的槽位，内容哈希存放在按需换入的平行区域。
+ * 装载率超过 70% 或删除标记过多时重建为新文件并原子替换。
+ * 文件以本机字节序存储，不能在不同字节序的机器之间共享。非线程安全。
+ */
+class MetadataIndex {
+public:
+    /**
+     * @brief 打开或创建索引文件，格式错误时抛出 std::runtime_error
+     * @param path: 索引文件路径
+     */
+    explicit MetadataIndex(const std::string& path);
+    ~MetadataIndex();
+
+    MetadataIndex(const MetadataIndex&) = delete;
+    MetadataIndex& operator=(const MetadataIndex&) = delete;
+
+    /**
+     * @brief 由文件信息生成记录（不含内容哈希）
+     */
+    static MetadataRecord recordOf(const FileInfo& info);
+
+    /**
+     * @brief 由 lstat 结果生成记录（不含内容哈希）
+     */
+    static MetadataRecord recordOf(const struct stat& fileStat);
+
+    /**
+     * @brief 路径的 64 位哈希（0 和 1 保留为空槽与删除标记）
+     */
+    static uint64_t hashPath(const std::string& relativePath);
+
+    const std::string& path() const { return m_path; }
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+
+    /**
+     * @brief 查找记录
+     * @return 不存在时返回 false
+     */
+    bool find(const std::string& relativePath, MetadataRecord& record) const;
+
+    /**
+     * @brief 插入或更新记录（同时标记为本轮扫描已见）
+     * 元数据未变时保留原有的内容哈希
+     * @return 新文件或元数据发生变化时返回 true
+     */
+    bool update(const std::string& relativePath, const MetadataRecord& record);
+
+    /**
+     * @brief 记录文件的内容哈希（文件不存在时忽略）
+     */
+    void setContentHash(const std::string& relativePath, const Sha256Digest& sha256);
+
+    /**
+     * @brief 删除记录
+     * @return 记录存在时返回 true
+     */
+    bool remove(const std::string& relativePath);
+
+    /**
+     * @brief 开始一轮完整扫描：之后通过 update 标记仍存在的文件
+     */
+    void beginScan();
+
+    /**
+     * @brief 结束扫描：删除本轮未被 update 的记录（已删除的文件）
+     * @return 删除的记录数
+     */
+    size_t endScan();
+
+    /**
+     * @brief 清空索引
+     */
+    void clear();
+
+    /**
+     * @brief 将映射区写回磁盘
+     * @param wait: 为 true 时等待写入完成
+     */
+    void sync(bool wait = false);
+
+private:
+    struct Header;
+    struct Slot;
+
+    MetadataIndex(const std::string& path, size_t capacity);
+
+    static size_t fileSizeFor(size_t capacity);
+    void open(size_t capacity);
+    void unmap();
+    void rebuild(size_t capacity);
+    Slot* slots() const;
+    uint8_t* digestOf(const Slot* slot) const;
+    Slot* lookup(uint64_t hash) const;
+    Slot* insertSlot(uint64_t hash);
+
+    std::string m_path;
+    uint8_t* m_data = nullptr;
+    size_t m_mapSize = 0;
+    Header* m_header = nullptr;
+};
+
+} // namespace Backup
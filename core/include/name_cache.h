@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <shared_mutex>
+#include <sys/types.h>
+
+namespace Backup {
+
+/**
+ * @brief 线程安全的 uid/gid -> 名称缓存
+ * 每个 uid/gid 只查询一次 NSS（getpwuid_r / getgrgid_r），之后的查询只读哈希表，
+ * 扫描耗时不再依赖目录服务（LDAP/SSSD）的延迟。查询失败的结果同样缓存，名称记为数字 ID。
+ */
+class NameCache {
+public:
+    // 进程内共享的实例
+    static NameCache& instance();
+
+    std::string userName(uid_t uid);
+    std::string groupName(gid_t gid);
+
+    // 清空缓存（例如系统用户发生变化后）
+    void clear();
+
+private:
+    NameCache() = default;
+
+    std::shared_mutex m_mutex;
+    std::unordered_map<uid_t, std::string> m_users;
+    std::unordered_map<gid_t, std::string> m_groups;
+};
+
+} // namespace Backup
@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <functional>
 #include <cstdint>
 
 namespace Backup {
@@ -13,6 +14,50 @@ const int BLOCK_SIZE = 512;
 extern const char* MAGIC; 
 extern const char* VERSION;
 
+/**
+ * @brief 归档输出回调：按顺序接收连续的tar字节流（文件、内存缓冲或流水线的下一阶段）。
+ */
+using ArchiveSink = std::function<void(const char* data, size_t len)>;
+
+/**
+ * @brief 归档输入回调：读取最多len字节到buf，返回实际读取的字节数，返回0表示流已结束。
+ */
+using ArchiveSource = std::function<size_t(char* buf, size_t len)>;
+
+/**
+ * @brief 从source中读取恰好len字节（除非流提前结束）。
+ * @return 实际读取的字节数。
+ */
+size_t readFully(const ArchiveSource& source, char* buf, size_t len);
+
+/**
+ * @brief tar条目的元数据（由TarWalker从头部解析得到）
+ */
+struct TarEntry {
+    std::string path;           // 完整路径 (prefix + "/" + name)
+    char typeflag = '0';        // 条目类型
+    uint64_t size = 0;          // 数据区大小（仅常规文件非0）
+    mode_t mode = 0;            // 权限
+    time_t mtime = 0;           // 修改时间
+    uid_t uid = 0;              // 用户ID
+    gid_t gid = 0;              // 组ID
+    std::string userName;       // 用户名
+    std::string groupName;      // 组名
+    std::string linkTarget;     // 符号链接目标
+};
+
+/**
+ * @brief 打包时读取文件内容的顺序
+ * 在机械硬盘与大文件系统上，按目录项顺序读取小文件会导致大量寻道；
+ * INODE / PHYSICAL 模式把一批小文件按 inode 号或物理位置 (FIEMAP) 排序后读入内存，
+ * 再按原来的逻辑顺序写入归档，归档内容与 TRAVERSAL 模式完全相同。
+ */
+enum class ReadOrder {
+    TRAVERSAL,  // 按遍历顺序逐个读取
+    INODE,      // 每批按 inode 号排序读取
+    PHYSICAL    // 每批按第一个数据区的物理偏移排序读取（FIEMAP 不可用时退回 inode 号）
+};
+
 /**
  * @brief Packer类负责使用.tar格式(POSIX UStar)对文件进行归档/提取操作。
  */
@@ -29,6 +74,36 @@ public:
      */
     bool pack(const std::vector<FileInfo>& files, const std::string& outputArchivePath);
 
+    /**
+     * @brief 将文件列表打包为tar字节流并依次交给sink，不落地临时文件。
+     * @param files: 由Traverser收集的文件元数据列表。
+     * @param sink: tar字节流的接收者。
+     */
+    void pack(const std::vector<FileInfo>& files, const ArchiveSink& sink);
+
+    /**
+     * @brief 追加单个条目（头部 + 数据块）到tar字节流，用于边遍历边打包。
+     * @param file: 文件元数据。
+     * @param sink: tar字节流的接收者。
+     */
+    void packEntry(const FileInfo& file, const ArchiveSink& sink);
+
+    /**
+     * @brief 设置读取调度
+     * 常规文件（不大于 batchBytes）先进入批次，批次满（文件数或总字节数）或遇到其他条目时，
+     * 按指定顺序读入内存并按原顺序输出。
+     * @param order: 读取顺序
+     * @param batchFiles: 每批最多文件数（同时打开的文件数）
+     * @param batchBytes: 每批最多缓冲字节数
+     */
+    void setReadOrder(ReadOrder order, size_t batchFiles = 256, size_t batchBytes = 32 * 1024 * 1024);
+
+    /**
+     * @brief 输出尚未写出的批次，并写入归档结束标记（两个空块）。
+     * @param sink: tar字节流的接收者。
+     */
+    void packEnd(const ArchiveSink& sink);
+
     /**
      * @brief 从.tar归档文件中提取文件到目标目录。
      * @param inputArchivePath: 现有.tar文件的路径。
@@ -37,6 +112,19 @@ public:
      */
     bool unpack(const std::string& inputArchivePath, const std::string& outputDir);
 
+    /**
+     * @brief 从tar字节流中边读边提取文件，无需先把归档落地为文件。
+     * @param source: tar字节流的来源。
+     * @param outputDir: 提取文件的目标目录。
+     * @return 如果提取成功返回true，否则返回false。
+     */
+    bool unpack(const ArchiveSource& source, const std::string& outputDir);
+
+    /**
+     * @brief 文件类型对应的tar条目类型 (typeflag)
+     */
+    static char typeflagOf(FileType type);
+
 private:
     // POSIX UStar头部结构 (512字节)
     struct TarHeader {
@@ -61,17 +149,85 @@ private:
 
     // --- 打包辅助函数 ---
     void fillHeader(const FileInfo& file, TarHeader* header);
-    void calculateChecksum(TarHeader* header);
-    bool writeFileContent(const FileInfo& file, std::ofstream& archive);
+    static void calculateChecksum(TarHeader* header);
+    bool writeFileContent(const FileInfo& file, const ArchiveSink& sink);
+    void writeEntry(const FileInfo& file, const ArchiveSink& sink);
+    void flushBatch(const ArchiveSink& sink);
+
+    // 读取调度
+    ReadOrder m_readOrder = ReadOrder::TRAVERSAL;
+    size_t m_batchFiles = 256;
+    size_t m_batchBytes = 32 * 1024 * 1024;
+    std::vector<FileInfo> m_batch;
+    size_t m_batchSize = 0;
 
     // --- 提取辅助函数 ---
-    bool verifyChecksum(const TarHeader* header);
-    void extractFileContent(std::ifstream& archive, const std::string& destPath, uint64_t size);
+    static bool verifyChecksum(const TarHeader* header);
+    void extractFileContent(const ArchiveSource& source, const std::string& destPath, uint64_t size);
+    void skipBytes(const ArchiveSource& source, uint64_t size);
     void ensureParentDirExists(const std::string& path);
     void restoreMetadata(const std::string& path, const TarHeader* header);
     
     // --- 工具函数 ---
-    uint64_t fromOctal(const char* ptr, size_t len);
+    static uint64_t fromOctal(const char* ptr, size_t len);
+
+    friend class TarWalker;
+};
+
+/**
+ * @brief 流式tar解析器
+ * 逐段喂入tar字节流（无需任何对齐），逐个校验头部校验和、magic、数据区与填充对齐、
+ * 结束标记，并通过回调报告条目及其数据。内存占用固定为一个块。
+ * 任何结构错误都会抛出 std::runtime_error。
+ */
+class TarWalker {
+public:
+    struct Callbacks {
+        // 解析到一个条目头部，headerOffset 为头部在tar流中的偏移
+        std::function<void(const TarEntry& entry, uint64_t headerOffset)> onEntry;
+        // 条目的数据区（不含填充），可能分多次回调
+        std::function<void(const uint8_t* data, size_t len)> onData;
+        // 条目的数据区结束
+        std::function<void()> onEntryEnd;
+    };
+
+    explicit TarWalker(Callbacks callbacks = Callbacks());
+
+    /**
+     * @brief 喂入下一段tar字节流
+     */
+    void feed(const uint8_t* data, size_t len);
+
+    /**
+     * @brief 字节流结束时调用：未读到完整的结束标记时抛出异常
+     */
+    void finish();
+
+    /**
+     * @brief 解析并校验单个 512 字节的 tar 头部（magic、校验和、路径），失败时抛出异常
+     * @param block: 头部数据
+     * @param headerOffset: 头部在 tar 流中的偏移（用于错误信息）
+     */
+    static TarEntry decodeHeader(const uint8_t* block, uint64_t headerOffset);
+
+    uint64_t entries() const { return m_entries; }
+    uint64_t offset() const { return m_offset; }
+    bool ended() const { return m_state == State::TRAILER; }
+
+private:
+    enum class State { HEADER, DATA, PADDING, END_BLOCK, TRAILER };
+
+    void parseHeader();
+
+    Callbacks m_callbacks;
+    State m_state = State::HEADER;
+    char m_block[BLOCK_SIZE];
+    size_t m_blockFill = 0;
+    uint64_t m_remaining = 0;     // 当前数据区或填充剩余字节
+    uint64_t m_padding = 0;
+    uint64_t m_offset = 0;        // 已消费的字节数
+    uint64_t m_headerOffset = 0;
+    uint64_t m_entries = 0;
 };
 
 } // namespace Backup
\ No newline at end of file
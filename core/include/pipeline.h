@@ -0,0 +1,243 @@
+#pragma once
+
+#include "common.h"
+#include "compressor.h"
+#include "encryptor.h"
+#include "archive_format.h"
+#include "packer.h"
+#include "mapped_file.h"
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+namespace Backup {
+
+/**
+ * @brief 流水线参数
+ */
+struct PipelineOptions {
+    size_t chunkSize = 1024 * 1024;  // 原始 tar 流的分块大小
+    unsigned int workers = 0;        // 压缩/加密工作线程数，0 表示使用 hardware_concurrency
+    size_t queueDepth = 0;           // 阶段之间缓冲的块数，0 表示 workers * 2
+    size_t manifestMemory = 4 * 1024 * 1024;  // 文件清单在内存中累积的上限，超出部分暂存到目标目录下的临时文件
+    bool delta = false;              // 增量备份：头部记录 ARCHIVE_FLAG_DELTA
+};
+
+/**
+ * @brief 流水线运行统计
+ */
+struct PipelineStats {
+    uint64_t rawBytes = 0;       // tar 流总字节数
+    uint64_t storedBytes = 0;    // 写入文件的总字节数
+    uint64_t chunks = 0;         // tar 流的块数量
+    uint64_t manifestBytes = 0;  // 文件清单字节数
+    uint64_t entries = 0;        // tar 条目数
+    uint64_t manifestSpilled = 0;// 暂存到临时文件的文件清单字节数
+};
+
+/**
+ * @brief 编码单个块：压缩 -> 加密（可选）-> 计算校验和
+ * @param raw: 原始数据
+ * @param algo: 压缩算法
+ * @param encryptor: 加密器，为 nullptr 时不加密
+ * @param chunkIndex: 块序号（用于派生块 IV）
+ * @param record: 输出的块记录头部
+ * @return 存储数据
+ */
+std::vector<uint8_t> encodeChunk(const std::vector<uint8_t>& raw, CompressionAlgorithm algo, const Encryptor* encryptor,
+                                 uint64_t chunkIndex, ChunkRecordHeader& record);
+
+/**
+ * @brief 解码单个块：校验存储数据 -> 解密（可选）-> 解压 -> 校验原始数据
+ * 任一步失败抛出 std::runtime_error
+ * @param header: 备份文件头部
+ * @param encryptor: 加密器（头部标记为加密时必须提供）
+ * @param chunkIndex: 块序号
+ * @param record: 块记录头部
+ * @param stored: 存储数据指针（长度为 record.storedSize）
+ * @return 原始数据
+ */
+std::vector<uint8_t> decodeChunk(const ArchiveHeader& header, const Encryptor* encryptor, uint64_t chunkIndex,
+                                 const ChunkRecordHeader& record, const uint8_t* stored);
+
+/**
+ * @brief 流式备份流水线
+ * 打包 -> 分块并行压缩/加密 -> 按序写入，各阶段通过有界队列连接并发运行，
+ * 内存占用只与块大小和队列深度有关，与归档大小无关。
+ * 打包阶段同时计算每个文件内容的 SHA-256，tar 流之后追加文件清单块；
+ * 清单条目逐个编码，超过 manifestMemory 后写入临时文件，不随条目数占用内存。
+ */
+class BackupPipeline {
+public:
+    /**
+     * @brief tar 字节流的生产者：在打包线程中运行，把完整的 tar 流（包括结束标记）写入 sink
+     */
+    using Producer = std::function<void(const ArchiveSink& sink)>;
+
+    /**
+     * @param algo: 压缩算法
+     * @param encryptor: 已初始化的加密器，为 nullptr 时不加密
+     * @param options: 流水线参数
+     */
+    BackupPipeline(CompressionAlgorithm algo, const Encryptor* encryptor, const PipelineOptions& options = PipelineOptions());
+
+    /**
+     * @brief 执行备份流水线
+     * 先写入 dstFile.part，全部成功后原子重命名为 dstFile；失败时抛出异常并删除临时文件。
+     * @param files: 待打包的文件列表
+     * @param dstFile: 目标备份文件路径
+     * @return 运行统计
+     */
+    PipelineStats run(const std::vector<FileInfo>& files, const std::string& dstFile);
+
+    /**
+     * @brief 执行备份流水线，tar 字节流由 producer 生成
+     */
+    PipelineStats run(const Producer& producer, const std::string& dstFile);
+
+private:
+    CompressionAlgorithm m_algo;
+    const Encryptor* m_encryptor;
+    PipelineOptions m_options;
+};
+
+/**
+ * @brief 流式还原流水线
+ * 读取 -> 并行解密/解压 -> 按序重排 -> 交给消费者，消费者（通常是 Packer::unpack）
+ * 在后续块仍在解码时就开始提取文件。
+ */
+class RestorePipeline {
+public:
+    /**
+     * @brief 消费者：在调用线程中运行，从 source 中按序拉取 tar 字节流
+     */
+    using Consumer = std::function<void(const ArchiveSource& source)>;
+
+    /**
+     * @param encryptor: 已初始化的加密器（未设置密码时为 nullptr）
+     * @param options: 流水线参数（chunkSize 由备份文件头部决定，此处忽略）
+     */
+    explicit RestorePipeline(const Encryptor* encryptor, const PipelineOptions& options = PipelineOptions());
+
+    /**
+     * @brief 执行还原流水线，任一阶段失败时抛出异常
+     * 只解码 tar 流的块，文件清单块由 readManifest 单独读取。
+     * 备份文件以内存映射方式读取，各工作线程直接从映射区解码。
+     * 消费者提前返回时（例如读到 tar 结束标记），剩余的块不再解码。
+     * @param srcFile: 分块格式的备份文件
+     * @param consumer: tar 字节流的消费者
+     * @return 运行统计（chunks / rawBytes 为消费者实际取走的块数与字节数）
+     */
+    PipelineStats run(const std::string& srcFile, const Consumer& consumer);
+
+private:
+    const Encryptor* m_encryptor;
+    PipelineOptions m_options;
+};
+
+/**
+ * @brief 通过尾部索引读取备份文件中的文件清单（只解码清单块）
+ * 索引或清单损坏时抛出 std::runtime_error
+ * @param path: 分块格式的备份文件
+ * @param encryptor: 已初始化的加密器（未设置密码时为 nullptr）
+ */
+std::vector<ManifestEntry> readManifest(const std::string& path, const Encryptor* encryptor);
+
+class ArchiveReader;
+
+/**
+ * @brief 从已打开的读取器中读取文件清单
+ */
+std::vector<ManifestEntry> readManifest(ArchiveReader& reader);
+
+/**
+ * @brief 分块备份文件的读取器
+ * 打开时校验头部、尾部与密钥，之后逐块解码（next）或按索引随机解码（readChunk），
+ * 任意时刻只持有一个块。文件以内存映射方式读取，存储数据直接从映射区解密/解压。
+ */
+class ArchiveReader {
+public:
+    /**
+     * @param path: 备份文件路径
+     * @param encryptor: 已初始化的加密器（未设置密码时为 nullptr）
+     * @param access: 访问模式，按索引抽样读取时使用 RANDOM
+     */
+    ArchiveReader(const std::string& path, const Encryptor* encryptor,
+                  MappedFile::Access access = MappedFile::Access::SEQUENTIAL);
+
+    const ArchiveHeader& header() const { return m_header; }
+    const ArchiveFooter& footer() const { return m_footer; }
+
+    /**
+     * @brief 尾部索引（首次调用时读取并校验 CRC），包含 tar 流与文件清单的所有块
+     */
+    const std::vector<ChunkIndexEntry>& index();
+
+    /**
+     * @brief 校验索引结构：块记录首尾相接地覆盖 [头部, 索引) 区间，
+     * rawOffset 连续，大小与尾部记录一致。不解码任何块，不一致时抛出异常
+     */
+    void checkIndex();
+
+    /**
+     * @brief 按索引解码第 seq 个块（包括文件清单块），记录头与索引不一致时抛出异常
+     * @param seq: 块序号，范围 [0, footer().totalChunks())
+     * @param raw: 输出的原始数据
+     */
+    void readChunk(uint64_t seq, std::vector<uint8_t>& raw);
+
+    /**
+     * @brief 解码 tar 流的下一个块
+     * @param raw: 输出的原始数据
+     * @return 已读完 tar 流的所有块时返回 false
+     */
+    bool next(std::vector<uint8_t>& raw);
+
+private:
+    MappedFile m_file;
+    const Encryptor* m_encryptor;
+    ArchiveHeader m_header;
+    ArchiveFooter m_footer;
+    std::vector<ChunkIndexEntry> m_index;
+    bool m_indexLoaded = false;
+    uint64_t m_nextChunk = 0;
+    size_t m_offset = ARCHIVE_HEADER_SIZE;
+};
+
+/**
+ * @brief 文件清单的流式读取器：按 tar 顺序逐项解码，只持有当前的清单块（以及跨块条目的剩余部分），
+ * 内存占用与条目数无关。读完时校验条目数与清单长度，损坏时抛出 std::runtime_error
+ */
+class ManifestReader {
+public:
+    /**
+     * @param reader: 已打开的读取器（必须在 ManifestReader 的生命周期内有效）
+     */
+    explicit ManifestReader(ArchiveReader& reader);
+
+    // 头部记录的条目数
+    uint64_t count() const { return m_count; }
+
+    /**
+     * @brief 读取下一项
+     * @param entry: 输出的条目
+     * @return 已读完全部条目时返回 false
+     */
+    bool next(ManifestEntry& entry);
+
+private:
+    // 解码下一个清单块并追加到未解码数据之后，没有更多块时返回 false
+    bool fill();
+
+    ArchiveReader& m_reader;
+    std::vector<uint8_t> m_data;    // 当前块中尚未解码的数据
+    size_t m_pos = 0;
+    uint64_t m_nextChunk = 0;
+    uint64_t m_rawBytes = 0;        // 已解码的清单原始字节数
+    uint64_t m_count = 0;
+    uint64_t m_read = 0;
+    bool m_finished = false;
+};
+
+} // namespace Backup
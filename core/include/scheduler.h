@@ -1,13 +1,21 @@
 #pragma once
 
 #include "backup_system.h"
+#include "metadata_index.h"
+#include "change_watcher.h"
+#include "compressor.h"
 #include <thread>
 #include <atomic>
 #include <mutex>
 #include <vector>
 #include <map>
+#include <set>
+#include <deque>
+#include <queue>
 #include <functional>
 #include <condition_variable>
+#include <memory>
+#include <chrono>
 
 namespace Backup {
 
@@ -16,6 +24,100 @@ enum class TaskType {
     REALTIME    // 实时监听
 };
 
+/**
+ * @brief 实时任务的触发去抖参数（毫秒）
+ * 变化平息 quietMs 后才触发备份；持续变化时最迟在第一次变化后 maxDelayMs 触发；
+ * 两次备份之间至少间隔 minIntervalMs。突发的大量写入只产生一次备份。
+ */
+struct DebounceOptions {
+    int quietMs = 1000;
+    int maxDelayMs = 30000;
+    int minIntervalMs = 5000;
+};
+
+/**
+ * @brief 实时任务的增量备份参数
+ * 启用时每次变化只备份变化的文件与删除的路径（增量备份），每 fullEvery 个增量之后做一次完整备份；
+ * 无法确定变化的路径时（例如完整扫描发现了删除）也会做完整备份。
+ */
+struct DeltaOptions {
+    bool enabled = true;
+    int fullEvery = 20;
+};
+
+/**
+ * @brief 定时任务落后于计划（上一次运行超时、工作线程繁忙、系统挂起）时的处理方式
+ */
+enum class OverlapPolicy {
+    COALESCE,       // 运行超时错过的时间点被合并，等待下一个时间点；因繁忙或挂起而晚点的运行照常执行一次
+    SKIP_IF_LATE,   // 不能在最大延迟之内开始的运行直接跳过，等待下一个时间点
+    QUEUE           // 依次补跑错过的时间点，但丢弃落后超过最大延迟的
+};
+
+/**
+ * @brief 定时任务的重叠策略参数
+ * 时间点按 intervalSeconds 的固定网格排列；晚于时间点 maxLagSeconds 以上视为错过。
+ */
+struct OverlapOptions {
+    OverlapPolicy policy = OverlapPolicy::COALESCE;
+    int maxLagSeconds = 60;
+};
+
+/**
+ * @brief 定时任务的调度统计（不持久化）
+ */
+struct ScheduleStats {
+    uint64_t runs = 0;          // 开始执行的次数
+    uint64_t skippedRuns = 0;   // 被合并或跳过的时间点数
+    int64_t lastLagMs = 0;      // 最近一次运行相对计划时间的延迟
+    int64_t maxLagMs = 0;       // 最大延迟
+};
+
+/**
+ * @brief 备份目录中属于某个任务的一个备份文件
+ */
+struct BackupFileEntry {
+    std::string path;
+    time_t time = 0;            // 写入完成的时间
+    bool delta = false;         // 是否为增量备份
+};
+
+/**
+ * @brief 两次备份之间累积的变化（相对源目录的路径）
+ */
+struct PendingChanges {
+    std::set<std::string> changed;      // 新增或修改的路径
+    std::set<std::string> removed;      // 删除的路径
+    bool incomplete = false;            // 有无法得到路径的变化，下一次必须完整备份
+
+    bool empty() const { return changed.empty() && removed.empty() && !incomplete; }
+    void noteChanged(const std::string& path);
+    void noteRemoved(const std::string& path);
+    void markIncomplete();
+
+    // 按先后顺序合并之后发生的变化
+    void merge(const PendingChanges& later);
+};
+
+/**
+ * @brief 一个源目录的共享元数据快照：事件监视器 + 持久化的元数据索引
+ * 同一目录或其子目录上的实时任务共用一个快照（引用计数），每轮只检测一次变化，再分发给各任务。
+ * 索引与监视器只由调度线程访问。
+ */
+struct SourceSnapshot {
+    std::string root;                                   // 规范化的源目录
+    // 持久化的文件元数据索引（位于创建它的任务的 dstDir 下），进程重启后无需重新遍历即可比较
+    std::unique_ptr<MetadataIndex> index;
+    // 事件驱动的变化监视（不可用时退回定期完整扫描）
+    std::unique_ptr<ChangeWatcher> watcher;
+    std::chrono::steady_clock::time_point nextPoll;     // 没有监视器时下一次完整扫描的时间
+
+    bool watched() const { return watcher && watcher->active(); }
+
+    // 加载了上次运行留下的索引：停机期间的变化没有事件，监视器可用时也需要一次完整扫描
+    bool rescan = false;
+};
+
 struct BackupTask {
     int id;
     TaskType type;
@@ -24,17 +126,100 @@ struct BackupTask {
     std::string filePrefix;     // 文件名前缀
     int intervalSeconds;        // 定时备份间隔
     int maxBackups;             // 数据淘汰
-    time_t lastRunTime;         // 上次运行时间
+    time_t lastRunTime;         // 上次运行时间（墙上时钟，仅供显示）
+    std::string lastArchive;    // 上一次成功写入的备份文件
+
+    // 定时备份用：下一次运行时间（单调时钟，按固定频率推进，不受系统时间调整影响）
+    std::chrono::steady_clock::time_point nextRun;
+    uint64_t timerSeq = 0;      // 定时器堆中有效条目的序号（重新调度时旧条目作废）
+    OverlapOptions overlap;     // 落后于计划时的处理方式
+    ScheduleStats stats;
     
-    std::map<std::string, time_t> fileSnapshot; // 实时备份用
+    // 实时备份用：共享的源目录快照，以及本任务源目录相对快照根目录的路径（相同时为空）
+    std::shared_ptr<SourceSnapshot> snapshot;
+    std::string snapshotPrefix;
+
+    // 实时备份用：去抖状态
+    DebounceOptions debounce;
+    bool changePending = false;                             // 有尚未备份的变化
+    std::chrono::steady_clock::time_point firstChange;      // 本轮第一次发现变化的时间
+    std::chrono::steady_clock::time_point lastChange;       // 最近一次发现变化的时间
+    std::chrono::steady_clock::time_point lastRun;          // 上次备份完成的时间
+
+    // 实时备份用：增量备份状态
+    DeltaOptions delta;
+    PendingChanges pending;                 // 上次派发备份之后的变化
+    bool needFull = true;                   // 变化集合不完整或尚无完整备份，下一次必须完整备份
+    int deltasSinceFull = 0;                // 上次完整备份之后的增量备份数
+
+    bool running = false;                   // 已派发给工作线程（同一任务不会同时执行两次）
+    ResourcePolicy resources;               // 资源限制（线程数、带宽、优先级、压力暂停）
+
+    // 以下设置同时保存在 systemInstance 中，这里的副本用于持久化
+    int compressionAlgo = static_cast<int>(CompressionAlgorithm::LZSS);
+    bool encrypted = false;
+    bool hasFilter = false;                 // 调用过 setTaskFilter
+    bool awaitingPassword = false;          // 从状态文件恢复的加密任务，设置密码之前不执行
 
     BackupSystem systemInstance; // 每个任务独立的备份系统实例
     Filter filter;
 };
 
+/**
+ * @brief 持久化的任务状态：任务定义与运行进度（不含密码）
+ */
+struct TaskState {
+    int id = 0;
+    TaskType type = TaskType::SCHEDULED;
+    std::string srcDir;
+    std::string dstDir;
+    std::string filePrefix;
+    int intervalSeconds = 0;
+    int maxBackups = 0;
+    int compressionAlgo = static_cast<int>(CompressionAlgorithm::LZSS);
+    bool encrypted = false;
+    bool hasFilter = false;
+    Filter filter;
+    DebounceOptions debounce;
+    DeltaOptions delta;
+    ResourcePolicy resources;
+    OverlapOptions overlap;
+
+    time_t lastRunTime = 0;
+    time_t nextRunTime = 0;         // 定时任务的下一次运行时间（墙上时钟）
+    std::string lastArchive;        // 上一次成功写入的备份文件
+    std::string indexPath;          // 实时任务的元数据索引文件
+    PendingChanges pending;         // 实时任务尚未备份的变化
+    bool needFull = true;
+    int deltasSinceFull = 0;
+};
+
+/**
+ * @brief 调度器的持久化状态
+ */
+struct SchedulerState {
+    int nextId = 1;
+    bool clean = false;             // 写入时调度线程未运行：实时任务的变化集合与索引一致
+    std::vector<TaskState> tasks;
+};
+
+/**
+ * @brief 备份任务调度器
+ * 调度线程只负责变化检测与派发，到期的任务交给有界的工作线程池执行，多个任务可以并行备份。
+ * 定时任务按下一次运行时间放入最小堆，调度线程精确睡眠到最早的到期时间（或被事件唤醒），
+ * 空闲时不做任何轮询，每次唤醒的开销与定时任务数无关。
+ * 同一任务不会重叠执行；落后于计划时按任务的重叠策略合并、跳过或在最大延迟之内补跑错过的时间点。
+ * 调度锁只在簿记时持有：备份执行期间添加任务、修改设置都不会被阻塞（修改在下一次运行时生效），
+ * stop() 会取消正在执行的备份。
+ * 启用状态文件（loadState）后，任务定义与运行进度的每次变化都原子地写回状态文件，
+ * 进程重启后从中断处继续：定时任务按原定时间运行，实时任务沿用索引与增量链，不重复备份。
+ */
 class BackupScheduler {
 public:
-    BackupScheduler();
+    /**
+     * @param maxConcurrent: 同时执行的备份任务数上限（至少为 1）
+     */
+    explicit BackupScheduler(unsigned int maxConcurrent = 2);
     ~BackupScheduler();
 
     void start();
@@ -49,25 +234,151 @@ public:
     // 设置任务的过滤器
     void setTaskFilter(int taskId, const Filter& opts);
     
-    // 设置任务的加密密码
+    // 设置任务的加密密码（从状态文件恢复的加密任务不接受空密码，抛出 std::runtime_error）
     void setTaskPassword(int taskId, const std::string& pwd);
 
     // 设置任务的压缩算法
     void setTaskCompressionAlgorithm(int taskId, int algo);
 
+    // 设置实时任务的触发去抖参数
+    void setTaskDebounce(int taskId, const DebounceOptions& options);
+
+    // 设置实时任务的增量备份参数
+    void setTaskDelta(int taskId, const DeltaOptions& options);
+
+    // 设置任务的资源限制，避免备份影响同机服务的延迟
+    void setTaskResourcePolicy(int taskId, const ResourcePolicy& policy);
+
+    // 设置定时任务落后于计划时的处理方式
+    void setTaskOverlap(int taskId, const OverlapOptions& options);
+
+    // 定时任务的调度统计（找不到任务时全部为 0）
+    ScheduleStats scheduleStats(int taskId);
+
+    /**
+     * @brief 按重叠策略计算定时任务的下一次运行时间（只做时间点运算，不读取时钟）
+     * @param scheduled: 本次运行的计划时间
+     * @param now: 本次运行结束的时间
+     * @param intervalSeconds: 定时间隔
+     * @param overlap: 重叠策略
+     * @param skipped: 输出被合并或跳过的时间点数
+     * @return 下一次运行的计划时间，总是在网格 scheduled + k * interval 上
+     */
+    static std::chrono::steady_clock::time_point nextScheduledRun(std::chrono::steady_clock::time_point scheduled,
+                                                                  std::chrono::steady_clock::time_point now,
+                                                                  int intervalSeconds, const OverlapOptions& overlap,
+                                                                  uint64_t& skipped);
+
+    // 设置同时执行的备份任务数上限（运行中也可以调整）
+    void setMaxConcurrentTasks(unsigned int maxConcurrent);
+
+    /**
+     * @brief 启用状态持久化：从状态文件恢复任务（文件不存在时不恢复），之后的变化写回该文件
+     * 须在添加任务之前调用。密码不写入状态文件：恢复的加密任务在 setTaskPassword 之后才会执行。
+     * 上次未经 stop() 正常退出时，实时任务的下一次备份为完整备份。
+     * @param stateFile: 状态文件路径
+     * @return 恢复的任务数；状态文件损坏或已有任务时抛出 std::runtime_error
+     */
+    size_t loadState(const std::string& stateFile);
+
+    // 当前所有任务的状态（按添加顺序）
+    std::vector<TaskState> taskStates();
+
+    /**
+     * @brief 列出备份目录中某个前缀的备份文件，按时间先后排序
+     */
+    static std::vector<BackupFileEntry> listBackups(const std::string& dstDir, const std::string& prefix);
+
+    /**
+     * @brief 还原到某个时间点所需的备份链：该时间之前最近的完整备份，加上其后直到该时间的增量备份
+     * @param pointInTime: 时间点，0 表示最新
+     * @return 按时间顺序排列的备份文件，没有可用的完整备份时为空
+     */
+    static std::vector<std::string> backupChain(const std::string& dstDir, const std::string& prefix, time_t pointInTime = 0);
+
+    /**
+     * @brief 把任务的备份还原到某个时间点（使用任务的密码）
+     * @param pointInTime: 时间点，0 表示最新
+     * @param restoreDir: 还原目标目录
+     * @return 找不到任务或可用的备份链时返回 false，还原失败时抛出异常
+     */
+    bool restoreTask(int taskId, time_t pointInTime, const std::string& restoreDir);
+
 private:
+    /**
+     * @brief 派发给工作线程的一次备份
+     */
+    struct BackupJob {
+        std::shared_ptr<BackupTask> task;
+        BackupSystem system;        // 派发时的设置快照
+        bool delta = false;         // 增量备份
+        PendingChanges changes;     // 增量备份的变化集合
+        ResourcePolicy resources;   // 派发时的资源限制（线程优先级在执行线程中应用）
+        std::string archive;        // 写入的备份文件
+        std::chrono::steady_clock::time_point due;  // 定时任务的计划时间
+    };
+
     void loop();
-    void performBackup(BackupTask& task);
-    bool checkChanges(BackupTask& task);
+    void workerLoop();
+    void spawnWorkers();
+    BackupJob makeJob(const std::shared_ptr<BackupTask>& task);
+    // 执行结束后的簿记（持有调度锁）；失败时撤销派发，ran 为 false 时不更新运行时间
+    void finishJob(BackupJob& job, bool success, bool ran);
+    bool performBackup(BackupJob& job);
+    void scheduleAt(const std::shared_ptr<BackupTask>& task, std::chrono::steady_clock::time_point due);
+    // 按重叠策略计算本次计划时间之后的下一次运行时间，并统计被合并或跳过的时间点
+    static std::chrono::steady_clock::time_point nextScheduledRun(BackupTask& task, std::chrono::steady_clock::time_point now);
+    static std::chrono::steady_clock::duration lagTolerance(const OverlapOptions& overlap);
+    void notifyWakeup();
+    bool checkChanges(SourceSnapshot& snapshot, PendingChanges& changes);
+    bool applyWatchedChanges(SourceSnapshot& snapshot, PendingChanges& changes);
+    std::shared_ptr<SourceSnapshot> acquireSnapshot(const std::string& srcDir, const std::string& dstDir,
+                                                    const std::string& prefix, std::string& snapshotPrefix);
+    static bool projectChanges(const PendingChanges& changes, const std::string& prefix, PendingChanges& out);
+    static std::chrono::steady_clock::time_point debounceDue(const BackupTask& task);
+    static std::string metadataIndexPath(const std::string& dstDir, const std::string& prefix);
+    static std::unique_ptr<MetadataIndex> openMetadataIndex(const std::string& dstDir, const std::string& prefix);
+    TaskState stateOf(const BackupTask& task) const;
+    static std::shared_ptr<BackupTask> taskFromState(const TaskState& state, bool clean);
+    // 状态有变化（m_stateDirty）时写回状态文件；调用时不能持有调度锁，未启用持久化时什么也不做
+    void flushState();
     void pruneOldBackups(const BackupTask& task);
-    std::string generateFileName(const std::string& dir, const std::string& prefix);
+    std::string generateFileName(const std::string& dir, const std::string& prefix, bool delta = false);
+    static bool hasFullBackup(const std::string& dstDir, const std::string& prefix);
+
+    /**
+     * @brief 定时器堆中的一项
+     */
+    struct TimerEntry {
+        std::chrono::steady_clock::time_point due;
+        uint64_t seq;
+        std::shared_ptr<BackupTask> task;
+
+        bool operator>(const TimerEntry& other) const { return due > other.due; }
+    };
 
     std::vector<std::shared_ptr<BackupTask>> m_tasks;
+    std::vector<std::shared_ptr<BackupTask>> m_realtimeTasks;
+    std::map<std::string, std::weak_ptr<SourceSnapshot>> m_snapshots;  // 源目录 -> 共享快照（由任务持有引用）
+    std::mutex m_snapshotMutex;         // 串行化快照的创建（建立基线时不持有调度锁）
+    std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry>> m_timers;  // 定时任务，最早到期的在堆顶
     std::atomic<bool> m_running;
     std::thread m_thread;
     std::mutex m_mutex;
     std::condition_variable m_cv;
+    std::atomic<bool> m_wakeup{false};  // 监视器报告了新变化，或有任务执行完毕
     int m_nextId = 1;
+
+    // 工作线程池
+    std::vector<std::thread> m_workers;
+    std::deque<BackupJob> m_queue;      // 待执行的备份
+    unsigned int m_maxConcurrent;
+    unsigned int m_activeJobs = 0;
+    std::atomic<bool> m_cancel{false};  // stop() 时取消正在执行的备份
+
+    std::string m_stateFile;            // 状态文件，为空时不持久化
+    bool m_stateDirty = false;          // 状态有尚未写回的变化（受调度锁保护）
+    std::mutex m_stateWriteMutex;       // 串行化状态文件的写入（先于调度锁获取）
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "scheduler.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace Backup {
+
+/**
+ * @brief 编码调度器状态（以 CRC32 校验结尾）
+ */
+std::vector<uint8_t> encodeSchedulerState(const SchedulerState& state);
+
+/**
+ * @brief 解码调度器状态，格式错误或校验失败时抛出 std::runtime_error
+ */
+SchedulerState decodeSchedulerState(const uint8_t* in, size_t len);
+
+/**
+ * @brief 原子地写入状态文件：写入临时文件并 fsync 后替换，崩溃时保留旧文件
+ * 写入失败时抛出 std::runtime_error
+ */
+void saveSchedulerState(const std::string& path, const SchedulerState& state);
+
+/**
+ * @brief 读取状态文件
+ * @return 文件不存在时返回 false；文件损坏时抛出 std::runtime_error
+ */
+bool loadSchedulerState(const std::string& path, SchedulerState& state);
+
+} // namespace Backup
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace Backup {
+
+/**
+ * @brief 备份的资源限制，全部为 0 / false 时不做任何限制
+ */
+struct ResourcePolicy {
+    unsigned int maxThreads = 0;    // 遍历与压缩/加密的线程数上限，0 表示按核数
+    uint64_t ioBytesPerSec = 0;     // 读取带宽上限（按打包的字节数计），0 表示不限
+    bool ioIdle = false;            // 使用 idle I/O 调度类（磁盘空闲时才读写）
+    int niceLevel = 0;              // 备份线程的 nice 值（0 表示不调整）
+    double maxLoadPerCpu = 0.0;     // 1 分钟平均负载 / 核数超过该值时暂停，0 表示不检查
+    double maxPressure = 0.0;       // CPU 或 I/O 的 PSI "some avg10"（百分比）超过该值时暂停，0 表示不检查
+    int maxPauseSeconds = 300;      // 每次备份累计暂停时间上限，超过后不再暂停，保证在时间窗口内完成
+
+    bool limitsRate() const { return ioBytesPerSec > 0 || maxLoadPerCpu > 0.0 || maxPressure > 0.0; }
+    bool changesPriority() const { return ioIdle || niceLevel != 0; }
+};
+
+/**
+ * @brief 单次备份的节流器
+ * 令牌桶限制字节速率（允许约 1/4 秒的突发），并定期检查系统负载与 PSI 压力，
+ * 超过阈值时暂停，直到压力回落或用完暂停预算。暂停期间取消标记置位时抛出 std::runtime_error。
+ * 非线程安全，只在打包线程中调用。
+ */
+class Throttle {
+public:
+    /**
+     * @param policy: 资源限制
+     * @param cancel: 取消标记（可以为 nullptr）
+     */
+    explicit Throttle(const ResourcePolicy& policy, const std::atomic<bool>* cancel = nullptr);
+
+    /**
+     * @brief 开始前等待系统压力回落（准入控制）
+     */
+    void waitForCapacity();
+
+    /**
+     * @brief 记录即将写出的字节数，超过速率或系统压力过高时阻塞
+     */
+    void consume(size_t bytes);
+
+    // 系统压力是否超过阈值
+    bool overloaded() const;
+
+    // 已暂停的总时间
+    std::chrono::milliseconds paused() const { return std::chrono::duration_cast<std::chrono::milliseconds>(m_paused); }
+
+    /**
+     * @brief 把 I/O 调度类与 nice 值应用到调用线程（之后由它创建的线程继承）
+     * 只在 Linux 下有效；权限不足时忽略。nice 值无法在非特权进程中调回，调用者应在专用线程中使用
+     */
+    static void applyThreadPriority(const ResourcePolicy& policy);
+
+    /**
+     * @brief 读取 PSI 压力文件（/proc/pressure/cpu 等）中 "some avg10" 的值
+     * @return 不支持时返回负数
+     */
+    static double readPressure(const char* path);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void sleepFor(Clock::duration duration);
+
+    ResourcePolicy m_policy;
+    const std::atomic<bool>* m_cancel;
+    double m_tokens;                    // 令牌桶中剩余的字节数
+    Clock::time_point m_lastRefill;
+    Clock::time_point m_nextCheck;      // 下一次检查系统压力的时间
+    Clock::duration m_paused{0};
+};
+
+} // namespace Backup
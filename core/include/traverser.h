@@ -1,14 +1,58 @@
 #pragma once
 
 #include "common.h"
+#include "filter.h"
+#include "file_list.h"
 #include <vector>
 #include <string>
+#include <memory>
+#include <functional>
+#include <sys/stat.h>
 
 namespace Backup{
 
+/**
+ * @brief 遍历选项
+ */
+struct TraverseOptions {
+    // 排除规则，遍历时求值：被排除的条目不会被 stat，被排除的目录不会被打开
+    std::shared_ptr<const CompiledFilter> filter;
+
+    // 遍历线程数：1 为单线程递归，0 为 hardware_concurrency。
+    // 扫描主要受 I/O 延迟限制，在 NFS 或多盘阵列上可以设为大于核数，以提高存储的队列深度
+    unsigned int threads = 1;
+
+    // 并行遍历时已扫描、尚未交给 visitor 的条目上限（0 为不限）。达到上限后工作线程暂停领取新目录，
+    // 实际峰值可能超出至多 threads 个正在扫描的目录的条目数
+    size_t maxBufferedEntries = 65536;
+
+    // 每个目录内的条目按名称排序，使结果与 readdir 顺序无关（可复现的归档）
+    bool sortEntries = false;
+
+    // 为 false 时目录（由 d_type 判定）不做 stat，只填写路径与类型。
+    // 适用于只关心文件元数据的场景（例如实时备份的变化检测）
+    bool statDirectories = true;
+
+    // 为 false 时不解析用户名/组名（userName、groupName 留空），由打包时按需通过 NameCache 解析
+    bool resolveNames = true;
+
+    // 不跨越文件系统：只进入与根目录 st_dev 相同的目录，挂载点本身仍作为空目录记录
+    bool oneFileSystem = false;
+
+    // 不进入这些类型的文件系统（按 statfs 判定），例如 "proc"、"sysfs"、"tmpfs"、"nfs"；
+    // 挂载点本身仍作为空目录记录。整机备份建议使用 Traverser::pseudoFileSystems()
+    std::vector<std::string> excludeFsTypes;
+};
+
 class Traverser {
 public:
+    /**
+     * @brief 条目访问者：按先序（父目录在子条目之前）逐个接收条目，可以修改或移走 info
+     */
+    using Visitor = std::function<void(FileInfo & info)>;
+
     Traverser() = default;
+    explicit Traverser(const TraverseOptions& options) : m_options(options) {}
     ~Traverser() = default;
 
     /** 
@@ -18,14 +62,88 @@ public:
     **/
     std::vector<FileInfo> traverse(const std::string & path);
 
+    /**
+     * @brief 流式遍历：条目一经发现就交给 visitor，下游（例如打包）可以与扫描同时进行
+     * visitor 只在调用线程中被调用；并行模式下各目录由工作线程扫描，调用线程按先序输出，
+     * 已输出的目录结果立即释放。visitor 抛出的异常会停止遍历并向上传播
+     * @param path: 开始遍历的根路径
+     * @param visitor: 条目访问者
+     */
+    void traverse(const std::string & path, const Visitor & visitor);
+
+    /**
+     * @brief 遍历给定路径，结果写入紧凑文件列表（路径只保存文件名与父目录下标）
+     * @param path: 开始遍历的根路径
+     * @param list: 输出列表，原有内容被清空，根目录设置为 path
+     */
+    void traverse(const std::string & path, FileList & list);
+
+    /**
+     * @brief 整机备份时建议排除的伪文件系统类型（proc、sysfs、devpts、cgroup 等）
+     */
+    static std::vector<std::string> pseudoFileSystems();
+
+    /**
+     * @brief 上一次并行遍历中已扫描、尚未交给 visitor 的条目数峰值（单线程遍历为 0）
+     */
+    size_t peakBufferedEntries() const { return m_peakBuffered; }
+
+    /**
+     * @brief 获取根目录下单个条目的元数据（不递归），用于只处理变化路径的场景
+     * @param rootDir: 根目录
+     * @param relativePath: 相对根目录的路径
+     * @return 条目信息，relativePath 为传入的相对路径；条目不存在时抛出 std::runtime_error
+     */
+    FileInfo statEntry(const std::string & rootDir, const std::string & relativePath);
+
 private:
+    /**
+     * @brief 条目接收者：按先序接收每个条目及其父目录的标记，返回该条目的标记（供其子条目引用）
+     */
+    using EntrySink = std::function<uint32_t(FileInfo && info, uint32_t parent)>;
+
+    void traverseInto(const std::string & path, const EntrySink & sink);
+
     /**
      * @brief 递归遍历目录的辅助函数
+     * 目录以 fd 打开，子目录通过 openat 相对打开，条目通过 fstatat 相对 stat，内核无需重复解析完整路径
+     * @param dirFd: 当前目录的 fd（调用者负责关闭）
      * @param currentDir: 当前被遍历的目录
-     * @param rootDir: 遍历开始的根目录
-     * @param files: 用于存储结果的文件信息列表
+     * @param relativeDir: 当前目录相对根目录的路径（根目录为空串）
+     * @param parent: 当前目录条目的标记（根目录为 FileList::NO_PARENT）
+     * @param device: 当前目录所在的设备（仅在检查挂载点时有效）
+     * @param sink: 条目接收者
      */
-    void traverseHelper(const std::string & currentDir, const std::string & rootDir, std::vector<FileInfo> & files);
+    void traverseHelper(int dirFd, const std::string & currentDir, const std::string & relativeDir, uint32_t parent,
+                        dev_t device, const EntrySink & sink);
+
+    /**
+     * @brief 判断是否进入已打开的子目录：设备号与父目录相同时总是进入，
+     * 否则按 oneFileSystem 与 excludeFsTypes 判定（只在挂载点处调用 fstatfs）
+     * @param dirFd: 子目录的 fd
+     * @param parentDevice: 父目录所在的设备
+     * @param device: 输出子目录所在的设备
+     */
+    bool shouldDescend(int dirFd, dev_t parentDevice, dev_t & device) const;
+
+    // 是否需要在进入子目录时检查挂载点
+    bool checksMounts() const { return m_options.oneFileSystem || !m_excludedFsTypes.empty(); }
+
+    /**
+     * @brief 并行遍历：工作线程从各自的双端队列中取目录，空闲时从其他线程窃取；
+     * 每个目录的结果单独保存，调用线程按与单线程相同的先序顺序输出，结果与线程调度无关
+     */
+    void traverseParallel(const std::string & rootDir, unsigned int threads, const EntrySink & sink);
+
+    /**
+     * @brief 读取单个目录（不递归），应用排除规则并收集每个条目的元数据
+     * Linux 下以大缓冲区直接调用 getdents64，d_type 可用时排除判定与目录条目无需 stat
+     * @param dirFd: 目录 fd
+     * @param currentDir: 被读取的目录
+     * @param relativeDir: 该目录相对根目录的路径
+     * @param entries: 输出的条目列表
+     */
+    void scanDirectory(int dirFd, const std::string & currentDir, const std::string & relativeDir, std::vector<FileInfo> & entries);
     
     /**
      * @brief 获取给定路径的文件信息
@@ -34,6 +152,27 @@ private:
      * @return A FileInfo structure containing metadata about the file
      */
     FileInfo getFileInfo(const std::string & fullPath, const std::string & rootDir);
+
+    /**
+     * @brief 由 stat 结果填写元数据（用户名、组名、类型、链接目标）
+     * @param info: 待填写的文件信息
+     * @param fileStat: stat 结果
+     * @param dirFd: 条目所在目录的 fd（或 AT_FDCWD）
+     * @param name: 相对 dirFd 的名称（用于 readlinkat）
+     */
+    void fillFileInfo(FileInfo & info, const struct stat & fileStat, int dirFd, const char * name) const;
+
+    /**
+     * @brief 计算相对于根目录的路径（不访问文件系统）
+     */
+    static std::string relativePathOf(const std::string & fullPath, const std::string & rootDir);
+
+    TraverseOptions m_options;
+
+    // 单次遍历的状态
+    dev_t m_rootDevice = 0;
+    std::vector<uint64_t> m_excludedFsTypes;    // 由 excludeFsTypes 解析得到的 statfs 类型
+    size_t m_peakBuffered = 0;
 };
 
 } // namespace Backup
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "archive_format.h"
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+namespace Backup {
+
+const char ARCHIVE_MAGIC[4] = {'F', 'B', 'K', '2'};
+const char ARCHIVE_FOOTER_MAGIC[4] = {'F', 'B', 'K', 'E'};
+static const char MANIFEST_MAGIC[4] = {'F', 'B', 'K', 'M'};
+
+// 小端序读写辅助函数
+
+template <typename T>
+static void putLE(uint8_t* out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) out[i] = static_cast<uint8_t>((static_cast<uint64_t>(value) >> (i * 8)) & 0xFF);
+}
+
+template <typename T>
+static T getLE(const uint8_t* in) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) value |= static_cast<uint64_t>(in[i]) << (i * 8);
+    return static_cast<T>(value);
+}
+
+uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc) {
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// 头部布局: magic(4) version(2) flags(2) algo(1) reserved(3) chunkSize(4) keyCheck(8) reserved(4) crc(4)
+void encodeArchiveHeader(const ArchiveHeader& header, uint8_t* out) {
+    std::memset(out, 0, ARCHIVE_HEADER_SIZE);
+    std::memcpy(out, ARCHIVE_MAGIC, 4);
+    putLE<uint16_t>(out + 4, header.version);
+    putLE<uint16_t>(out + 6, header.flags);
+    out[8] = header.algorithm;
+    putLE<uint32_t>(out + 12, header.chunkSize);
+    std::memcpy(out + 16, header.keyCheck, 8);
+    putLE<uint32_t>(out + 28, crc32(out, 28));
+}
+
+ArchiveHeader decodeArchiveHeader(const uint8_t* in) {
+    if (std::memcmp(in, ARCHIVE_MAGIC, 4) != 0) {
+        throw std::runtime_error("无效的备份文件格式 (魔数错误)。");
+    }
+    if (getLE<uint32_t>(in + 28) != crc32(in, 28)) {
+        throw std::runtime_error("备份文件头部损坏 (校验和错误)。");
+    }
+    ArchiveHeader header;
+    header.version = getLE<uint16_t>(in + 4);
+    header.flags = getLE<uint16_t>(in + 6);
+    header.algorithm = in[8];
+    header.chunkSize = getLE<uint32_t>(in + 12);
+    std::memcpy(header.keyCheck, in + 16, 8);
+    if (header.version != ARCHIVE_VERSION) {
+        throw std::runtime_error("不支持的备份文件版本: " + std::to_string(header.version));
+    }
+    return header;
+}
+
+void encodeChunkRecordHeader(const ChunkRecordHeader& record, uint8_t* out) {
+    putLE<uint32_t>(out, record.rawSize);
+    putLE<uint32_t>(out + 4, record.storedSize);
+    putLE<uint32_t>(out + 8, record.rawCrc);
+    putLE<uint32_t>(out + 12, record.storedCrc);
+}
+
+ChunkRecordHeader decodeChunkRecordHeader(const uint8_t* in) {
+    ChunkRecordHeader record;
+    record.rawSize = getLE<uint32_t>(in);
+    record.storedSize = getLE<uint32_t>(in + 4);
+    record.rawCrc = getLE<uint32_t>(in + 8);
+    record.storedCrc = getLE<uint32_t>(in + 12);
+    return record;
+}
+
+void encodeChunkIndexEntry(const ChunkIndexEntry& entry, uint8_t* out) {
+    putLE<uint64_t>(out, entry.offset);
+    putLE<uint64_t>(out + 8, entry.rawOffset);
+    putLE<uint32_t>(out + 16, entry.rawSize);
+    putLE<uint32_t>(out + 20, entry.storedSize);
+    putLE<uint32_t>(out + 24, entry.rawCrc);
+    putLE<uint32_t>(out + 28, entry.storedCrc);
+}
+
+ChunkIndexEntry decodeChunkIndexEntry(const uint8_t* in) {
+    ChunkIndexEntry entry;
+    entry.offset = getLE<uint64_t>(in);
+    entry.rawOffset = getLE<uint64_t>(in + 8);
+    entry.rawSize = getLE<uint32_t>(in + 16);
+    entry.storedSize = getLE<uint32_t>(in + 20);
+    entry.rawCrc = getLE<uint32_t>(in + 24);
+    entry.storedCrc = getLE<uint32_t>(in + 28);
+    return entry;
+}
+
+// 尾部布局: indexOffset(8) chunkCount(8) manifestChunks(8) rawSize(8) manifestSize(8) indexCrc(4) magic(4)
+void encodeArchiveFooter(const ArchiveFooter& footer, uint8_t* out) {
+    putLE<uint64_t>(out, footer.indexOffset);
+    putLE<uint64_t>(out + 8, footer.chunkCount);
+    putLE<uint64_t>(out + 16, footer.manifestChunks);
+    putLE<uint64_t>(out + 24, footer.rawSize);
+    putLE<uint64_t>(out + 32, footer.manifestSize);
+    putLE<uint32_t>(out + 40, footer.indexCrc);
+    std::memcpy(out + 44, ARCHIVE_FOOTER_MAGIC, 4);
+}
+
+ArchiveFooter decodeArchiveFooter(const uint8_t* in) {
+    if (std::memcmp(in + 44, ARCHIVE_FOOTER_MAGIC, 4) != 0) {
+        throw std::runtime_error("备份文件尾部损坏或不完整。");
+    }
+    ArchiveFooter footer;
+    footer.indexOffset = getLE<uint64_t>(in);
+    footer.chunkCount = getLE<uint64_t>(in + 8);
+    footer.manifestChunks = getLE<uint64_t>(in + 16);
+    footer.rawSize = getLE<uint64_t>(in + 24);
+    footer.manifestSize = getLE<uint64_t>(in + 32);
+    footer.indexCrc = getLE<uint32_t>(in + 40);
+    return footer;
+}
+
+// 清单布局: magic(4) count(8)，之后每项:
+//   pathLen(4) path typeflag(1) hasHash(1) size(8) mtime(8) headerOffset(8) [sha256(32)]
+std::vector<uint8_t> encodeManifest(const std::vector<ManifestEntry>& entries) {
+    std::vector<uint8_t> out(MANIFEST_HEADER_SIZE);
+    encodeManifestHeader(entries.size(), out.data());
+    for (const auto& entry : entries) appendManifestEntry(entry, out);
+    return out;
+}
+
+void encodeManifestHeader(uint64_t count, uint8_t* out) {
+    std::memcpy(out, MANIFEST_MAGIC, 4);
+    putLE<uint64_t>(out + 4, count);
+}
+
+void appendManifestEntry(const ManifestEntry& entry, std::vector<uint8_t>& out) {
+    size_t pos = out.size();
+    out.resize(pos + 4 + entry.path.size() + 26 + (entry.hasHash ? entry.sha256.size() : 0));
+    uint8_t* p = out.data() + pos;
+    putLE<uint32_t>(p, static_cast<uint32_t>(entry.path.size()));
+    p += 4;
+    std::memcpy(p, entry.path.data(), entry.path.size());
+    p += entry.path.size();
+    p[0] = static_cast<uint8_t>(entry.typeflag);
+    p[1] = entry.hasHash ? 1 : 0;
+    putLE<uint64_t>(p + 2, entry.size);
+    putLE<uint64_t>(p + 10, static_cast<uint64_t>(entry.mtime));
+    putLE<uint64_t>(p + 18, entry.headerOffset);
+    if (entry.hasHash) std::memcpy(p + 26, entry.sha256.data(), entry.sha256.size());
+}
+
+uint64_t decodeManifestHeader(const uint8_t* in, size_t len) {
+    if (len < MANIFEST_HEADER_SIZE) throw std::runtime_error("文件清单损坏 (长度越界)。");
+    if (std::memcmp(in, MANIFEST_MAGIC, 4) != 0) {
+        throw std::runtime_error("文件清单损坏 (魔数错误)。");
+    }
+    return getLE<uint64_t>(in + 4);
+}
+
+size_t decodeManifestEntry(const uint8_t* in, size_t len, ManifestEntry& entry) {
+    if (len < 4) return 0;
+    uint32_t pathLen = getLE<uint32_t>(in);
+    size_t fixed = 4 + static_cast<size_t>(pathLen) + 26;
+    if (len < fixed) return 0;
+    const uint8_t* p = in + 4 + pathLen;
+    bool hasHash = p[1] != 0;
+    size_t total = fixed + (hasHash ? entry.sha256.size() : 0);
+    if (len < total) return 0;
+
+    entry.path.assign(reinterpret_cast<const char*>(in + 4), pathLen);
+    entry.typeflag = static_cast<char>(p[0]);
+    entry.hasHash = hasHash;
+    entry.size = getLE<uint64_t>(p + 2);
+    entry.mtime = static_cast<time_t>(getLE<uint64_t>(p + 10));
+    entry.headerOffset = getLE<uint64_t>(p + 18);
+    if (hasHash) std::memcpy(entry.sha256.data(), p + 26, entry.sha256.size());
+    else entry.sha256 = Sha256Digest{};
+    return total;
+}
+
+std::vector<ManifestEntry> decodeManifest(const uint8_t* in, size_t len) {
+    uint64_t count = decodeManifestHeader(in, len);
+    size_t pos = MANIFEST_HEADER_SIZE;
+
+    std::vector<ManifestEntry> entries;
+    // 每项至少 30 字节，据此限制预分配，防止损坏的计数导致超大内存分配
+    entries.reserve(static_cast<size_t>(std::min<uint64_t>(count, (len - pos) / 30)));
+    for (uint64_t i = 0; i < count; ++i) {
+        ManifestEntry entry;
+        size_t n = decodeManifestEntry(in + pos, len - pos, entry);
+        if (n == 0) throw std::runtime_error("文件清单损坏 (长度越界)。");
+        pos += n;
+        entries.push_back(std::move(entry));
+    }
+    if (pos != len) {
+        throw std::runtime_error("文件清单损坏 (多余数据)。");
+    }
+    return entries;
+}
+
+bool isChunkedArchive(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[4] = {0};
+    if (!file.read(magic, sizeof(magic))) return false;
+    return std::memcmp(magic, ARCHIVE_MAGIC, 4) == 0;
+}
+
+ArchiveHeader readArchiveHeader(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    uint8_t buf[ARCHIVE_HEADER_SIZE];
+    if (!file.read(reinterpret_cast<char*>(buf), sizeof(buf))) {
+        throw std::runtime_error("无法读取备份文件头部: " + path);
+    }
+    return decodeArchiveHeader(buf);
+}
+
+} // namespace Backup
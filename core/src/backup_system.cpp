@@ -3,19 +3,40 @@
 #include "packer.h"
 #include "compressor.h"
 #include "encryptor.h"
+#include "pipeline.h"
+#include "archive_format.h"
+#include "mapped_file.h"
+#include "hasher.h"
+#include "bounded_queue.h"
 #include "common.h"
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <stdexcept>
-#include <regex>
 #include <chrono>
+#include <memory>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <iterator>
+#include <future>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <set>
+#include <sys/stat.h>
 
 namespace Backup {
 
+const char* DELTA_TOMBSTONE_NAME = ".fbk_tombstones";
+
 BackupSystem::BackupSystem() 
     : m_compressionAlgo(static_cast<int>(CompressionAlgorithm::LZSS)), 
-      m_isEncrypted(false) {
+      m_isEncrypted(false),
+      m_readOrder(ReadOrder::TRAVERSAL),
+      m_oneFileSystem(false) {
       m_filter.enabled = false; // 默认不启用过滤器
 }
 
@@ -33,6 +54,47 @@ void BackupSystem::setPassword(const std::string& password) {
 void BackupSystem::setFilter(const Filter& filter) {
     m_filter = filter;
     m_filter.enabled = true;
+    m_compiledFilter = std::make_shared<const CompiledFilter>(m_filter);
+}
+
+void BackupSystem::setReadOrder(ReadOrder order) {
+    m_readOrder = order;
+}
+
+void BackupSystem::setOneFileSystem(bool enabled) {
+    m_oneFileSystem = enabled;
+}
+
+void BackupSystem::setExcludedFileSystems(const std::vector<std::string>& fsTypes) {
+    m_excludedFileSystems = fsTypes;
+}
+
+void BackupSystem::setResourcePolicy(const ResourcePolicy& policy) {
+    m_resources = policy;
+}
+
+PipelineOptions BackupSystem::pipelineOptions() const {
+    PipelineOptions options;
+    options.workers = m_resources.maxThreads;
+    return options;
+}
+
+ArchiveSink BackupSystem::throttled(Throttle& throttle, const ArchiveSink& sink, const ResourcePolicy& policy) {
+    if (!policy.limitsRate()) return sink;
+    return [&throttle, sink](const char* data, size_t len) {
+        throttle.consume(len);
+        sink(data, len);
+    };
+}
+
+void BackupSystem::setCancelFlag(const std::atomic<bool>* cancel) {
+    m_cancel = cancel;
+}
+
+void BackupSystem::checkCancelled() const {
+    if (m_cancel && m_cancel->load()) {
+        throw std::runtime_error("备份已取消。");
+    }
 }
 
 // ---------------------------------------------------------
@@ -47,8 +109,7 @@ bool BackupSystem::backup(const std::string& srcDir, const std::string& dstPath)
     if (sourcePath.has_relative_path() && sourcePath.filename().empty()) {
         sourcePath = sourcePath.parent_path();
     }
-    std::string rootName = sourcePath.filename().string();
-    if (rootName.empty()) rootName = "backup_root";
+    std::string rootName = sourceRootName(srcDir);
 
     // 2. 解析目标路径
     std::filesystem::path finalDstPath;
@@ -95,209 +156,336 @@ bool BackupSystem::backup(const std::string& srcDir, const std::string& dstPath)
 
     std::string targetFileStr = finalDstPath.string();
 
-    // 1. 遍历文件 (Traverse)
-    Traverser traverser;
-    std::vector<FileInfo> files = traverser.traverse(srcDir);
-    if (files.empty()) {
-        throw std::runtime_error("源目录为空或无效。");
-    }
-    std::cout << "[Backup] Scanned " << files.size() << " files." << std::endl;
-
-
-    if (m_filter.enabled) {
-        files = applyFilter(files);
-        std::cout << "[Backup] After filtering, " << files.size() << " files remain." << std::endl;
-        if (files.empty()) {
-            throw std::runtime_error("没有文件符合过滤条件。");
+    // 1. 遍历 -> 过滤 -> 打包 -> 压缩 -> 加密 -> 写入
+    // 遍历以流式方式进行，条目一经发现就交给打包阶段，扫描与读取、压缩同时进行；
+    // 排除规则在遍历时剪枝，内存中只保留有限个数据块，与文件数无关
+    std::unique_ptr<Encryptor> encryptor = makeEncryptor();
+    BackupPipeline pipeline(static_cast<CompressionAlgorithm>(m_compressionAlgo), encryptor.get(), pipelineOptions());
+    // 系统压力过高时先等待（准入控制），之后按读取的字节数限速
+    Throttle throttle(m_resources, m_cancel);
+    throttle.waitForCapacity();
+
+    uint64_t scanned = 0;
+    uint64_t packed = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    PipelineStats stats = pipeline.run([&](const ArchiveSink& rawSink) {
+        ArchiveSink sink = throttled(throttle, rawSink, m_resources);
+        Traverser traverser(traverseOptions());
+        Packer packer;
+        packer.setReadOrder(m_readOrder);
+        traverser.traverse(srcDir, [&](FileInfo& file) {
+            checkCancelled();
+            ++scanned;
+            if (m_filter.enabled && !m_compiledFilter->matches(file)) return;
+            // 相对路径加上根目录前缀
+            if (!file.relativePath.empty()) file.relativePath = rootName + "/" + file.relativePath;
+            packer.packEntry(file, sink);
+            ++packed;
+        });
+        if (scanned == 0) {
+            throw std::runtime_error("源目录为空或无效。");
         }
-    }
-
-    // 修改所有文件的相对路径，加上根目录前缀
-    for (auto& file : files) {
-        if (file.relativePath.empty()) continue;
-        if (file.relativePath[0] == '/' || file.relativePath[0] == '\\') {
-                file.relativePath = rootName + file.relativePath;
-        } else {
-                file.relativePath = rootName + "/" + file.relativePath;
+        if (packed == 0) {
+            throw std::runtime_error("没有文件符合过滤条件。");
         }
-    }
-    // --------------------
-
-
-    // 2. 打包 (Pack)
-    
-    std::string tempTarFile = targetFileStr + ".tmp.tar";
-    Packer packer;
-    if (!packer.pack(files, tempTarFile)) {
-        throw std::runtime_error("打包失败。");
-    }
-
-    // 读取打包后的数据到内存
-    std::vector<uint8_t> data = readFile(tempTarFile);
-    std::filesystem::remove(tempTarFile); // 删除临时文件
-    std::cout << "[Backup] Packed size: " << data.size() << " bytes." << std::endl;
-
-    // 3. 压缩 (Compress)
-    Compressor compressor;
-    auto start = std::chrono::high_resolution_clock::now();
-    std::vector<uint8_t> compressedData = compressor.compress(data, static_cast<CompressionAlgorithm>(m_compressionAlgo));
+        packer.packEnd(sink);
+    }, targetFileStr);
     auto end =  std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(end - start).count();
-    std::cout << "[Backup] Compression took " << duration << " s." << std::endl;
-    std::cout << "[Backup] Compressed size: " << compressedData.size() << " bytes." << std::endl;
-    
-    // 释放原始数据内存
-    std::vector<uint8_t>().swap(data); 
-
-    // 4. 加密 (Encrypt) - 如果设置了密码
-    std::vector<uint8_t> finalData;
-    if (m_isEncrypted) {
-        Encryptor encryptor;
-        encryptor.init(m_password);
-        finalData = encryptor.encrypt(compressedData);
-        std::cout << "[Backup] Encrypted size: " << finalData.size() << " bytes." << std::endl;
-    } else {
-        finalData = std::move(compressedData);
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    std::cout << "[Backup] Scanned " << scanned << " files." << std::endl;
+    if (m_filter.enabled) {
+        std::cout << "[Backup] After filtering, " << packed << " files remain." << std::endl;
     }
-
-    // 5. 写入目标文件
-    if (!writeFile(targetFileStr, finalData)) {
-        throw std::runtime_error("无法写入目标文件。");
+    std::cout << "[Backup] Packed size: " << stats.rawBytes << " bytes in " << stats.chunks << " chunks." << std::endl;
+    std::cout << "[Backup] Stored size: " << stats.storedBytes << " bytes." << std::endl;
+    std::cout << "[Backup] Pipeline took " << duration << " ms." << std::endl;
+    if (throttle.paused().count() > 0) {
+        std::cout << "[Backup] Paused " << throttle.paused().count() << " ms under system pressure." << std::endl;
     }
 
     std::cout << "[Backup] Success!" << std::endl;
     return true;
 }
 
-std::string escapeRegex(const std::string& str) {
-    // 需要转义的字符: . ^ $ | ( ) [ ] { } * + ? \
-    // static const std::regex specialChars{R"([-[\]{}()*+?.,\^$|#\s])"};
-    static const std::regex specialChars{R"([\[\]{}()*+?.,\^$|#\s-])"};
-    return std::regex_replace(str, specialChars, R"(\$&)");
-}
+// ---------------------------------------------------------
+// 增量备份：只打包变化的文件 + 墓碑
+// ---------------------------------------------------------
 
-std::vector<FileInfo> BackupSystem::applyFilter(const std::vector<FileInfo>& files) {
-    std::vector<FileInfo> results;
-    std::regex namePattern;
-    bool useRegex = false;
+// 路径本身或任一上级目录被排除规则排除
+static bool excludedByRules(const CompiledFilter& filter, const std::string& relativePath) {
+    for (size_t pos = relativePath.find('/'); pos != std::string::npos; pos = relativePath.find('/', pos + 1)) {
+        if (filter.excluded(relativePath.substr(0, pos), true)) return true;
+    }
+    return filter.excluded(relativePath, false);
+}
 
-    if (!m_filter.nameKeywords.empty()) {
-        std::string combinedPattern = ".*(";
-        for (size_t i = 0; i < m_filter.nameKeywords.size(); ++i) {
-            if (i > 0) combinedPattern += "|";
-            combinedPattern += escapeRegex(m_filter.nameKeywords[i]);
-        }
-        combinedPattern += ").*"; // 匹配文件名中包含任意关键词
-        
+bool BackupSystem::backupDelta(const std::string& srcDir, const std::vector<std::string>& changed,
+                               const std::vector<std::string>& removed, const std::string& dstFile) {
+    std::cout << "[Backup] Starting delta backup: " << srcDir << " -> " << dstFile << std::endl;
+    std::string rootName = sourceRootName(srcDir);
+    std::filesystem::path dstPath(dstFile);
+    if (dstPath.has_parent_path()) std::filesystem::create_directories(dstPath.parent_path());
+
+    Traverser traverser(traverseOptions());
+    FileInfo root = traverser.statEntry(srcDir, "");
+    root.relativePath = rootName;
+
+    // 按路径排序去重，归档内容与调用者的集合顺序无关
+    std::set<std::string> tombstones(removed.begin(), removed.end());
+    std::vector<FileInfo> files;
+    for (const auto& path : std::set<std::string>(changed.begin(), changed.end())) {
+        FileInfo file;
         try {
-            namePattern = std::regex(combinedPattern);
-            useRegex = true;
-            // std::cout << "[Filter] Generated Regex from Keywords: " << combinedPattern << std::endl;
-        } catch (...) {
-            std::cerr << "[Filter] Error generating regex from keywords." << std::endl;
+            file = traverser.statEntry(srcDir, path);
+        } catch (const std::runtime_error&) {
+            tombstones.insert(path); // 变化之后又被删除
+            continue;
         }
-    } 
-    else if (!m_filter.nameRegex.empty()) {
-        namePattern = std::regex(m_filter.nameRegex);
-        useRegex = true;
-    }
-    for (const auto& file : files) {
-        if (file.type == FileType::DIRECTORY) {
-            results.push_back(file);
+        if (file.type == FileType::DIRECTORY) continue;
+        // 不再符合过滤条件的文件与完整备份一致：从备份中删除
+        if (m_filter.enabled && (excludedByRules(*m_compiledFilter, path) || !m_compiledFilter->matches(file))) {
+            tombstones.insert(path);
             continue;
         }
+        tombstones.erase(path);
+        file.relativePath = rootName + "/" + path;
+        files.push_back(std::move(file));
+    }
 
-        if (m_filter.minSize > 0 && file.size < m_filter.minSize) continue;
-        if (m_filter.maxSize > 0 && file.size > m_filter.maxSize) continue;
-
-        if (m_filter.startTime > 0 && file.lastModified < m_filter.startTime) continue;
-        if (m_filter.endTime > 0 && file.lastModified > m_filter.endTime) continue;
-
-        if (!m_filter.userName.empty() && file.userName != m_filter.userName) continue;
+    // 整个目录被删除时，源目录中已不存在的上级目录一并记为删除
+    std::set<std::string> ancestors;
+    for (const auto& path : tombstones) {
+        for (size_t pos = path.rfind('/'); pos != std::string::npos && pos > 0; pos = path.rfind('/', pos - 1)) {
+            std::string dir = path.substr(0, pos);
+            struct stat dirStat;
+            if (lstat((std::filesystem::path(srcDir) / dir).c_str(), &dirStat) == 0) break;
+            ancestors.insert(dir);
+        }
+    }
+    tombstones.insert(ancestors.begin(), ancestors.end());
+
+    // 墓碑列表先写入目标旁的临时文件，再作为最后一个条目打包
+    std::string tombstoneFile = dstFile + ".tombstones";
+    {
+        std::ofstream out(tombstoneFile, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("无法写入临时文件: " + tombstoneFile);
+        for (const auto& path : tombstones) out.write(path.c_str(), path.size() + 1);
+    }
 
-        if (!m_filter.suffixes.empty()) {
-            bool suffixMatch = false;
-            for (const auto& suffix : m_filter.suffixes) {
-                if (file.relativePath.size() >= suffix.size() && file.relativePath.substr(file.relativePath.size() - suffix.size(), suffix.size()) == suffix) {
-                    suffixMatch = true;
-                    break;
-                }
+    std::unique_ptr<Encryptor> encryptor = makeEncryptor();
+    PipelineOptions options = pipelineOptions();
+    options.delta = true;
+    BackupPipeline pipeline(static_cast<CompressionAlgorithm>(m_compressionAlgo), encryptor.get(), options);
+    Throttle throttle(m_resources, m_cancel);
+    PipelineStats stats;
+    try {
+        throttle.waitForCapacity();
+        FileInfo tombstone = traverser.statEntry(dstPath.parent_path().string(), std::filesystem::path(tombstoneFile).filename().string());
+        tombstone.relativePath = rootName + "/" + DELTA_TOMBSTONE_NAME;
+        stats = pipeline.run([&](const ArchiveSink& rawSink) {
+            ArchiveSink sink = throttled(throttle, rawSink, m_resources);
+            Packer packer;
+            packer.setReadOrder(m_readOrder);
+            packer.packEntry(root, sink);
+            for (const auto& file : files) {
+                checkCancelled();
+                packer.packEntry(file, sink);
             }
-            if (!suffixMatch) continue;
-        }
+            packer.packEntry(tombstone, sink);
+            packer.packEnd(sink);
+        }, dstFile);
+    } catch (...) {
+        std::filesystem::remove(tombstoneFile);
+        throw;
+    }
+    std::filesystem::remove(tombstoneFile);
 
-        if (useRegex && !std::regex_search(file.relativePath, namePattern)) continue;
+    std::cout << "[Backup] Delta: " << files.size() << " changed, " << tombstones.size() << " removed." << std::endl;
+    std::cout << "[Backup] Stored size: " << stats.storedBytes << " bytes." << std::endl;
+    std::cout << "[Backup] Success!" << std::endl;
+    return true;
+}
 
-        // 不包含相对路径的写法
-        // if (!m_filter.nameRegex.empty()) {
-        //     std::filesystem::path p(file.relativePath);
-        //     std::string fname = p.filename().string();
-        //     if (!std::regex_match(fname, namePattern)) continue;
-        // }
+bool BackupSystem::isDeltaArchive(const std::string& backupFile) {
+    // 由头部标记判定：源目录中同名的普通文件不会让完整备份被当作增量备份
+    if (!isChunkedArchive(backupFile)) return false;
+    return (readArchiveHeader(backupFile).flags & ARCHIVE_FLAG_DELTA) != 0;
+}
 
-        results.push_back(file);
-    }
-    return results;
+TraverseOptions BackupSystem::traverseOptions() const {
+    TraverseOptions options;
+    options.threads = m_resources.maxThreads;   // 0 表示按核数并行遍历
+    options.sortEntries = true;     // 归档中的条目顺序与 readdir 顺序无关
+    if (m_filter.enabled) options.filter = m_compiledFilter;
+    options.oneFileSystem = m_oneFileSystem;
+    options.excludeFsTypes = m_excludedFileSystems;
+    return options;
 }
 
 // ---------------------------------------------------------
 // 核心功能 2: 数据还原
 // ---------------------------------------------------------
 bool BackupSystem::restore(const std::string& srcFile, const std::string& dstDir) {
+    restoreArchive(srcFile, dstDir);
+    return true;
+}
+
+std::filesystem::path BackupSystem::restoreArchive(const std::string& srcFile, const std::string& dstDir) {
     std::cout << "[Restore] Starting restore: " << srcFile << " -> " << dstDir << std::endl;
 
-    // 1. 读取备份文件
-    std::vector<uint8_t> data = readFile(srcFile);
-    if (data.empty()) {
-        throw std::runtime_error("备份文件为空或无法读取。");
+    std::string rootName;
+    std::filesystem::path finalDestPath;
+    std::string unpackDir;
+    bool result = false;
+
+    // 预读第一个 TAR 头部得到根目录名称，确定解包目录后再把这部分数据接回流中
+    auto unpackStream = [&](const ArchiveSource& source) {
+        char firstBlock[BLOCK_SIZE];
+        size_t got = readFully(source, firstBlock, sizeof(firstBlock));
+        rootName = readRootName(reinterpret_cast<const uint8_t*>(firstBlock), got);
+        if (rootName.empty()) rootName = "restored_files"; // 兜底
+        unpackDir = prepareRestoreDir(dstDir, rootName, finalDestPath);
+
+        size_t replayed = 0;
+        ArchiveSource replay = [&](char* buf, size_t len) -> size_t {
+            if (replayed < got) {
+                size_t n = std::min(len, got - replayed);
+                std::memcpy(buf, firstBlock + replayed, n);
+                replayed += n;
+                return n;
+            }
+            return source(buf, len);
+        };
+
+        Packer packer;
+        result = packer.unpack(replay, unpackDir);
+    };
+
+    if (isChunkedArchive(srcFile)) {
+        // 读取 -> 并行解密/解压 -> 按序解包，提取与解码同时进行
+        std::unique_ptr<Encryptor> encryptor = makeEncryptor();
+        RestorePipeline pipeline(encryptor.get());
+        pipeline.run(srcFile, unpackStream);
+    } else {
+        // 旧格式：整体解密、解压后直接从内存解包
+        std::vector<uint8_t> tarData = decodeLegacy(srcFile);
+        size_t pos = 0;
+        unpackStream([&](char* buf, size_t len) -> size_t {
+            size_t n = std::min(len, tarData.size() - pos);
+            std::memcpy(buf, tarData.data() + pos, n);
+            pos += n;
+            return n;
+        });
     }
 
-    // 2. 解密 (Decrypt) - 如果设置了密码
-    if (m_isEncrypted) {
-        std::cout << "[Restore] Decrypting..." << std::endl;
-        Encryptor encryptor;
-        encryptor.init(m_password);
-        try {
-            data = encryptor.decrypt(data);
-        } catch (const std::exception& e) {
-            throw std::runtime_error("解密失败。密码错误？");
+    // 将解压后的目录从临时目录中取出来
+    bool isConflict = (unpackDir != dstDir);
+    if (result && isConflict) {
+        std::filesystem::path tempRoot = std::filesystem::path(unpackDir) / rootName;
+        if (std::filesystem::exists(tempRoot)) {
+            std::filesystem::rename(tempRoot, finalDestPath);
         }
+        std::filesystem::remove_all(unpackDir);
     }
 
-    // 3. 解压 (Decompress)
-    std::cout << "[Restore] Decompressing..." << std::endl;
-    Compressor compressor;
-    std::vector<uint8_t> tarData;
-    try {
-        tarData = compressor.decompress(data);
-    } catch (const std::exception& e) {
-        throw std::runtime_error("解压失败。数据损坏？");
+    if (result) {
+        std::cout << "[Restore] Restored to: " << finalDestPath.string() << std::endl;
+    } else {
+        throw std::runtime_error("解包失败。");
     }
-    
-    // 释放压缩数据内存
-    std::vector<uint8_t>().swap(data);
+    return finalDestPath;
+}
 
-    // 2. 预读 TAR 包中的根目录名称
-    std::string rootName;
-    if (tarData.size() > 100) {
-        // TAR 头部前100字节是文件名
-        char nameBuf[101] = {0};
-        std::memcpy(nameBuf, tarData.data(), 100);
-        std::string firstPath(nameBuf);
-        
-        size_t slashPos = firstPath.find('/');
-        if (slashPos != std::string::npos && slashPos > 0) {
-            rootName = firstPath.substr(0, slashPos);
-        } else {
-            rootName = firstPath; // 只有文件名，没有目录的情况
+bool BackupSystem::restoreChain(const std::vector<std::string>& archives, const std::string& dstDir) {
+    if (archives.empty()) {
+        throw std::runtime_error("备份链为空。");
+    }
+    if (isDeltaArchive(archives.front())) {
+        throw std::runtime_error("备份链必须从完整备份开始: " + archives.front());
+    }
+    std::filesystem::path root = restoreArchive(archives.front(), dstDir);
+    for (size_t i = 1; i < archives.size(); ++i) {
+        std::cout << "[Restore] Applying delta: " << archives[i] << std::endl;
+        applyDelta(archives[i], root);
+    }
+    std::cout << "[Restore] Restored chain of " << archives.size() << " backups to: " << root.string() << std::endl;
+    return true;
+}
+
+void BackupSystem::applyDelta(const std::string& deltaFile, const std::filesystem::path& targetRoot) {
+    namespace fs = std::filesystem;
+    if (!isDeltaArchive(deltaFile)) {
+        throw std::runtime_error("不是增量备份: " + deltaFile);
+    }
+    // 先解包到目标旁的临时目录，再删除墓碑中的路径，最后把变化的条目逐个移入目标
+    fs::path staging = targetRoot.parent_path() / (".tmp_delta_" + std::to_string(std::time(nullptr)));
+    fs::create_directories(staging);
+    try {
+        fs::path deltaRoot = restoreArchive(deltaFile, staging.string());
+        fs::path tombstonePath = deltaRoot / DELTA_TOMBSTONE_NAME;
+        std::ifstream in(tombstonePath, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("不是增量备份: " + deltaFile);
+        }
+        std::string path;
+        while (std::getline(in, path, '\0')) {
+            if (!path.empty()) fs::remove_all(pathInside(targetRoot, path));
         }
+        in.close();
+        fs::remove(tombstonePath);
+
+        std::vector<fs::path> entries;
+        for (const auto& entry : fs::recursive_directory_iterator(deltaRoot)) entries.push_back(entry.path());
+        for (const auto& source : entries) {
+            fs::path dest = pathInside(targetRoot, source.lexically_relative(deltaRoot));
+            fs::file_status destStatus = fs::symlink_status(dest);
+            if (fs::is_directory(fs::symlink_status(source))) {
+                if (!fs::is_directory(destStatus)) {
+                    if (fs::exists(destStatus)) fs::remove(dest);
+                    fs::create_directories(dest);
+                }
+                continue;
+            }
+            if (fs::is_directory(destStatus)) fs::remove_all(dest);
+            fs::rename(source, dest);
+        }
+    } catch (...) {
+        fs::remove_all(staging);
+        throw;
     }
+    fs::remove_all(staging);
+}
 
-    if (rootName.empty()) rootName = "restored_files"; // 兜底
+std::filesystem::path BackupSystem::pathInside(const std::filesystem::path& root, const std::filesystem::path& relative) {
+    namespace fs = std::filesystem;
+    // 增量备份可能被篡改或损坏：只接受严格位于根目录之下的相对路径
+    if (relative.empty() || relative.has_root_path()) {
+        throw std::runtime_error("增量备份包含非法路径: " + relative.string());
+    }
+    for (const auto& part : relative) {
+        if (part == "..") throw std::runtime_error("增量备份包含非法路径: " + relative.string());
+    }
+    fs::path base = root.lexically_normal();
+    fs::path target = (root / relative).lexically_normal();
+    fs::path inside = target.lexically_relative(base);
+    if (inside.empty() || inside == "." || *inside.begin() == "..") {
+        throw std::runtime_error("增量备份包含非法路径: " + relative.string());
+    }
+    // 中间目录不能是符号链接，否则删除或移入会落到根目录之外
+    fs::path current = base;
+    for (auto it = inside.begin(); std::next(it) != inside.end(); ++it) {
+        current /= *it;
+        if (fs::is_symlink(fs::symlink_status(current))) {
+            throw std::runtime_error("增量备份路径经过符号链接: " + relative.string());
+        }
+    }
+    return target;
+}
 
-    // 3. 检查冲突并计算最终目标名称
+std::string BackupSystem::prepareRestoreDir(const std::string& dstDir, const std::string& rootName, std::filesystem::path& finalDestPath) {
+    // 检查冲突并计算最终目标名称
     std::filesystem::path targetBasePath = std::filesystem::path(dstDir) / rootName;
-    std::filesystem::path finalDestPath = targetBasePath;
+    finalDestPath = targetBasePath;
     int counter = 1;
 
     // 如果目标目录已存在，则添加后缀 _1, _2 等
@@ -305,107 +493,475 @@ bool BackupSystem::restore(const std::string& srcFile, const std::string& dstDir
         finalDestPath = std::filesystem::path(dstDir) / (rootName + "_" + std::to_string(counter++));
     }
 
-    bool isConflict = (finalDestPath != targetBasePath);
-    std::string unpackDir = dstDir;
+    if (finalDestPath == targetBasePath) return dstDir;
 
-    // 4. 执行解压
-    if (isConflict) {
-        // 如果有冲突，我们需要先解压到一个临时目录，然后重命名
-        // 例如：dstDir/.tmp_restore_xyz/RootName
-        std::string tempFolderName = ".tmp_restore_" + std::to_string(std::time(nullptr));
-        std::filesystem::path tempExtractPath = std::filesystem::path(dstDir) / tempFolderName;
-        std::filesystem::create_directories(tempExtractPath);
-        unpackDir = tempExtractPath.string();
-    }
+    // 如果有冲突，我们需要先解压到一个临时目录，然后重命名
+    // 例如：dstDir/.tmp_restore_xyz/RootName
+    std::string tempFolderName = ".tmp_restore_" + std::to_string(std::time(nullptr));
+    std::filesystem::path tempExtractPath = std::filesystem::path(dstDir) / tempFolderName;
+    std::filesystem::create_directories(tempExtractPath);
+    return tempExtractPath.string();
+}
 
-    // 4. 解包 (Unpack)
-    //同样，Packer::unpack 需要读取文件。我们先把数据写入临时文件。
-    std::string tempTarFile = srcFile + ".tmp.tar";
-    if (!writeFile(tempTarFile, tarData)) {
-        throw std::runtime_error("无法创建临时文件。");
+// ---------------------------------------------------------
+// 核心功能 3: 备份验证
+// ---------------------------------------------------------
+bool BackupSystem::verify(const std::string& backupFile) {
+    verify(backupFile, VerifyMode::DEEP);
+    return true;
+}
+
+VerifyReport BackupSystem::verify(const std::string& backupFile, VerifyMode mode, double fraction) {
+    std::cout << "[Verify] Verifying backup: " << backupFile << std::endl;
+    // 验证逻辑：逐块解码（校验 CRC）-> 流式遍历 tar 结构 ->（DEEP）比对文件哈希
+    // 整个过程只持有流水线中的少量块，不会在内存中展开整个归档。
+
+    VerifyReport report;
+    bool chunked = isChunkedArchive(backupFile);
+    if (mode == VerifyMode::SAMPLE) {
+        if (!(fraction > 0.0 && fraction <= 1.0)) {
+            throw std::runtime_error("抽样比例必须在 (0, 1] 范围内。");
+        }
+        if (chunked) return verifySample(backupFile, fraction);
+        std::cout << "[Verify] Legacy archive has no chunk index, falling back to a full check." << std::endl;
+    }
+    bool deep = (mode == VerifyMode::DEEP) && chunked;
+    if (mode == VerifyMode::DEEP && !chunked) {
+        std::cout << "[Verify] Legacy archive has no manifest, checking structure only." << std::endl;
     }
 
-    Packer packer;
-    bool result = packer.unpack(tempTarFile, unpackDir);
-    
-    std::filesystem::remove(tempTarFile); // 删除临时文件
+    std::unique_ptr<Encryptor> encryptor = makeEncryptor();
+    // 清单条目按 tar 顺序写入，随 tar 流逐项读取，只持有当前的清单块
+    std::unique_ptr<ArchiveReader> manifestFile;
+    std::unique_ptr<ManifestReader> manifest;
+    if (deep) {
+        manifestFile = std::make_unique<ArchiveReader>(backupFile, encryptor.get(), MappedFile::Access::RANDOM);
+        manifest = std::make_unique<ManifestReader>(*manifestFile);
+    }
 
-    // 将解压后的目录从临时目录中取出来
-    if (result && isConflict) {
-        std::filesystem::path tempRoot = std::filesystem::path(unpackDir) / rootName;
-        if (std::filesystem::exists(tempRoot)) {
-            std::filesystem::rename(tempRoot, finalDestPath);
+    Sha256 hasher;
+    ManifestEntry expected;
+    TarWalker::Callbacks callbacks;
+    callbacks.onEntry = [&](const TarEntry& entry, uint64_t headerOffset) {
+        ++report.entries;
+        if (!deep) return;
+        if (!manifest->next(expected) || expected.path != entry.path || expected.headerOffset != headerOffset) {
+            throw std::runtime_error("文件清单与备份内容不一致: " + entry.path);
         }
-        std::filesystem::remove_all(unpackDir);
+        hasher.reset();
+    };
+    callbacks.onData = [&](const uint8_t* data, size_t len) {
+        report.bytes += len;
+        if (deep) hasher.update(data, len);
+    };
+    callbacks.onEntryEnd = [&] {
+        if (!deep) return;
+        if (!expected.hasHash) return;
+        if (hasher.finish() != expected.sha256) {
+            throw std::runtime_error("文件内容校验失败: " + expected.path);
+        }
+        ++report.filesHashed;
+    };
+    TarWalker walker(std::move(callbacks));
+
+    if (chunked) {
+        RestorePipeline pipeline(encryptor.get());
+        PipelineStats stats = pipeline.run(backupFile, [&](const ArchiveSource& source) {
+            std::vector<char> buffer(64 * 1024);
+            size_t n;
+            while ((n = source(buffer.data(), buffer.size())) > 0) {
+                walker.feed(reinterpret_cast<const uint8_t*>(buffer.data()), n);
+            }
+            walker.finish();
+        });
+        report.chunksTotal = stats.chunks;
+        report.chunksChecked = stats.chunks;
+        report.coverage = 1.0;
+        if (deep && manifest->next(expected)) {
+            throw std::runtime_error("文件清单与备份内容不一致 (条目数不符)。");
+        }
+    } else {
+        // 旧格式：整体解密、解压后遍历 tar 结构
+        std::vector<uint8_t> tarData = decodeLegacy(backupFile); // 如果密码错、压缩数据坏，这里会抛出异常
+        walker.feed(tarData.data(), tarData.size());
+        walker.finish();
+        report.coverage = 1.0;
     }
 
-    if (result) {
-        std::cout << "[Restore] Restored to: " << finalDestPath.string() << std::endl;
-    } else {
-        throw std::runtime_error("解包失败。");
+    std::cout << "[Verify] Backup is valid: " << report.entries << " entries, " << report.bytes << " bytes";
+    if (deep) std::cout << ", " << report.filesHashed << " files hashed";
+    std::cout << "." << std::endl;
+    return report;
+}
+
+VerifyReport BackupSystem::verifySample(const std::string& backupFile, double fraction) {
+    std::unique_ptr<Encryptor> encryptor = makeEncryptor();
+    ArchiveReader reader(backupFile, encryptor.get(), MappedFile::Access::RANDOM);
+
+    // 1. 结构：头部、尾部（打开时已校验）与索引，不解码任何数据块
+    reader.checkIndex();
+    const ArchiveFooter& footer = reader.footer();
+    const std::vector<ChunkIndexEntry>& index = reader.index();
+
+    // 2. 文件清单给出每个 tar 头部在流中的位置，与按顺序抽取的块一起逐项前进，只持有当前的清单块
+    ManifestReader manifest(reader);
+    ManifestEntry item;
+    bool haveItem = manifest.next(item);
+
+    // 3. 随机抽取 tar 流的块（至少一个），按文件顺序解码
+    VerifyReport report;
+    report.chunksTotal = footer.chunkCount;
+    uint64_t want = static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(footer.chunkCount)));
+    want = std::min<uint64_t>(std::max<uint64_t>(want, 1), footer.chunkCount);
+
+    std::vector<uint64_t> all(footer.chunkCount);
+    std::iota(all.begin(), all.end(), 0);
+    std::vector<uint64_t> picked;
+    // 从前向迭代器抽样保持原有顺序：块按文件顺序解码，文件清单只需前进一遍
+    std::sample(all.begin(), all.end(), std::back_inserter(picked), want, std::mt19937_64(std::random_device{}()));
+
+    std::vector<uint8_t> raw;
+    Sha256 hasher;
+    for (uint64_t seq : picked) {
+        reader.readChunk(seq, raw);
+        ++report.chunksChecked;
+
+        // 块内完整包含的 tar 头部逐个校验，内容也在块内的文件直接比对哈希
+        uint64_t begin = index[seq].rawOffset;
+        uint64_t end = begin + raw.size();
+        while (haveItem && item.headerOffset < begin) haveItem = manifest.next(item);
+        for (; haveItem && item.headerOffset + BLOCK_SIZE <= end; haveItem = manifest.next(item)) {
+            const uint8_t* block = raw.data() + (item.headerOffset - begin);
+            TarEntry entry = TarWalker::decodeHeader(block, item.headerOffset);
+            if (entry.path != item.path || entry.size != item.size) {
+                throw std::runtime_error("文件清单与备份内容不一致: " + entry.path);
+            }
+            ++report.entries;
+
+            uint64_t dataEnd = item.headerOffset + BLOCK_SIZE + item.size;
+            if (item.hasHash && dataEnd <= end) {
+                hasher.reset();
+                hasher.update(block + BLOCK_SIZE, static_cast<size_t>(item.size));
+                if (hasher.finish() != item.sha256) {
+                    throw std::runtime_error("文件内容校验失败: " + item.path);
+                }
+                ++report.filesHashed;
+                report.bytes += item.size;
+            }
+        }
     }
-    return result;
+    // 读完剩余的清单条目：清单的条目数与长度总会被校验
+    while (haveItem) haveItem = manifest.next(item);
+
+    report.coverage = footer.chunkCount ? static_cast<double>(report.chunksChecked) / footer.chunkCount : 1.0;
+    std::cout << "[Verify] Sampled " << report.chunksChecked << "/" << report.chunksTotal << " chunks ("
+              << report.coverage * 100.0 << "% coverage), " << report.entries << " headers, "
+              << report.filesHashed << " files hashed. Structure is valid." << std::endl;
+    return report;
 }
 
 // ---------------------------------------------------------
-// 核心功能 3: 备份验证
+// 核心功能 4: 备份与源目录比对
 // ---------------------------------------------------------
-bool BackupSystem::verify(const std::string& backupFile) {
-    std::cout << "[Verify] Verifying backup: " << backupFile << std::endl;
-    // 验证逻辑：尝试解密 -> 尝试解压 -> 检查 Tar 头是否合法
-    // 如果全过程无异常抛出，则认为文件完整性基本没问题。
-    
-    // 用 restore 的前半部分逻辑，但不进行最后的 unpack 到磁盘
-    std::vector<uint8_t> data = readFile(backupFile);
-    if (data.empty()) throw std::runtime_error("备份文件为空或无法读取。");
 
-    if (m_isEncrypted) {
-        Encryptor encryptor;
-        encryptor.init(m_password);
-        data = encryptor.decrypt(data); // 如果密码错或数据坏，这里会抛出异常
+// 元数据比对，返回第一个不一致的字段（一致时返回空串）
+static std::string compareMetadata(const TarEntry& entry, const FileInfo& file) {
+    if (entry.typeflag != Packer::typeflagOf(file.type)) return "type";
+    if (entry.typeflag == '0' && entry.size != file.size) return "size";
+    if (entry.typeflag == '2' && entry.linkTarget != file.linkTarget.substr(0, 99)) return "link";
+    if ((entry.mode & 0777) != (file.permissions & 0777)) return "mode";
+    // 目录的修改时间随内容变化，不参与比对
+    if (entry.typeflag != '5' && entry.mtime != file.lastModified) return "mtime";
+    return "";
+}
+
+// 先序比较：逐段比较路径，'/' 视为最小的字符，父目录排在子条目之前。
+// 与排序遍历（每个目录内按名称排序）的输出顺序一致
+static int comparePreorder(const std::string& a, const std::string& b) {
+    size_t n = std::min(a.size(), b.size());
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char x = static_cast<unsigned char>(a[i]);
+        unsigned char y = static_cast<unsigned char>(b[i]);
+        if (x == y) continue;
+        if (x == '/') return -1;
+        if (y == '/') return 1;
+        return x < y ? -1 : 1;
     }
+    if (a.size() == b.size()) return 0;
+    return a.size() < b.size() ? -1 : 1;
+}
 
-    Compressor compressor;
-    std::vector<uint8_t> tarData = compressor.decompress(data); // 如果压缩数据坏，这里会抛出异常
+DiffReport BackupSystem::diff(const std::string& backupFile, const std::string& srcDir, bool deep) {
+    std::cout << "[Diff] Comparing backup " << backupFile << " with " << srcDir << std::endl;
 
-    // 简单检查 Tar 数据是否合法（至少要有 512 字节且包含 magic）
-    if (tarData.size() < 512) throw std::runtime_error("文件太小，不是有效的备份文件。");
-    
-    // 检查 ustar 标记
-    // magic 字段在偏移 257 处，长度 6，内容应该是 "ustar"
-    if (tarData.size() >= 263) {
-        std::string magic(reinterpret_cast<char*>(&tarData[257]), 5);
-        if (magic != "ustar") {
-            throw std::runtime_error("无效的备份文件格式 (Tar magic signature 错误)。");
+    // 1. 源目录在后台线程中排序遍历，条目经有界队列按先序交给比对；
+    // 备份中的条目也是按同样的顺序打包的，两边归并比对，内存占用与文件数无关
+    std::string rootName = sourceRootName(srcDir);
+    BoundedQueue<FileInfo> sourceQueue(4096);
+    std::exception_ptr sourceError;
+    std::thread sourceThread([&] {
+        try {
+            Traverser traverser(traverseOptions());
+            traverser.traverse(srcDir, [&](FileInfo& file) {
+                if (m_filter.enabled && !m_compiledFilter->matches(file)) return;
+                if (!file.relativePath.empty()) file.relativePath = rootName + "/" + file.relativePath;
+                if (!sourceQueue.push(std::move(file))) throw std::runtime_error("比对已中止。");
+            });
+        } catch (...) {
+            sourceError = std::current_exception();
         }
-    }
+        sourceQueue.close();
+    });
 
-    std::cout << "[Verify] Backup is valid." << std::endl;
-    return true;
+    DiffReport report;
+    try {
+        FileInfo source;
+        bool haveSource = sourceQueue.pop(source);
+
+        // 需要比对内容的文件记录期望哈希（来自文件清单，旧格式则在流中现算），
+        // 攒够一批后并行计算源文件哈希
+        struct HashCheck {
+            std::string path;
+            std::string absolutePath;
+            std::string detail;     // 内容一致时报告的元数据差异
+            Sha256Digest expected{};
+        };
+        const size_t HASH_BATCH = 1024;
+        std::vector<HashCheck> hashChecks;
+        auto flushHashes = [&] {
+            std::vector<std::string> results(hashChecks.size());
+            std::atomic<size_t> next{0};
+            auto hashWorker = [&] {
+                for (size_t i = next++; i < hashChecks.size(); i = next++) {
+                    const HashCheck& check = hashChecks[i];
+                    try {
+                        if (Sha256::ofFile(check.absolutePath) != check.expected) results[i] = "content";
+                        else results[i] = check.detail;
+                    } catch (const std::exception&) {
+                        results[i] = "content"; // 遍历之后被删除或无法读取
+                    }
+                }
+            };
+            unsigned int threads = std::max(1u, std::min<unsigned int>(std::thread::hardware_concurrency(),
+                                                                       static_cast<unsigned int>(hashChecks.size())));
+            std::vector<std::thread> hashThreads;
+            for (unsigned int t = 1; t < threads; ++t) hashThreads.emplace_back(hashWorker);
+            hashWorker();
+            for (auto& t : hashThreads) t.join();
+
+            for (size_t i = 0; i < hashChecks.size(); ++i) {
+                if (!results[i].empty()) report.entries.push_back({hashChecks[i].path, DiffKind::CHANGED, results[i]});
+            }
+            report.hashed += hashChecks.size();
+            hashChecks.clear();
+        };
+
+        // 2. 按先序逐个处理备份中的条目，先比对元数据；返回 true 时需要由调用者计算备份中的内容哈希
+        std::string lastPath;
+        bool first = true;
+        HashCheck pending;
+        auto onEntry = [&](const TarEntry& entry, const ManifestEntry* expected) {
+            ++report.compared;
+            if (!first && comparePreorder(lastPath, entry.path) >= 0) {
+                throw std::runtime_error("备份中的条目未按路径顺序排列，无法比对: " + entry.path);
+            }
+            first = false;
+            lastPath = entry.path;
+
+            // 源目录中排在该条目之前的条目在备份中不存在
+            while (haveSource && comparePreorder(source.relativePath, entry.path) < 0) {
+                report.entries.push_back({source.relativePath, DiffKind::ADDED, ""});
+                haveSource = sourceQueue.pop(source);
+            }
+            if (!haveSource || source.relativePath != entry.path) {
+                report.entries.push_back({entry.path, DiffKind::REMOVED, ""});
+                return false;
+            }
+            FileInfo file = std::move(source);
+            haveSource = sourceQueue.pop(source);
+
+            std::string detail = compareMetadata(entry, file);
+            bool sameSize = entry.typeflag == '0' && detail != "type" && detail != "size";
+            if (!sameSize || (detail.empty() && !deep)) {
+                if (!detail.empty()) report.entries.push_back({entry.path, DiffKind::CHANGED, detail});
+                return false;
+            }
+
+            // 常规文件且大小相同：元数据不同（可能只是被 touch）或 deep 时比对内容
+            HashCheck check;
+            check.path = std::move(file.relativePath);
+            check.absolutePath = std::move(file.absolutePath);
+            check.detail = detail;
+            if (expected && expected->hasHash && expected->path == entry.path) {
+                check.expected = expected->sha256;
+                hashChecks.push_back(std::move(check));
+                if (hashChecks.size() >= HASH_BATCH) flushHashes();
+                return false;
+            }
+            pending = std::move(check);
+            return true;
+        };
+        auto onHashed = [&](const Sha256Digest& digest) {
+            pending.expected = digest;
+            hashChecks.push_back(std::move(pending));
+            if (hashChecks.size() >= HASH_BATCH) flushHashes();
+        };
+
+        std::unique_ptr<Encryptor> encryptor = makeEncryptor();
+        if (isChunkedArchive(backupFile)) {
+            // 文件清单与 tar 条目顺序相同，随 tar 流逐项读取
+            ArchiveReader manifestFile(backupFile, encryptor.get(), MappedFile::Access::RANDOM);
+            ManifestReader manifest(manifestFile);
+            ManifestEntry item;
+            bool haveItem = true;
+
+            Sha256 hasher;
+            bool hashing = false;
+            TarWalker::Callbacks callbacks;
+            callbacks.onEntry = [&](const TarEntry& entry, uint64_t) {
+                haveItem = haveItem && manifest.next(item);
+                hashing = onEntry(entry, haveItem ? &item : nullptr);
+                if (hashing) hasher.reset();
+            };
+            callbacks.onData = [&](const uint8_t* data, size_t len) {
+                if (hashing) hasher.update(data, len);
+            };
+            callbacks.onEntryEnd = [&] {
+                if (!hashing) return;
+                onHashed(hasher.finish());
+                hashing = false;
+            };
+            TarWalker walker(std::move(callbacks));
+
+            RestorePipeline pipeline(encryptor.get());
+            pipeline.run(backupFile, [&](const ArchiveSource& source) {
+                std::vector<char> buffer(64 * 1024);
+                size_t n;
+                while ((n = source(buffer.data(), buffer.size())) > 0) {
+                    walker.feed(reinterpret_cast<const uint8_t*>(buffer.data()), n);
+                }
+                walker.finish();
+            });
+        } else {
+            // 旧格式整体解码到内存，条目顺序与遍历顺序无关：先收集头部位置，按先序排序后逐个比对
+            std::vector<uint8_t> tarData = decodeLegacy(backupFile);
+            std::vector<std::pair<std::string, uint64_t>> headers;
+            TarWalker::Callbacks callbacks;
+            callbacks.onEntry = [&](const TarEntry& entry, uint64_t headerOffset) {
+                headers.emplace_back(entry.path, headerOffset);
+            };
+            TarWalker walker(std::move(callbacks));
+            walker.feed(tarData.data(), tarData.size());
+            walker.finish();
+            std::sort(headers.begin(), headers.end(), [](const auto& a, const auto& b) {
+                return comparePreorder(a.first, b.first) < 0;
+            });
+
+            for (const auto& header : headers) {
+                const uint8_t* block = tarData.data() + header.second;
+                TarEntry entry = TarWalker::decodeHeader(block, header.second);
+                if (onEntry(entry, nullptr)) {
+                    Sha256 hasher;
+                    hasher.update(block + BLOCK_SIZE, static_cast<size_t>(entry.size));
+                    onHashed(hasher.finish());
+                }
+            }
+        }
+
+        // 3. 备份中没有出现的源文件
+        for (; haveSource; haveSource = sourceQueue.pop(source)) {
+            report.entries.push_back({source.relativePath, DiffKind::ADDED, ""});
+        }
+        flushHashes();
+    } catch (...) {
+        sourceQueue.abort();
+        sourceThread.join();
+        throw;
+    }
+    sourceThread.join();
+    // 遍历失败时源条目不完整，比对结果无效
+    if (sourceError) std::rethrow_exception(sourceError);
+
+    std::sort(report.entries.begin(), report.entries.end(),
+              [](const DiffEntry& a, const DiffEntry& b) { return a.path < b.path; });
+
+    size_t added = 0, removed = 0, changed = 0;
+    for (const auto& e : report.entries) {
+        if (e.kind == DiffKind::ADDED) ++added;
+        else if (e.kind == DiffKind::REMOVED) ++removed;
+        else ++changed;
+    }
+    std::cout << "[Diff] " << added << " added, " << removed << " removed, " << changed << " changed ("
+              << report.hashed << " files hashed)." << std::endl;
+    return report;
 }
 
 // --- 辅助函数 ---
 
-std::vector<uint8_t> BackupSystem::readFile(const std::string& path) {
-    std::ifstream file(path, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        throw std::runtime_error("Cannot open file: " + path);
+std::string BackupSystem::sourceRootName(const std::string& srcDir) {
+    std::filesystem::path sourcePath(srcDir);
+    // 处理尾部斜杠: "data/" -> "data"
+    if (sourcePath.has_relative_path() && sourcePath.filename().empty()) {
+        sourcePath = sourcePath.parent_path();
     }
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    std::string rootName = sourcePath.filename().string();
+    if (rootName.empty()) rootName = "backup_root";
+    return rootName;
+}
 
-    std::vector<uint8_t> buffer(size);
-    if (!file.read(reinterpret_cast<char*>(buffer.data()), size)) {
-        throw std::runtime_error("Read error: " + path);
+std::unique_ptr<Encryptor> BackupSystem::makeEncryptor() {
+    if (!m_isEncrypted) return nullptr;
+    auto encryptor = std::make_unique<Encryptor>();
+    encryptor->init(m_password);
+    return encryptor;
+}
+
+std::vector<uint8_t> BackupSystem::decodeLegacy(const std::string& path) {
+    // 以内存映射方式读取，解密/解压直接从映射区读取，不再整文件拷贝到堆上
+    MappedFile file(path, MappedFile::Access::SEQUENTIAL);
+    if (file.size() == 0) {
+        throw std::runtime_error("备份文件为空或无法读取。");
+    }
+    const uint8_t* data = file.data();
+    size_t size = file.size();
+
+    // 解密 (Decrypt) - 如果设置了密码
+    std::vector<uint8_t> decrypted;
+    if (m_isEncrypted) {
+        std::cout << "[Restore] Decrypting..." << std::endl;
+        Encryptor encryptor;
+        encryptor.init(m_password);
+        try {
+            decrypted = encryptor.decrypt(data, size);
+        } catch (const std::exception& e) {
+            throw std::runtime_error("解密失败。密码错误？");
+        }
+        data = decrypted.data();
+        size = decrypted.size();
+    }
+
+    // 解压 (Decompress)
+    std::cout << "[Restore] Decompressing..." << std::endl;
+    Compressor compressor;
+    try {
+        return compressor.decompress(data, size);
+    } catch (const std::exception& e) {
+        throw std::runtime_error("解压失败。数据损坏？");
     }
-    return buffer;
 }
 
-bool BackupSystem::writeFile(const std::string& path, const std::vector<uint8_t>& data) {
-    std::ofstream file(path, std::ios::binary);
-    if (!file.is_open()) return false;
-    file.write(reinterpret_cast<const char*>(data.data()), data.size());
-    return true;
+std::string BackupSystem::readRootName(const uint8_t* tarData, size_t size) {
+    if (size <= 100) return "";
+    // TAR 头部前100字节是文件名
+    char nameBuf[101] = {0};
+    std::memcpy(nameBuf, tarData, 100);
+    std::string firstPath(nameBuf);
+
+    size_t slashPos = firstPath.find('/');
+    if (slashPos != std::string::npos && slashPos > 0) {
+        return firstPath.substr(0, slashPos);
+    }
+    return firstPath; // 只有文件名，没有目录的情况
 }
 
 } // namespace Backup
\ No newline at end of file
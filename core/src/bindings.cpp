@@ -20,21 +20,120 @@ PYBIND11_MODULE(backup_core_py, m) {
         .def_readwrite("startTime", &Backup::Filter::startTime)
         .def_readwrite("endTime", &Backup::Filter::endTime)
         .def_readwrite("userName", &Backup::Filter::userName)
+        .def_readwrite("excludePatterns", &Backup::Filter::excludePatterns)
         .def_readwrite("enabled", &Backup::Filter::enabled);
 
+    // Verify
+    py::enum_<Backup::VerifyMode>(m, "VerifyMode")
+        .value("FULL", Backup::VerifyMode::FULL)
+        .value("DEEP", Backup::VerifyMode::DEEP)
+        .value("SAMPLE", Backup::VerifyMode::SAMPLE);
+
+    py::class_<Backup::VerifyReport>(m, "VerifyReport")
+        .def_readonly("chunksTotal", &Backup::VerifyReport::chunksTotal)
+        .def_readonly("chunksChecked", &Backup::VerifyReport::chunksChecked)
+        .def_readonly("entries", &Backup::VerifyReport::entries)
+        .def_readonly("bytes", &Backup::VerifyReport::bytes)
+        .def_readonly("filesHashed", &Backup::VerifyReport::filesHashed)
+        .def_readonly("coverage", &Backup::VerifyReport::coverage);
+
+    // Diff
+    py::enum_<Backup::DiffKind>(m, "DiffKind")
+        .value("ADDED", Backup::DiffKind::ADDED)
+        .value("REMOVED", Backup::DiffKind::REMOVED)
+        .value("CHANGED", Backup::DiffKind::CHANGED);
+
+    py::class_<Backup::DiffEntry>(m, "DiffEntry")
+        .def_readonly("path", &Backup::DiffEntry::path)
+        .def_readonly("kind", &Backup::DiffEntry::kind)
+        .def_readonly("detail", &Backup::DiffEntry::detail);
+
+    py::class_<Backup::DiffReport>(m, "DiffReport")
+        .def_readonly("entries", &Backup::DiffReport::entries)
+        .def_readonly("compared", &Backup::DiffReport::compared)
+        .def_readonly("hashed", &Backup::DiffReport::hashed)
+        .def("identical", &Backup::DiffReport::identical);
+
+    // Read scheduling
+    py::enum_<Backup::ReadOrder>(m, "ReadOrder")
+        .value("TRAVERSAL", Backup::ReadOrder::TRAVERSAL)
+        .value("INODE", Backup::ReadOrder::INODE)
+        .value("PHYSICAL", Backup::ReadOrder::PHYSICAL);
+
+    // Resource policy
+    py::class_<Backup::ResourcePolicy>(m, "ResourcePolicy")
+        .def(py::init<>())
+        .def_readwrite("maxThreads", &Backup::ResourcePolicy::maxThreads)
+        .def_readwrite("ioBytesPerSec", &Backup::ResourcePolicy::ioBytesPerSec)
+        .def_readwrite("ioIdle", &Backup::ResourcePolicy::ioIdle)
+        .def_readwrite("niceLevel", &Backup::ResourcePolicy::niceLevel)
+        .def_readwrite("maxLoadPerCpu", &Backup::ResourcePolicy::maxLoadPerCpu)
+        .def_readwrite("maxPressure", &Backup::ResourcePolicy::maxPressure)
+        .def_readwrite("maxPauseSeconds", &Backup::ResourcePolicy::maxPauseSeconds);
+
     // BackupSystem
     py::class_<Backup::BackupSystem>(m, "BackupSystem")
         .def(py::init<>())
         .def("setCompressionAlgorithm", &Backup::BackupSystem::setCompressionAlgorithm)
         .def("setPassword", &Backup::BackupSystem::setPassword)
         .def("setFilter", &Backup::BackupSystem::setFilter)
+        .def("setReadOrder", &Backup::BackupSystem::setReadOrder)
+        .def("setOneFileSystem", &Backup::BackupSystem::setOneFileSystem)
+        .def("setExcludedFileSystems", &Backup::BackupSystem::setExcludedFileSystems)
+        .def("setResourcePolicy", &Backup::BackupSystem::setResourcePolicy)
         .def("backup", &Backup::BackupSystem::backup, py::call_guard<py::gil_scoped_release>())
         .def("restore", &Backup::BackupSystem::restore, py::call_guard<py::gil_scoped_release>())
-        .def("verify", &Backup::BackupSystem::verify, py::call_guard<py::gil_scoped_release>());
+        .def("verify", py::overload_cast<const std::string&>(&Backup::BackupSystem::verify), py::call_guard<py::gil_scoped_release>())
+        .def("verifyWithMode", py::overload_cast<const std::string&, Backup::VerifyMode, double>(&Backup::BackupSystem::verify),
+             py::arg("backupFile"), py::arg("mode"), py::arg("fraction") = 1.0, py::call_guard<py::gil_scoped_release>())
+        .def("diff", &Backup::BackupSystem::diff, py::arg("backupFile"), py::arg("srcDir"), py::arg("deep") = false,
+             py::call_guard<py::gil_scoped_release>())
+        .def("backupDelta", &Backup::BackupSystem::backupDelta, py::call_guard<py::gil_scoped_release>())
+        .def("isDeltaArchive", &Backup::BackupSystem::isDeltaArchive, py::call_guard<py::gil_scoped_release>())
+        .def("restoreChain", &Backup::BackupSystem::restoreChain, py::call_guard<py::gil_scoped_release>());
 
     // BackupScheduler
-    py::class_<Backup::BackupScheduler>(m, "BackupScheduler")
+    py::class_<Backup::DebounceOptions>(m, "DebounceOptions")
         .def(py::init<>())
+        .def_readwrite("quietMs", &Backup::DebounceOptions::quietMs)
+        .def_readwrite("maxDelayMs", &Backup::DebounceOptions::maxDelayMs)
+        .def_readwrite("minIntervalMs", &Backup::DebounceOptions::minIntervalMs);
+
+    py::class_<Backup::DeltaOptions>(m, "DeltaOptions")
+        .def(py::init<>())
+        .def_readwrite("enabled", &Backup::DeltaOptions::enabled)
+        .def_readwrite("fullEvery", &Backup::DeltaOptions::fullEvery);
+
+    py::enum_<Backup::OverlapPolicy>(m, "OverlapPolicy")
+        .value("COALESCE", Backup::OverlapPolicy::COALESCE)
+        .value("SKIP_IF_LATE", Backup::OverlapPolicy::SKIP_IF_LATE)
+        .value("QUEUE", Backup::OverlapPolicy::QUEUE);
+
+    py::class_<Backup::OverlapOptions>(m, "OverlapOptions")
+        .def(py::init<>())
+        .def_readwrite("policy", &Backup::OverlapOptions::policy)
+        .def_readwrite("maxLagSeconds", &Backup::OverlapOptions::maxLagSeconds);
+
+    py::class_<Backup::ScheduleStats>(m, "ScheduleStats")
+        .def_readonly("runs", &Backup::ScheduleStats::runs)
+        .def_readonly("skippedRuns", &Backup::ScheduleStats::skippedRuns)
+        .def_readonly("lastLagMs", &Backup::ScheduleStats::lastLagMs)
+        .def_readonly("maxLagMs", &Backup::ScheduleStats::maxLagMs);
+
+    py::class_<Backup::TaskState>(m, "TaskState")
+        .def_readonly("id", &Backup::TaskState::id)
+        .def_property_readonly("realtime", [](const Backup::TaskState& t) { return t.type == Backup::TaskType::REALTIME; })
+        .def_readonly("srcDir", &Backup::TaskState::srcDir)
+        .def_readonly("dstDir", &Backup::TaskState::dstDir)
+        .def_readonly("filePrefix", &Backup::TaskState::filePrefix)
+        .def_readonly("intervalSeconds", &Backup::TaskState::intervalSeconds)
+        .def_readonly("maxBackups", &Backup::TaskState::maxBackups)
+        .def_readonly("encrypted", &Backup::TaskState::encrypted)
+        .def_readonly("lastRunTime", &Backup::TaskState::lastRunTime)
+        .def_readonly("lastArchive", &Backup::TaskState::lastArchive);
+
+    py::class_<Backup::BackupScheduler>(m, "BackupScheduler")
+        .def(py::init<unsigned int>(), py::arg("maxConcurrent") = 2)
         .def("start", &Backup::BackupScheduler::start, py::call_guard<py::gil_scoped_release>())
         .def("stop", &Backup::BackupScheduler::stop, py::call_guard<py::gil_scoped_release>())
         .def("addScheduledTask", &Backup::BackupScheduler::addScheduledTask, 
@@ -43,5 +142,17 @@ PYBIND11_MODULE(backup_core_py, m) {
              "Add realtime task", py::arg("src"), py::arg("dstDir"), py::arg("prefix"), py::arg("maxKeep"))
         .def("setTaskFilter", &Backup::BackupScheduler::setTaskFilter)
         .def("setTaskPassword", &Backup::BackupScheduler::setTaskPassword)
-        .def("setTaskCompressionAlgorithm", &Backup::BackupScheduler::setTaskCompressionAlgorithm);
+        .def("setTaskCompressionAlgorithm", &Backup::BackupScheduler::setTaskCompressionAlgorithm)
+        .def("setTaskDebounce", &Backup::BackupScheduler::setTaskDebounce)
+        .def("setTaskDelta", &Backup::BackupScheduler::setTaskDelta)
+        .def("setTaskResourcePolicy", &Backup::BackupScheduler::setTaskResourcePolicy)
+        .def("setTaskOverlap", &Backup::BackupScheduler::setTaskOverlap)
+        .def("scheduleStats", &Backup::BackupScheduler::scheduleStats)
+        .def("setMaxConcurrentTasks", &Backup::BackupScheduler::setMaxConcurrentTasks)
+        .def("loadState", &Backup::BackupScheduler::loadState, py::arg("stateFile"), py::call_guard<py::gil_scoped_release>())
+        .def("taskStates", &Backup::BackupScheduler::taskStates)
+        .def_static("backupChain", &Backup::BackupScheduler::backupChain,
+                    py::arg("dstDir"), py::arg("prefix"), py::arg("pointInTime") = 0)
+        .def("restoreTask", &Backup::BackupScheduler::restoreTask,
+             py::arg("taskId"), py::arg("pointInTime"), py::arg("restoreDir"), py::call_guard<py::gil_scoped_release>());
 }
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "change_watcher.h"
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+    #include <poll.h>
+    #include <sys/eventfd.h>
+    #include <sys/inotify.h>
+#endif
+
+namespace Backup {
+
+#ifdef __linux__
+static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                                   IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                                   IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+#endif
+
+static std::string joinRelative(const std::string& dir, const char* name) {
+    return dir.empty() ? std::string(name) : dir + "/" + name;
+}
+
+ChangeWatcher::ChangeWatcher(const std::string& rootDir, Callback onChange)
+    : m_root(rootDir), m_onChange(std::move(onChange)) {}
+
+ChangeWatcher::~ChangeWatcher() {
+    stop();
+}
+
+bool ChangeWatcher::supported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string ChangeWatcher::fullPath(const std::string& relativePath) const {
+    return relativePath.empty() ? m_root : m_root + "/" + relativePath;
+}
+
+bool ChangeWatcher::start() {
+#ifdef __linux__
+    if (m_fd >= 0) return m_active;
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_fd < 0 || m_wakeFd < 0) {
+        stop();
+        return false;
+    }
+    m_active = true;
+    if (!addWatchTree("", false)) {
+        stop();
+        return false;
+    }
+    m_thread = std::thread(&ChangeWatcher::run, this);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ChangeWatcher::stop() {
+#ifdef __linux__
+    if (m_thread.joinable()) {
+        uint64_t one = 1;
+        ssize_t written = write(m_wakeFd, &one, sizeof(one));
+        (void)written;
+        m_thread.join();
+    }
+    if (m_fd >= 0) close(m_fd);
+    if (m_wakeFd >= 0) close(m_wakeFd);
+    m_fd = -1;
+    m_wakeFd = -1;
+    m_watches.clear();
+    m_watchCount = 0;
+#endif
+    m_active = false;
+}
+
+bool ChangeWatcher::hasChanges() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_changes.empty();
+}
+
+ChangeSet ChangeWatcher::takeChanges() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ChangeSet changes = std::move(m_changes);
+    m_changes = ChangeSet();
+    return changes;
+}
+
+void ChangeWatcher::markChanged(const std::string& relativePath) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_changes.paths.insert(relativePath);
+}
+
+void ChangeWatcher::markRescan() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_changes.rescan = true;
+}
+
+bool ChangeWatcher::addWatchTree(const std::string& relativeDir, bool markFiles) {
+#ifdef __linux__
+    // 先建立监视再读取目录，读取期间新建的条目要么被读到，要么产生事件
+    std::string path = fullPath(relativeDir);
+    int wd = inotify_add_watch(m_fd, path.c_str(), WATCH_MASK);
+    if (wd < 0) {
+        if (errno == ENOSPC || errno == ENOMEM) {
+            std::cerr << "[Watcher] inotify watch limit reached, falling back to scanning: " << m_root << std::endl;
+            m_active = false;
+            return false;
+        }
+        return relativeDir.empty() ? false : true;  // 子目录已被删除或无权访问：忽略
+    }
+    m_watches[wd] = relativeDir;
+    m_watchCount = m_watches.size();
+
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return true;
+    std::vector<std::string> subdirs;
+    while (struct dirent* entry = readdir(dir)) {
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        bool isDirectory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            isDirectory = lstat((path + "/" + name).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        std::string child = joinRelative(relativeDir, name);
+        if (isDirectory) {
+            subdirs.push_back(std::move(child));
+        } else if (markFiles) {
+            markChanged(child);
+        }
+    }
+    closedir(dir);
+
+    for (const auto& subdir : subdirs) {
+        if (!addWatchTree(subdir, markFiles)) return false;
+    }
+    return true;
+#else
+    (void)relativeDir;
+    (void)markFiles;
+    return false;
+#endif
+}
+
+void ChangeWatcher::removeWatchTree(const std::string& relativeDir) {
+#ifdef __linux__
+    std::string prefix = relativeDir + "/";
+    for (auto it = m_watches.begin(); it != m_watches.end();) {
+        if (it->second == relativeDir || it->second.compare(0, prefix.size(), prefix) == 0) {
+            inotify_rm_watch(m_fd, it->first);
+            it = m_watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_watchCount = m_watches.size();
+#else
+    (void)relativeDir;
+#endif
+}
+
+void ChangeWatcher::run() {
+#ifdef __linux__
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    struct pollfd fds[2] = {{m_fd, POLLIN, 0}, {m_wakeFd, POLLIN, 0}};
+    while (true) {
+        int ready = poll(fds, 2, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break;  // stop()
+
+        bool any = false;
+        while (true) {
+            ssize_t len = read(m_fd, buffer, sizeof(buffer));
+            if (len <= 0) break;
+            handleEvents(buffer, static_cast<size_t>(len));
+            any = true;
+        }
+        if (any && m_onChange && hasChanges()) m_onChange();
+        if (!m_active) {
+            // 监视数量超限：通知调用者改用完整扫描
+            if (m_onChange) m_onChange();
+            break;
+        }
+    }
+#endif
+}
+
+void ChangeWatcher::handleEvents(const char* buffer, size_t len) {
+#ifdef __linux__
+    for (size_t pos = 0; pos < len;) {
+        const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + pos);
+        pos += sizeof(struct inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            markRescan();
+            continue;
+        }
+        auto it = m_watches.find(event->wd);
+        if (it == m_watches.end()) continue;
+        if (event->mask & IN_IGNORED) {
+            bool root = it->second.empty();
+            m_watches.erase(it);
+            m_watchCount = m_watches.size();
+            if (root) markRescan();     // 根目录被删除或移走
+            continue;
+        }
+        if (event->len == 0) continue;  // 目录自身的事件，由父目录的事件处理
+
+        std::string path = joinRelative(it->second, event->name);
+        bool isDirectory = (event->mask & IN_ISDIR) != 0;
+        if (isDirectory && (event->mask & IN_MOVED_FROM)) {
+            // 目录被移走：其中的文件不会逐个产生事件
+            removeWatchTree(path);
+            markRescan();
+        } else if (isDirectory && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+            if (!addWatchTree(path, true)) {
+                // 监视已失效，缓冲区中剩余的事件被丢弃：由完整扫描补上
+                markRescan();
+                return;
+            }
+        }
+        markChanged(path);
+    }
+#else
+    (void)buffer;
+    (void)len;
+#endif
+}
+
+} // namespace Backup
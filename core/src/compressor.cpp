@@ -114,12 +114,16 @@ std::vector<uint8_t> Compressor::compress(const std::vector<uint8_t>& input, Com
 }
 
 std::vector<uint8_t> Compressor::decompress(const std::vector<uint8_t>& input) {
-    if (input.empty()) return {};
+    return decompress(input.data(), input.size());
+}
+
+std::vector<uint8_t> Compressor::decompress(const uint8_t* input, size_t len) {
+    if (len == 0) return {};
     uint8_t marker = input[0];
     
     if (marker != 0xEE) {
         CompressionAlgorithm algo = static_cast<CompressionAlgorithm>(marker);
-        std::vector<uint8_t> data(input.begin() + 1, input.end());
+        std::vector<uint8_t> data(input + 1, input + len);
         if (algo == CompressionAlgorithm::HUFFMAN) return decompressHuffman(data);
         if (algo == CompressionAlgorithm::LZSS) return decompressLZSS(data);
         if (algo == CompressionAlgorithm::JOINED) return decompressJoined(data);
@@ -127,18 +131,21 @@ std::vector<uint8_t> Compressor::decompress(const std::vector<uint8_t>& input) {
     }
 
     // 线程池化解压逻辑
+    if (len < 6) throw std::runtime_error("Compressed data is too small to contain header");
     CompressionAlgorithm algo = static_cast<CompressionAlgorithm>(input[1]);
     uint32_t numChunks = 0;
     for(int i=0; i<4; ++i) numChunks |= (static_cast<uint32_t>(input[2+i]) << (i*8));
 
     // 先解析出所有块的元数据（起始位置和大小）
     struct ChunkMeta { size_t pos; uint32_t size; };
-    std::vector<ChunkMeta> meta(numChunks);
+    std::vector<ChunkMeta> meta;
     size_t currentPos = 6;
     for (uint32_t i = 0; i < numChunks; ++i) {
+        if (currentPos + 4 > len) throw std::runtime_error("Unexpected end of compressed data");
         uint32_t sz = 0;
         for(int j=0; j<4; ++j) sz |= (static_cast<uint32_t>(input[currentPos+j]) << (j*8));
-        meta[i] = { currentPos + 4, sz };
+        if (currentPos + 4 + sz > len) throw std::runtime_error("Unexpected end of compressed data");
+        meta.push_back({ currentPos + 4, sz });
         currentPos += 4 + sz;
     }
 
@@ -152,7 +159,7 @@ std::vector<uint8_t> Compressor::decompress(const std::vector<uint8_t>& input) {
         workers.emplace_back([&]() {
             size_t i;
             while ((i = nextChunk.fetch_add(1)) < numChunks) {
-                std::vector<uint8_t> chunkData(input.begin() + meta[i].pos, input.begin() + meta[i].pos + meta[i].size);
+                std::vector<uint8_t> chunkData(input + meta[i].pos, input + meta[i].pos + meta[i].size);
                 if (algo == CompressionAlgorithm::HUFFMAN) decompressedChunks[i] = decompressHuffman(chunkData);
                 else if (algo == CompressionAlgorithm::LZSS) decompressedChunks[i] = decompressLZSS(chunkData);
                 else decompressedChunks[i] = decompressJoined(chunkData);
@@ -98,10 +98,14 @@ std::vector<uint8_t> Encryptor::encrypt(const std::vector<uint8_t>& inData) {
 }
 
 std::vector<uint8_t> Encryptor::decrypt(const std::vector<uint8_t>& inData) {
+    return decrypt(inData.data(), inData.size());
+}
+
+std::vector<uint8_t> Encryptor::decrypt(const uint8_t* inData, size_t len) {
     if (!pImpl->initialized) {
         throw std::runtime_error("加密器未初始化。请先调用 init()。");
     }
-    if (inData.empty()) return {};
+    if (len == 0) return {};
 
     // 1. 初始化解密上下文
     if (1 != EVP_DecryptInit_ex(pImpl->ctx, EVP_aes_256_cbc(), NULL, pImpl->key, pImpl->iv)) {
@@ -110,19 +114,19 @@ std::vector<uint8_t> Encryptor::decrypt(const std::vector<uint8_t>& inData) {
 
     // 2. 准备输出缓冲区
     // 明文通常与密文大小相同或更小（去除了填充），但分配足够的空间
-    std::vector<uint8_t> outData(inData.size() + EVP_MAX_BLOCK_LENGTH);
-    int len = 0;
+    std::vector<uint8_t> outData(len + EVP_MAX_BLOCK_LENGTH);
+    int outLen = 0;
     int plaintext_len = 0;
 
     // 3. 解密更新
-    if (1 != EVP_DecryptUpdate(pImpl->ctx, outData.data(), &len, inData.data(), inData.size())) {
+    if (1 != EVP_DecryptUpdate(pImpl->ctx, outData.data(), &outLen, inData, len)) {
         HANDLE_OPENSSL_ERROR("DecryptUpdate 失败");
     }
-    plaintext_len = len;
+    plaintext_len = outLen;
 
     // 4. 解密结束 (检查填充并完成)
     // 如果密码错误或数据损坏（填充错误），此步骤将失败
-    if (1 != EVP_DecryptFinal_ex(pImpl->ctx, outData.data() + len, &len)) {
+    if (1 != EVP_DecryptFinal_ex(pImpl->ctx, outData.data() + outLen, &outLen)) {
         // 可选：记录 OpenSSL 错误用于调试
         // unsigned long err = ERR_get_error();
         // char buf[256];
@@ -131,10 +135,92 @@ std::vector<uint8_t> Encryptor::decrypt(const std::vector<uint8_t>& inData) {
         
         throw std::runtime_error("解密失败 (请检查密码/数据完整性)");
     }
-    plaintext_len += len;
+    plaintext_len += outLen;
 
     outData.resize(plaintext_len);
     return outData;
 }
 
+// 分块加密实现
+
+// 块 IV = AES-256-ECB(key, baseIV XOR 块序号)，保证各块 IV 互不相同且不可预测
+static void deriveChunkIV(const unsigned char* key, const unsigned char* baseIV, uint64_t chunkIndex, unsigned char* outIV) {
+    unsigned char block[16];
+    std::memcpy(block, baseIV, 16);
+    for (int i = 0; i < 8; ++i) block[i] ^= static_cast<unsigned char>((chunkIndex >> (i * 8)) & 0xFF);
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) HANDLE_OPENSSL_ERROR("创建 EVP_CIPHER_CTX 失败");
+    int len = 0;
+    bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_ecb(), NULL, key, NULL) == 1 &&
+              EVP_CIPHER_CTX_set_padding(ctx, 0) == 1 &&
+              EVP_EncryptUpdate(ctx, outIV, &len, block, 16) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    if (!ok) HANDLE_OPENSSL_ERROR("块 IV 派生失败");
+}
+
+std::vector<uint8_t> Encryptor::encryptChunk(const uint8_t* data, size_t len, uint64_t chunkIndex) const {
+    if (!pImpl->initialized) {
+        throw std::runtime_error("加密器未初始化。请先调用 init()。");
+    }
+    if (len == 0) return {};
+
+    unsigned char iv[16];
+    deriveChunkIV(pImpl->key, pImpl->iv, chunkIndex, iv);
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) HANDLE_OPENSSL_ERROR("创建 EVP_CIPHER_CTX 失败");
+
+    std::vector<uint8_t> outData(len + EVP_MAX_BLOCK_LENGTH);
+    int outLen = 0, finalLen = 0;
+    bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, pImpl->key, iv) == 1 &&
+              EVP_EncryptUpdate(ctx, outData.data(), &outLen, data, static_cast<int>(len)) == 1 &&
+              EVP_EncryptFinal_ex(ctx, outData.data() + outLen, &finalLen) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    if (!ok) HANDLE_OPENSSL_ERROR("块加密失败");
+
+    outData.resize(outLen + finalLen);
+    return outData;
+}
+
+std::vector<uint8_t> Encryptor::decryptChunk(const uint8_t* data, size_t len, uint64_t chunkIndex) const {
+    if (!pImpl->initialized) {
+        throw std::runtime_error("加密器未初始化。请先调用 init()。");
+    }
+    if (len == 0) return {};
+
+    unsigned char iv[16];
+    deriveChunkIV(pImpl->key, pImpl->iv, chunkIndex, iv);
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) HANDLE_OPENSSL_ERROR("创建 EVP_CIPHER_CTX 失败");
+
+    std::vector<uint8_t> outData(len + EVP_MAX_BLOCK_LENGTH);
+    int outLen = 0, finalLen = 0;
+    bool ok = EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL, pImpl->key, iv) == 1 &&
+              EVP_DecryptUpdate(ctx, outData.data(), &outLen, data, static_cast<int>(len)) == 1 &&
+              EVP_DecryptFinal_ex(ctx, outData.data() + outLen, &finalLen) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    if (!ok) throw std::runtime_error("解密失败 (请检查密码/数据完整性)");
+
+    outData.resize(outLen + finalLen);
+    return outData;
+}
+
+void Encryptor::keyCheck(uint8_t* out) const {
+    if (!pImpl->initialized) {
+        throw std::runtime_error("加密器未初始化。请先调用 init()。");
+    }
+    // SHA-256("BackupKeyCheck" || key) 的前 8 字节
+    const char* label = "BackupKeyCheck";
+    std::vector<unsigned char> buf(label, label + strlen(label));
+    buf.insert(buf.end(), pImpl->key, pImpl->key + sizeof(pImpl->key));
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLen = 0;
+    if (!EVP_Digest(buf.data(), buf.size(), digest, &digestLen, EVP_sha256(), NULL)) {
+        HANDLE_OPENSSL_ERROR("密钥校验值计算失败");
+    }
+    std::memcpy(out, digest, 8);
+}
+
 } // namespace Backup
\ No newline at end of file
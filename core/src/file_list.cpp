@@ -0,0 +1,189 @@
+#include "file_list.h"
+#include <stdexcept>
+
+namespace Backup {
+
+// 与 traverser.cpp 中的实现相同
+std::string joinPaths(const std::string & base, const std::string & addition);
+
+uint32_t StringPool::intern(const std::string& value) {
+    auto it = m_ids.find(value);
+    if (it != m_ids.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(m_values.size());
+    m_values.push_back(value);
+    m_ids.emplace(value, id);
+    return id;
+}
+
+size_t StringPool::memoryUsage() const {
+    size_t bytes = m_values.capacity() * sizeof(std::string);
+    for (const auto& v : m_values) bytes += 2 * (v.capacity() + sizeof(std::string)) + sizeof(uint32_t);
+    return bytes;
+}
+
+uint32_t FileList::append(const FileInfo& info, uint32_t parent) {
+    size_t slash = info.relativePath.find_last_of('/');
+    size_t start = (slash == std::string::npos) ? 0 : slash + 1;
+    return appendEntry(info, parent, info.relativePath.c_str() + start, info.relativePath.size() - start);
+}
+
+uint32_t FileList::appendEntry(const FileInfo& info, uint32_t parent, const char* name, size_t nameLength) {
+    if (m_parent.size() >= NO_PARENT) {
+        throw std::runtime_error("文件列表条目过多。");
+    }
+    if (parent != NO_PARENT && parent >= m_parent.size()) {
+        throw std::runtime_error("文件列表父目录下标无效。");
+    }
+    if (nameLength > UINT16_MAX) {
+        throw std::runtime_error("文件名过长: " + info.relativePath);
+    }
+
+    uint32_t index = static_cast<uint32_t>(m_parent.size());
+    m_parent.push_back(parent);
+    m_nameOffset.push_back(m_names.size());
+    m_nameLength.push_back(static_cast<uint16_t>(nameLength));
+    m_names.insert(m_names.end(), name, name + nameLength);
+    m_type.push_back(static_cast<uint8_t>(info.type));
+    m_size.push_back(info.size);
+    m_permissions.push_back(static_cast<uint32_t>(info.permissions));
+    m_mtime.push_back(static_cast<int64_t>(info.lastModified));
+    m_inode.push_back(info.inode);
+    m_mtimeNs.push_back(info.mtimeNs);
+    m_ctimeNs.push_back(info.ctimeNs);
+    m_uid.push_back(static_cast<uint32_t>(info.UID));
+    m_gid.push_back(static_cast<uint32_t>(info.GID));
+    m_user.push_back(m_strings.intern(info.userName));
+    m_group.push_back(m_strings.intern(info.groupName));
+    if (!info.linkTarget.empty()) m_links.emplace(index, info.linkTarget);
+    if (info.deviceMajor != 0 || info.deviceMinor != 0) {
+        m_devices.emplace(index, std::make_pair(info.deviceMajor, info.deviceMinor));
+    }
+    return index;
+}
+
+void FileList::reserve(size_t entries, size_t nameBytes) {
+    m_names.reserve(nameBytes);
+    m_parent.reserve(entries);
+    m_nameOffset.reserve(entries);
+    m_nameLength.reserve(entries);
+    m_type.reserve(entries);
+    m_size.reserve(entries);
+    m_permissions.reserve(entries);
+    m_mtime.reserve(entries);
+    m_inode.reserve(entries);
+    m_mtimeNs.reserve(entries);
+    m_ctimeNs.reserve(entries);
+    m_uid.reserve(entries);
+    m_gid.reserve(entries);
+    m_user.reserve(entries);
+    m_group.reserve(entries);
+}
+
+std::string FileList::linkTarget(size_t i) const {
+    auto it = m_links.find(static_cast<uint32_t>(i));
+    return it == m_links.end() ? std::string() : it->second;
+}
+
+std::string FileList::buildPath(size_t i, const std::string& prefix) const {
+    // 先计算总长度，再从后向前填充，只分配一次
+    size_t length = 0;
+    size_t depth = 0;
+    for (uint32_t k = static_cast<uint32_t>(i); k != NO_PARENT; k = m_parent[k]) {
+        length += m_nameLength[k] + (depth++ ? 1 : 0);
+    }
+    if (length == 0) return std::string();  // 单个文件作为根时相对路径为空，不加前缀
+    if (!prefix.empty()) length += prefix.size() + 1;
+
+    std::string path(length, '/');
+    size_t end = length;
+    for (uint32_t k = static_cast<uint32_t>(i); k != NO_PARENT; k = m_parent[k]) {
+        end -= m_nameLength[k];
+        path.replace(end, m_nameLength[k], m_names.data() + m_nameOffset[k], m_nameLength[k]);
+        if (end > 0) --end;  // 分隔符 '/'
+    }
+    if (!prefix.empty()) path.replace(0, prefix.size(), prefix);
+    return path;
+}
+
+std::string FileList::relativePath(size_t i) const {
+    return buildPath(i, m_prefix);
+}
+
+std::string FileList::absolutePath(size_t i) const {
+    // 绝对路径不带前缀：root + 原始相对路径
+    return joinPaths(m_root, buildPath(i, std::string()));
+}
+
+FileInfo FileList::at(size_t i) const {
+    FileInfo info;
+    info.relativePath = relativePath(i);
+    info.absolutePath = absolutePath(i);
+    info.type = type(i);
+    info.size = m_size[i];
+    info.permissions = static_cast<mode_t>(m_permissions[i]);
+    info.lastModified = static_cast<time_t>(m_mtime[i]);
+    info.inode = m_inode[i];
+    info.mtimeNs = m_mtimeNs[i];
+    info.ctimeNs = m_ctimeNs[i];
+    info.UID = static_cast<uid_t>(m_uid[i]);
+    info.GID = static_cast<gid_t>(m_gid[i]);
+    info.userName = userName(i);
+    info.groupName = groupName(i);
+    info.linkTarget = linkTarget(i);
+    auto dev = m_devices.find(static_cast<uint32_t>(i));
+    info.deviceMajor = dev == m_devices.end() ? 0 : dev->second.first;
+    info.deviceMinor = dev == m_devices.end() ? 0 : dev->second.second;
+    return info;
+}
+
+FileList FileList::filter(const std::function<bool(const FileInfo&)>& keep) const {
+    FileList result;
+    result.m_root = m_root;
+    result.m_prefix = m_prefix;
+    // 与逐个过滤 FileInfo 的结果一致：目录被剔除时其子条目仍单独判定，
+    // 保留的子条目挂到最近的保留祖先下，名称记录从该祖先开始的多段路径
+    std::vector<uint32_t> kept(size(), NO_PARENT);      // 原下标 -> 最近的保留祖先（含自身）的原下标
+    std::vector<uint32_t> remap(size(), NO_PARENT);     // 原下标 -> 新下标（仅保留的条目）
+    for (size_t i = 0; i < size(); ++i) {
+        uint32_t parent = m_parent[i];
+        uint32_t ancestor = (parent == NO_PARENT) ? NO_PARENT : kept[parent];
+        FileInfo info = at(i);
+        if (!keep(info)) {
+            kept[i] = ancestor;
+            continue;
+        }
+        kept[i] = static_cast<uint32_t>(i);
+        uint32_t newParent = (ancestor == NO_PARENT) ? NO_PARENT : remap[ancestor];
+        if (ancestor == parent) {
+            remap[i] = result.appendEntry(info, newParent, m_names.data() + m_nameOffset[i], m_nameLength[i]);
+        } else {
+            std::string path = buildPath(i, std::string());
+            size_t skip = (ancestor == NO_PARENT) ? 0 : buildPath(ancestor, std::string()).size() + 1;
+            remap[i] = result.appendEntry(info, newParent, path.c_str() + skip, path.size() - skip);
+        }
+    }
+    return result;
+}
+
+std::vector<FileInfo> FileList::toVector() const {
+    std::vector<FileInfo> files;
+    files.reserve(size());
+    for (size_t i = 0; i < size(); ++i) files.push_back(at(i));
+    return files;
+}
+
+size_t FileList::memoryUsage() const {
+    size_t bytes = m_names.capacity();
+    bytes += m_parent.capacity() * sizeof(uint32_t) + m_nameOffset.capacity() * sizeof(uint64_t);
+    bytes += m_nameLength.capacity() * sizeof(uint16_t) + m_type.capacity();
+    bytes += m_size.capacity() * sizeof(uint64_t) + m_permissions.capacity() * sizeof(uint32_t);
+    bytes += (m_mtime.capacity() + m_mtimeNs.capacity() + m_ctimeNs.capacity()) * sizeof(int64_t);
+    bytes += m_inode.capacity() * sizeof(uint64_t);
+    bytes += (m_uid.capacity() + m_gid.capacity() + m_user.capacity() + m_group.capacity()) * sizeof(uint32_t);
+    bytes += m_strings.memoryUsage();
+    for (const auto& link : m_links) bytes += sizeof(link) + link.second.capacity() + 16;
+    bytes += m_devices.size() * (sizeof(uint32_t) + sizeof(std::pair<unsigned int, unsigned int>) + 16);
+    return bytes;
+}
+
+} // namespace Backup
@@ -0,0 +1,300 @@
+#include "filter.h"
+#include "name_cache.h"
+#include <queue>
+#include <stdexcept>
+
+namespace Backup {
+
+// ---------------------------------------------------------
+// Aho-Corasick 自动机
+// ---------------------------------------------------------
+
+KeywordMatcher::KeywordMatcher(const std::vector<std::string>& keywords) {
+    std::array<int32_t, 256> empty;
+    empty.fill(-1);
+    m_next.push_back(empty);
+    m_output.push_back(false);
+
+    // 1. 构建 trie
+    for (const auto& keyword : keywords) {
+        if (keyword.empty()) continue;
+        int32_t state = 0;
+        for (unsigned char c : keyword) {
+            if (m_next[state][c] < 0) {
+                m_next[state][c] = static_cast<int32_t>(m_next.size());
+                m_next.push_back(empty);
+                m_output.push_back(false);
+            }
+            state = m_next[state][c];
+        }
+        m_output[state] = true;
+    }
+    if (m_next.size() == 1) {
+        // 没有有效关键词
+        m_next.clear();
+        m_output.clear();
+        return;
+    }
+
+    // 2. BFS 计算失败链接，并把缺失的转移直接指向失败状态的转移，得到 DFA
+    std::vector<int32_t> fail(m_next.size(), 0);
+    std::queue<int32_t> queue;
+    for (int c = 0; c < 256; ++c) {
+        int32_t child = m_next[0][c];
+        if (child < 0) {
+            m_next[0][c] = 0;
+        } else {
+            fail[child] = 0;
+            queue.push(child);
+        }
+    }
+    while (!queue.empty()) {
+        int32_t state = queue.front();
+        queue.pop();
+        m_output[state] = m_output[state] || m_output[fail[state]];
+        for (int c = 0; c < 256; ++c) {
+            int32_t child = m_next[state][c];
+            if (child < 0) {
+                m_next[state][c] = m_next[fail[state]][c];
+            } else {
+                fail[child] = m_next[fail[state]][c];
+                queue.push(child);
+            }
+        }
+    }
+}
+
+bool KeywordMatcher::search(const std::string& text) const {
+    if (m_next.empty()) return false;
+    int32_t state = 0;
+    for (unsigned char c : text) {
+        state = m_next[state][c];
+        if (m_output[state]) return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------
+// 通配匹配
+// ---------------------------------------------------------
+
+// 匹配 [...] 字符类，成功时 p 前进到 ']' 之后；没有闭合的 ']' 时返回 -1，按字面量处理
+static int matchClass(const char*& p, char c) {
+    const char* q = p + 1;
+    bool negate = (*q == '!' || *q == '^');
+    if (negate) ++q;
+    bool matched = false;
+    bool first = true;
+    while (*q && (first || *q != ']')) {
+        first = false;
+        char lo = *q;
+        if (lo == '\\' && q[1]) lo = *++q;
+        char hi = lo;
+        if (q[1] == '-' && q[2] && q[2] != ']') {
+            hi = q[2];
+            if (hi == '\\' && q[3]) { hi = q[3]; ++q; }
+            q += 2;
+        }
+        if (c >= lo && c <= hi) matched = true;
+        ++q;
+    }
+    if (*q != ']') return -1;
+    p = q + 1;
+    return (matched != negate) ? 1 : 0;
+}
+
+static bool globMatchImpl(const char* p, const char* s) {
+    while (*p) {
+        if (p[0] == '*' && p[1] == '*') {
+            p += 2;
+            if (*p == '/') {
+                // "**/" 匹配零个或多个目录
+                ++p;
+                if (globMatchImpl(p, s)) return true;
+                for (const char* t = s; *t; ++t) {
+                    if (*t == '/' && globMatchImpl(p, t + 1)) return true;
+                }
+                return false;
+            }
+            // 结尾的 "**" 匹配其余所有内容
+            for (const char* t = s;; ++t) {
+                if (globMatchImpl(p, t)) return true;
+                if (!*t) return false;
+            }
+        }
+        if (*p == '*') {
+            ++p;
+            for (const char* t = s;; ++t) {
+                if (globMatchImpl(p, t)) return true;
+                if (!*t || *t == '/') return false;
+            }
+        }
+        if (!*s) return false;
+        if (*p == '?') {
+            if (*s == '/') return false;
+            ++p;
+            ++s;
+            continue;
+        }
+        if (*p == '[' && *s != '/') {
+            const char* q = p;
+            int result = matchClass(q, *s);
+            if (result >= 0) {
+                if (result == 0) return false;
+                p = q;
+                ++s;
+                continue;
+            }
+        }
+        if (*p == '\\' && p[1]) ++p;
+        if (*p != *s) return false;
+        ++p;
+        ++s;
+    }
+    return *s == '\0';
+}
+
+bool globMatch(const std::string& pattern, const std::string& text) {
+    return globMatchImpl(pattern.c_str(), text.c_str());
+}
+
+// ---------------------------------------------------------
+// 编译后的过滤器
+// ---------------------------------------------------------
+
+static bool hasWildcard(const std::string& s) {
+    return s.find_first_of("*?[\\") != std::string::npos;
+}
+
+CompiledFilter::CompiledFilter(const Filter& filter) : m_enabled(filter.enabled), m_filter(filter) {
+    for (const auto& suffix : filter.suffixes) {
+        if (m_suffixesByLength.size() <= suffix.size()) m_suffixesByLength.resize(suffix.size() + 1);
+        m_suffixesByLength[suffix.size()].insert(suffix);
+    }
+
+    // 关键词优先于正则（与原有行为一致）
+    if (!filter.nameKeywords.empty()) {
+        m_keywords = KeywordMatcher(filter.nameKeywords);
+    } else if (!filter.nameRegex.empty()) {
+        try {
+            m_regex = std::regex(filter.nameRegex, std::regex::ECMAScript | std::regex::optimize);
+        } catch (const std::regex_error& e) {
+            throw std::runtime_error("无效的正则表达式: " + filter.nameRegex);
+        }
+        m_useRegex = true;
+    }
+
+    for (std::string pattern : filter.excludePatterns) {
+        // 去掉行尾空白；空行与 '#' 注释忽略
+        while (!pattern.empty() && (pattern.back() == ' ' || pattern.back() == '\t' || pattern.back() == '\r')) pattern.pop_back();
+        if (pattern.empty() || pattern[0] == '#') continue;
+
+        ExcludeRule rule;
+        if (pattern[0] == '!') {
+            rule.negate = true;
+            pattern.erase(0, 1);
+        } else if (pattern.compare(0, 2, "\\!") == 0 || pattern.compare(0, 2, "\\#") == 0) {
+            pattern.erase(0, 1);
+        }
+        if (!pattern.empty() && pattern.back() == '/') {
+            rule.dirOnly = true;
+            pattern.pop_back();
+        }
+        if (!pattern.empty() && pattern[0] == '/') {
+            rule.anchored = true;
+            pattern.erase(0, 1);
+        } else if (pattern.find('/') != std::string::npos) {
+            rule.anchored = true;
+        }
+        if (pattern.empty()) continue;
+
+        rule.pattern = pattern;
+        if (!rule.anchored && !hasWildcard(pattern)) {
+            rule.kind = ExcludeRule::Kind::NAME;
+        } else if (!rule.anchored && pattern[0] == '*' && pattern.size() > 1 && !hasWildcard(pattern.substr(1))) {
+            rule.kind = ExcludeRule::Kind::SUFFIX;
+            rule.pattern = pattern.substr(1);
+        }
+        m_hasNegation = m_hasNegation || rule.negate;
+        m_rules.push_back(rule);
+    }
+
+    for (const auto& rule : m_rules) {
+        if (rule.kind == ExcludeRule::Kind::NAME) {
+            (rule.dirOnly ? m_excludeDirNames : m_excludeNames).insert(rule.pattern);
+        } else if (rule.kind == ExcludeRule::Kind::SUFFIX && !rule.dirOnly) {
+            m_excludeNameSuffixes.push_back(rule.pattern);
+        }
+    }
+}
+
+bool CompiledFilter::ruleMatches(const ExcludeRule& rule, const std::string& path, const std::string& name, bool isDirectory) const {
+    if (rule.dirOnly && !isDirectory) return false;
+    switch (rule.kind) {
+    case ExcludeRule::Kind::NAME:
+        return name == rule.pattern;
+    case ExcludeRule::Kind::SUFFIX:
+        return name.size() >= rule.pattern.size() &&
+               name.compare(name.size() - rule.pattern.size(), rule.pattern.size(), rule.pattern) == 0;
+    default:
+        return globMatch(rule.pattern, rule.anchored ? path : name);
+    }
+}
+
+bool CompiledFilter::excluded(const std::string& relativePath, bool isDirectory) const {
+    if (m_rules.empty()) return false;
+    size_t slash = relativePath.find_last_of('/');
+    std::string name = (slash == std::string::npos) ? relativePath : relativePath.substr(slash + 1);
+
+    if (!m_hasNegation) {
+        // 没有取反规则时任意一条命中即排除：先查哈希集合，再查后缀，最后才是通配
+        if (m_excludeNames.count(name)) return true;
+        if (isDirectory && m_excludeDirNames.count(name)) return true;
+        for (const auto& suffix : m_excludeNameSuffixes) {
+            if (name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) return true;
+        }
+        for (const auto& rule : m_rules) {
+            if (rule.kind == ExcludeRule::Kind::NAME) continue;
+            if (rule.kind == ExcludeRule::Kind::SUFFIX && !rule.dirOnly) continue;
+            if (ruleMatches(rule, relativePath, name, isDirectory)) return true;
+        }
+        return false;
+    }
+
+    // 有取反规则时按 gitignore 语义：最后一条命中的规则决定结果
+    for (auto it = m_rules.rbegin(); it != m_rules.rend(); ++it) {
+        if (ruleMatches(*it, relativePath, name, isDirectory)) return !it->negate;
+    }
+    return false;
+}
+
+bool CompiledFilter::matches(const FileInfo& file) const {
+    if (file.type == FileType::DIRECTORY) return true;
+
+    if (m_filter.minSize > 0 && file.size < m_filter.minSize) return false;
+    if (m_filter.maxSize > 0 && file.size > m_filter.maxSize) return false;
+
+    if (m_filter.startTime > 0 && file.lastModified < m_filter.startTime) return false;
+    if (m_filter.endTime > 0 && file.lastModified > m_filter.endTime) return false;
+
+    if (!m_filter.userName.empty()) {
+        const std::string& owner = file.userName.empty() ? NameCache::instance().userName(file.UID) : file.userName;
+        if (owner != m_filter.userName) return false;
+    }
+
+    if (!m_suffixesByLength.empty()) {
+        const std::string& path = file.relativePath;
+        bool suffixMatch = false;
+        for (size_t len = 0; len < m_suffixesByLength.size() && len <= path.size() && !suffixMatch; ++len) {
+            const auto& set = m_suffixesByLength[len];
+            suffixMatch = !set.empty() && set.count(path.substr(path.size() - len));
+        }
+        if (!suffixMatch) return false;
+    }
+
+    if (!m_keywords.empty() && !m_keywords.search(file.relativePath)) return false;
+    if (m_useRegex && !std::regex_search(file.relativePath, m_regex)) return false;
+    return true;
+}
+
+} // namespace Backup
@@ -0,0 +1,66 @@
+#include "hasher.h"
+#include <openssl/evp.h>
+#include <fstream>
+#include <vector>
+#include <stdexcept>
+
+namespace Backup {
+
+struct Sha256::Impl {
+    EVP_MD_CTX* ctx;
+
+    Impl() {
+        ctx = EVP_MD_CTX_new();
+        if (!ctx) throw std::runtime_error("创建 EVP_MD_CTX 失败");
+    }
+
+    ~Impl() {
+        if (ctx) EVP_MD_CTX_free(ctx);
+    }
+};
+
+Sha256::Sha256() : pImpl(new Impl()) {
+    reset();
+}
+
+Sha256::~Sha256() {
+    delete pImpl;
+}
+
+void Sha256::reset() {
+    if (1 != EVP_DigestInit_ex(pImpl->ctx, EVP_sha256(), NULL)) {
+        throw std::runtime_error("DigestInit 失败");
+    }
+}
+
+void Sha256::update(const uint8_t* data, size_t len) {
+    if (len == 0) return;
+    if (1 != EVP_DigestUpdate(pImpl->ctx, data, len)) {
+        throw std::runtime_error("DigestUpdate 失败");
+    }
+}
+
+Sha256Digest Sha256::finish() {
+    Sha256Digest digest{};
+    unsigned int len = 0;
+    if (1 != EVP_DigestFinal_ex(pImpl->ctx, digest.data(), &len)) {
+        throw std::runtime_error("DigestFinal 失败");
+    }
+    return digest;
+}
+
+Sha256Digest Sha256::ofFile(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input.is_open()) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    Sha256 hasher;
+    std::vector<char> buffer(64 * 1024);
+    while (input) {
+        input.read(buffer.data(), buffer.size());
+        hasher.update(reinterpret_cast<const uint8_t*>(buffer.data()), static_cast<size_t>(input.gcount()));
+    }
+    return hasher.finish();
+}
+
+} // namespace Backup
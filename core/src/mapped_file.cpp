@@ -0,0 +1,50 @@
+#include "mapped_file.h"
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Backup {
+
+MappedFile::MappedFile(const std::string& path, Access access) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        throw std::runtime_error("Cannot stat file: " + path);
+    }
+
+    m_size = static_cast<size_t>(st.st_size);
+    if (m_size == 0) {
+        close(fd); // 空文件无法映射，保持 data() == nullptr
+        return;
+    }
+
+    void* addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // 映射建立后即可关闭描述符
+    if (addr == MAP_FAILED) {
+        m_size = 0;
+        throw std::runtime_error("Cannot map file: " + path);
+    }
+    m_data = static_cast<const uint8_t*>(addr);
+
+    if (access == Access::SEQUENTIAL) {
+        madvise(addr, m_size, MADV_SEQUENTIAL);
+        madvise(addr, m_size, MADV_WILLNEED);
+    } else {
+        madvise(addr, m_size, MADV_RANDOM);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (m_data) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+}
+
+} // namespace Backup
@@ -0,0 +1,322 @@
+#include "metadata_index.h"
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Backup {
+
+static const char INDEX_MAGIC[4] = {'F', 'B', 'K', 'I'};
+static const uint32_t INDEX_VERSION = 2;
+static const size_t INDEX_MIN_CAPACITY = 1024;      // 必须是 2 的幂
+
+static const uint64_t SLOT_EMPTY = 0;
+static const uint64_t SLOT_DELETED = 1;
+static const uint32_t SLOT_FLAG_HASH = 0x1;
+
+// 文件布局: [Header 64B][Slot 48B] x capacity [SHA-256 32B] x capacity，capacity 为 2 的幂
+// 内容哈希放在与槽位平行的独立区域：探测只访问紧凑的槽位数组，未记录哈希时对应页面
+// 既不会被换入内存，也不占用磁盘（ftruncate 产生的空洞）
+struct MetadataIndex::Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t count;         // 有效记录数
+    uint64_t deleted;       // 删除标记数
+    uint32_t generation;    // 当前扫描轮次
+    uint32_t slotSize;
+    uint8_t reserved[24];
+};
+
+struct MetadataIndex::Slot {
+    uint64_t hash;          // 路径哈希，SLOT_EMPTY / SLOT_DELETED 为保留值
+    uint64_t size;
+    int64_t mtimeNs;
+    int64_t ctimeNs;
+    uint64_t inode;
+    uint32_t generation;    // 最近一次被 update 的扫描轮次
+    uint32_t flags;
+};
+
+size_t MetadataIndex::fileSizeFor(size_t capacity) {
+    static_assert(sizeof(Header) == 64, "index header must be 64 bytes");
+    static_assert(sizeof(Slot) == 48, "index slot must be 48 bytes");
+    return sizeof(Header) + capacity * (sizeof(Slot) + sizeof(Sha256Digest));
+}
+
+MetadataIndex::MetadataIndex(const std::string& path) : MetadataIndex(path, INDEX_MIN_CAPACITY) {}
+
+MetadataIndex::MetadataIndex(const std::string& path, size_t capacity) : m_path(path) {
+    open(capacity);
+}
+
+MetadataIndex::~MetadataIndex() {
+    unmap();
+}
+
+MetadataRecord MetadataIndex::recordOf(const FileInfo& info) {
+    MetadataRecord record;
+    record.size = info.size;
+    record.mtimeNs = info.mtimeNs ? info.mtimeNs : static_cast<int64_t>(info.lastModified) * 1000000000LL;
+    record.ctimeNs = info.ctimeNs;
+    record.inode = info.inode;
+    return record;
+}
+
+MetadataRecord MetadataIndex::recordOf(const struct stat& fileStat) {
+    MetadataRecord record;
+    record.size = static_cast<uint64_t>(fileStat.st_size);
+#ifdef __APPLE__
+    record.mtimeNs = static_cast<int64_t>(fileStat.st_mtimespec.tv_sec) * 1000000000LL + fileStat.st_mtimespec.tv_nsec;
+    record.ctimeNs = static_cast<int64_t>(fileStat.st_ctimespec.tv_sec) * 1000000000LL + fileStat.st_ctimespec.tv_nsec;
+#else
+    record.mtimeNs = static_cast<int64_t>(fileStat.st_mtim.tv_sec) * 1000000000LL + fileStat.st_mtim.tv_nsec;
+    record.ctimeNs = static_cast<int64_t>(fileStat.st_ctim.tv_sec) * 1000000000LL + fileStat.st_ctim.tv_nsec;
+#endif
+    record.inode = static_cast<uint64_t>(fileStat.st_ino);
+    return record;
+}
+
+uint64_t MetadataIndex::hashPath(const std::string& relativePath) {
+    // FNV-1a，再经 splitmix64 混合使低位分布均匀
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : relativePath) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h <= SLOT_DELETED ? h + 2 : h;
+}
+
+void MetadataIndex::open(size_t capacity) {
+    int fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        throw std::runtime_error("无法打开元数据索引: " + m_path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        throw std::runtime_error("无法读取元数据索引: " + m_path);
+    }
+
+    bool created = (st.st_size == 0);
+    size_t fileSize = created ? fileSizeFor(capacity) : static_cast<size_t>(st.st_size);
+    if (created && ftruncate(fd, static_cast<off_t>(fileSize)) == -1) {
+        close(fd);
+        throw std::runtime_error("无法创建元数据索引: " + m_path);
+    }
+    if (fileSize < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error("元数据索引损坏 (长度错误): " + m_path);
+    }
+
+    void* addr = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("无法映射元数据索引: " + m_path);
+    }
+    m_data = static_cast<uint8_t*>(addr);
+    m_mapSize = fileSize;
+    m_header = reinterpret_cast<Header*>(m_data);
+
+    if (created) {
+        std::memcpy(m_header->magic, INDEX_MAGIC, 4);
+        m_header->version = INDEX_VERSION;
+        m_header->capacity = capacity;
+        m_header->count = 0;
+        m_header->deleted = 0;
+        m_header->generation = 0;
+        m_header->slotSize = sizeof(Slot);
+        return;
+    }
+
+    uint64_t cap = m_header->capacity;
+    bool valid = std::memcmp(m_header->magic, INDEX_MAGIC, 4) == 0 && m_header->version == INDEX_VERSION &&
+                 m_header->slotSize == sizeof(Slot) && cap >= 1 && (cap & (cap - 1)) == 0 &&
+                 cap <= (m_mapSize - sizeof(Header)) / (sizeof(Slot) + sizeof(Sha256Digest)) &&
+                 fileSizeFor(cap) == m_mapSize;
+    if (!valid) {
+        unmap();
+        throw std::runtime_error("元数据索引损坏或版本不兼容: " + m_path);
+    }
+    madvise(m_data, m_mapSize, MADV_RANDOM);
+}
+
+void MetadataIndex::unmap() {
+    if (m_data) munmap(m_data, m_mapSize);
+    m_data = nullptr;
+    m_mapSize = 0;
+    m_header = nullptr;
+}
+
+MetadataIndex::Slot* MetadataIndex::slots() const {
+    return reinterpret_cast<Slot*>(m_data + sizeof(Header));
+}
+
+uint8_t* MetadataIndex::digestOf(const Slot* slot) const {
+    size_t index = static_cast<size_t>(slot - slots());
+    return m_data + sizeof(Header) + m_header->capacity * sizeof(Slot) + index * sizeof(Sha256Digest);
+}
+
+size_t MetadataIndex::size() const {
+    return static_cast<size_t>(m_header->count);
+}
+
+MetadataIndex::Slot* MetadataIndex::lookup(uint64_t hash) const {
+    uint64_t mask = m_header->capacity - 1;
+    Slot* table = slots();
+    for (uint64_t i = hash & mask, probes = 0; probes <= mask; i = (i + 1) & mask, ++probes) {
+        if (table[i].hash == hash) return &table[i];
+        if (table[i].hash == SLOT_EMPTY) return nullptr;
+    }
+    return nullptr;
+}
+
+MetadataIndex::Slot* MetadataIndex::insertSlot(uint64_t hash) {
+    // 装载率（含删除标记）超过 70% 时重建；删除标记较多时原容量重建即可
+    if ((m_header->count + m_header->deleted + 1) * 10 > m_header->capacity * 7) {
+        size_t capacity = m_header->capacity;
+        if ((m_header->count + 1) * 10 > capacity * 4) capacity *= 2;
+        rebuild(capacity);
+    }
+
+    uint64_t mask = m_header->capacity - 1;
+    Slot* table = slots();
+    Slot* reuse = nullptr;
+    for (uint64_t i = hash & mask;; i = (i + 1) & mask) {
+        if (table[i].hash == SLOT_DELETED && !reuse) reuse = &table[i];
+        if (table[i].hash == SLOT_EMPTY) {
+            Slot* slot = reuse ? reuse : &table[i];
+            if (reuse) --m_header->deleted;
+            std::memset(slot, 0, sizeof(Slot));
+            slot->hash = hash;
+            ++m_header->count;
+            return slot;
+        }
+    }
+}
+
+void MetadataIndex::rebuild(size_t capacity) {
+    // 写入临时文件后原子替换，重建过程中崩溃不会损坏原索引
+    std::string tmpPath = m_path + ".tmp";
+    std::remove(tmpPath.c_str());
+    {
+        MetadataIndex fresh(tmpPath, capacity);
+        fresh.m_header->generation = m_header->generation;
+
+        uint64_t mask = capacity - 1;
+        Slot* dst = fresh.slots();
+        const Slot* src = slots();
+        for (uint64_t i = 0; i < m_header->capacity; ++i) {
+            if (src[i].hash <= SLOT_DELETED) continue;
+            uint64_t j = src[i].hash & mask;
+            while (dst[j].hash != SLOT_EMPTY) j = (j + 1) & mask;
+            dst[j] = src[i];
+            if (src[i].flags & SLOT_FLAG_HASH) {
+                std::memcpy(fresh.digestOf(&dst[j]), digestOf(&src[i]), sizeof(Sha256Digest));
+            }
+            ++fresh.m_header->count;
+        }
+        fresh.sync(true);
+    }
+    if (std::rename(tmpPath.c_str(), m_path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        throw std::runtime_error("无法替换元数据索引: " + m_path);
+    }
+    unmap();
+    open(capacity);
+}
+
+bool MetadataIndex::find(const std::string& relativePath, MetadataRecord& record) const {
+    const Slot* slot = lookup(hashPath(relativePath));
+    if (!slot) return false;
+    record.size = slot->size;
+    record.mtimeNs = slot->mtimeNs;
+    record.ctimeNs = slot->ctimeNs;
+    record.inode = slot->inode;
+    record.hasHash = (slot->flags & SLOT_FLAG_HASH) != 0;
+    if (record.hasHash) std::memcpy(record.sha256.data(), digestOf(slot), sizeof(Sha256Digest));
+    return true;
+}
+
+bool MetadataIndex::update(const std::string& relativePath, const MetadataRecord& record) {
+    uint64_t hash = hashPath(relativePath);
+    Slot* slot = lookup(hash);
+    bool changed = false;
+    if (!slot) {
+        slot = insertSlot(hash);
+        changed = true;
+    } else {
+        changed = slot->size != record.size || slot->mtimeNs != record.mtimeNs ||
+                  slot->ctimeNs != record.ctimeNs || slot->inode != record.inode;
+    }
+    slot->generation = m_header->generation;
+    if (!changed && !record.hasHash) return false;
+
+    slot->size = record.size;
+    slot->mtimeNs = record.mtimeNs;
+    slot->ctimeNs = record.ctimeNs;
+    slot->inode = record.inode;
+    if (record.hasHash) {
+        slot->flags |= SLOT_FLAG_HASH;
+        std::memcpy(digestOf(slot), record.sha256.data(), sizeof(Sha256Digest));
+    } else {
+        // 元数据变化后原有的内容哈希失效
+        slot->flags &= ~SLOT_FLAG_HASH;
+    }
+    return changed;
+}
+
+void MetadataIndex::setContentHash(const std::string& relativePath, const Sha256Digest& sha256) {
+    Slot* slot = lookup(hashPath(relativePath));
+    if (!slot) return;
+    slot->flags |= SLOT_FLAG_HASH;
+    std::memcpy(digestOf(slot), sha256.data(), sizeof(Sha256Digest));
+}
+
+bool MetadataIndex::remove(const std::string& relativePath) {
+    Slot* slot = lookup(hashPath(relativePath));
+    if (!slot) return false;
+    slot->hash = SLOT_DELETED;
+    --m_header->count;
+    ++m_header->deleted;
+    return true;
+}
+
+void MetadataIndex::beginScan() {
+    ++m_header->generation;
+}
+
+size_t MetadataIndex::endScan() {
+    size_t removed = 0;
+    Slot* table = slots();
+    for (uint64_t i = 0; i < m_header->capacity; ++i) {
+        if (table[i].hash <= SLOT_DELETED || table[i].generation == m_header->generation) continue;
+        table[i].hash = SLOT_DELETED;
+        ++removed;
+    }
+    m_header->count -= removed;
+    m_header->deleted += removed;
+    return removed;
+}
+
+void MetadataIndex::clear() {
+    // 只清空槽位：哈希区域仅在 SLOT_FLAG_HASH 置位时读取
+    std::memset(slots(), 0, m_header->capacity * sizeof(Slot));
+    m_header->count = 0;
+    m_header->deleted = 0;
+}
+
+void MetadataIndex::sync(bool wait) {
+    if (m_data) msync(m_data, m_mapSize, wait ? MS_SYNC : MS_ASYNC);
+}
+
+} // namespace Backup
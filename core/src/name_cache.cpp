@@ -0,0 +1,72 @@
+#include "name_cache.h"
+#include <pwd.h>
+#include <grp.h>
+#include <unistd.h>
+#include <cerrno>
+#include <mutex>
+#include <vector>
+
+namespace Backup {
+
+NameCache& NameCache::instance() {
+    static NameCache cache;
+    return cache;
+}
+
+// 查询 NSS，缓冲区不够时加倍重试
+static std::string lookupUser(uid_t uid) {
+    long hint = sysconf(_SC_GETPW_R_SIZE_MAX);
+    std::vector<char> buffer(hint > 0 ? static_cast<size_t>(hint) : 16384);
+    struct passwd pwd;
+    struct passwd* result = nullptr;
+    int rc;
+    while ((rc = getpwuid_r(uid, &pwd, buffer.data(), buffer.size(), &result)) == ERANGE) {
+        buffer.resize(buffer.size() * 2);
+    }
+    if (rc == 0 && result != nullptr) return result->pw_name;
+    return std::to_string(uid); // 如果无法获取用户名，使用UID
+}
+
+static std::string lookupGroup(gid_t gid) {
+    long hint = sysconf(_SC_GETGR_R_SIZE_MAX);
+    std::vector<char> buffer(hint > 0 ? static_cast<size_t>(hint) : 16384);
+    struct group grp;
+    struct group* result = nullptr;
+    int rc;
+    while ((rc = getgrgid_r(gid, &grp, buffer.data(), buffer.size(), &result)) == ERANGE) {
+        buffer.resize(buffer.size() * 2);
+    }
+    if (rc == 0 && result != nullptr) return result->gr_name;
+    return std::to_string(gid); // 如果无法获取组名，使用GID
+}
+
+std::string NameCache::userName(uid_t uid) {
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto it = m_users.find(uid);
+        if (it != m_users.end()) return it->second;
+    }
+    // 在锁外查询 NSS，避免慢查询阻塞其他线程；重复查询时以先写入的结果为准
+    std::string name = lookupUser(uid);
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    return m_users.emplace(uid, std::move(name)).first->second;
+}
+
+std::string NameCache::groupName(gid_t gid) {
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto it = m_groups.find(gid);
+        if (it != m_groups.end()) return it->second;
+    }
+    std::string name = lookupGroup(gid);
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    return m_groups.emplace(gid, std::move(name)).first->second;
+}
+
+void NameCache::clear() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_users.clear();
+    m_groups.clear();
+}
+
+} // namespace Backup
@@ -1,4 +1,5 @@
 #include "packer.h"
+#include "name_cache.h"
 #include <iostream>
 #include <cstdio>
 #include <cstring>
@@ -9,6 +10,18 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h> // for symlink, unlink
+#include <fcntl.h>
+#include <cerrno>
+
+// Linux 上 makedev 定义在 sys/sysmacros.h 中
+#ifdef __linux__
+    #include <sys/sysmacros.h>
+    #include <sys/ioctl.h>
+    #include <linux/fs.h>
+    #include <linux/fiemap.h>
+    // linux/fs.h 定义了 BLOCK_SIZE 宏 (1024)，会覆盖 tar 的块大小常量
+    #undef BLOCK_SIZE
+#endif
 
 namespace Backup {
 
@@ -44,30 +57,169 @@ bool Packer::pack(const std::vector<FileInfo>& files, const std::string& outputA
         return false;
     }
 
+    pack(files, [&archive](const char* data, size_t len) {
+        archive.write(data, len);
+    });
+
+    archive.close();
+    std::cout << "打包完成: " << outputArchivePath << std::endl;
+    return true;
+}
+
+void Packer::pack(const std::vector<FileInfo>& files, const ArchiveSink& sink) {
     for (const auto& file : files) {
-        TarHeader header;
-        std::memset(&header, 0, sizeof(TarHeader)); 
-        fillHeader(file, &header);
+        packEntry(file, sink);
+    }
+    packEnd(sink);
+}
+
+void Packer::setReadOrder(ReadOrder order, size_t batchFiles, size_t batchBytes) {
+    m_readOrder = order;
+    m_batchFiles = std::max<size_t>(batchFiles, 1);
+    m_batchBytes = batchBytes;
+}
+
+void Packer::packEntry(const FileInfo& file, const ArchiveSink& sink) {
+    if (m_readOrder != ReadOrder::TRAVERSAL && file.type == FileType::REGULAR && file.size <= m_batchBytes) {
+        if (m_batch.size() >= m_batchFiles || m_batchSize + file.size > m_batchBytes) flushBatch(sink);
+        m_batch.push_back(file);
+        m_batchSize += file.size;
+        return;
+    }
+    // 其他条目（以及大文件）之前的批次先输出，保持原顺序
+    flushBatch(sink);
+    writeEntry(file, sink);
+}
 
-        archive.write(reinterpret_cast<const char*>(&header), sizeof(TarHeader));
+void Packer::writeEntry(const FileInfo& file, const ArchiveSink& sink) {
+    TarHeader header;
+    std::memset(&header, 0, sizeof(TarHeader)); 
+    fillHeader(file, &header);
+
+    sink(reinterpret_cast<const char*>(&header), sizeof(TarHeader));
+
+    // 只有常规文件在Tar中有数据块。
+    // 符号链接将目标存储在header.linkname中，目录没有数据。
+    if (file.type == FileType::REGULAR) {
+        if (!writeFileContent(file, sink)) {
+            std::cerr << "warning: cannot write content for " << file.relativePath << std::endl;
+        }
+    }
+}
 
-        // 只有常规文件在Tar中有数据块。
-        // 符号链接将目标存储在header.linkname中，目录没有数据。
-        if (file.type == FileType::REGULAR) {
-            if (!writeFileContent(file, archive)) {
-                std::cerr << "warning: cannot write content for " << file.relativePath << std::endl;
+namespace {
+
+// 文件第一个数据区的物理偏移，FIEMAP 不可用（或文件没有数据区）时返回 false
+bool physicalOffset(int fd, uint64_t& offset) {
+#ifdef __linux__
+    // struct fiemap 以柔性数组结尾，为一个数据区预留空间
+    alignas(struct fiemap) char buffer[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    std::memset(buffer, 0, sizeof(buffer));
+    struct fiemap* map = reinterpret_cast<struct fiemap*>(buffer);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    if (ioctl(fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents > 0) {
+        offset = map->fm_extents[0].fe_physical;
+        return true;
+    }
+#else
+    (void)fd;
+    (void)offset;
+#endif
+    return false;
+}
+
+} // namespace
+
+void Packer::flushBatch(const ArchiveSink& sink) {
+    if (m_batch.empty()) return;
+
+    struct Item {
+        size_t index;
+        int fd;
+        bool physical;      // key 为物理偏移（否则为 inode 号）
+        uint64_t key;
+    };
+    std::vector<Item> items;
+    items.reserve(m_batch.size());
+    for (size_t i = 0; i < m_batch.size(); ++i) {
+        Item item{i, open(m_batch[i].absolutePath.c_str(), O_RDONLY | O_CLOEXEC), false, m_batch[i].inode};
+        if (item.fd >= 0) {
+            if (m_readOrder == ReadOrder::PHYSICAL) item.physical = physicalOffset(item.fd, item.key);
+            if (!item.physical && item.key == 0) {
+                struct stat fileStat;
+                if (fstat(item.fd, &fileStat) == 0) item.key = fileStat.st_ino;
             }
         }
+        items.push_back(item);
+    }
+    // 有物理偏移的文件按偏移排序，其余按 inode 号排在其后
+    std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        if (a.physical != b.physical) return a.physical;
+        return a.key < b.key;
+    });
+
+    // 按排序后的顺序读入内存；数据区大小必须与头部一致（截断补 0，变长截断）
+    std::vector<std::vector<char>> contents(m_batch.size());
+    std::vector<bool> ok(m_batch.size(), false);
+    for (const Item& item : items) {
+        std::vector<char>& data = contents[item.index];
+        data.assign(m_batch[item.index].size, 0);
+        if (item.fd < 0) continue;
+        size_t got = 0;
+        while (got < data.size()) {
+            ssize_t n = read(item.fd, data.data() + got, data.size() - got);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            got += static_cast<size_t>(n);
+        }
+        ok[item.index] = (got == data.size());
+        close(item.fd);
     }
 
+    // 按原顺序输出
+    char pad[BLOCK_SIZE] = {0};
+    for (size_t i = 0; i < m_batch.size(); ++i) {
+        const FileInfo& file = m_batch[i];
+        TarHeader header;
+        std::memset(&header, 0, sizeof(TarHeader));
+        fillHeader(file, &header);
+        sink(reinterpret_cast<const char*>(&header), sizeof(TarHeader));
+        if (!contents[i].empty()) sink(contents[i].data(), contents[i].size());
+        size_t padding = (BLOCK_SIZE - (file.size % BLOCK_SIZE)) % BLOCK_SIZE;
+        if (padding > 0) sink(pad, padding);
+        if (!ok[i]) {
+            std::cerr << "warning: cannot write content for " << file.relativePath << std::endl;
+        }
+        std::vector<char>().swap(contents[i]);
+    }
+
+    m_batch.clear();
+    m_batchSize = 0;
+}
+
+void Packer::packEnd(const ArchiveSink& sink) {
+    flushBatch(sink);
+
     // 写入归档结束标记(两个空的512字节块)
     char endBlocks[BLOCK_SIZE * 2];
     std::memset(endBlocks, 0, sizeof(endBlocks));
-    archive.write(endBlocks, sizeof(endBlocks));
+    sink(endBlocks, sizeof(endBlocks));
+}
 
-    archive.close();
-    std::cout << "打包完成: " << outputArchivePath << std::endl;
-    return true;
+char Packer::typeflagOf(FileType type) {
+    switch (type) {
+    case FileType::DIRECTORY:        return '5';
+    case FileType::SYMLINK:          return '2';
+    case FileType::CHARACTER_DEVICE: return '3';
+    case FileType::BLOCK_DEVICE:     return '4';
+    case FileType::FIFO:             return '6';
+    // USTAR 不直接支持 Socket，通常跳过或标记为常规文件
+    // 这里我们标记为 'S' (非标准但常见) 以便识别，或者保持 '0'
+    case FileType::SOCKET:           return 'S';
+    default:                         return '0'; // 默认常规文件
+    }
 }
 
 void Packer::fillHeader(const FileInfo& file, TarHeader* header) {
@@ -123,26 +275,12 @@ void Packer::fillHeader(const FileInfo& file, TarHeader* header) {
     toOctal(header->mtime, file.lastModified, sizeof(header->mtime));
 
     // 3. 类型 & 大小 & 链接名
-    header->typeflag = '0'; // 默认常规文件
+    header->typeflag = typeflagOf(file.type);
     uint64_t fileSize = 0;
 
-    if (file.type == FileType::DIRECTORY) {
-        header->typeflag = '5';
-    } else if (file.type == FileType::SYMLINK) {
-        header->typeflag = '2';
+    if (file.type == FileType::SYMLINK) {
         std::strncpy(header->linkname, file.linkTarget.c_str(), sizeof(header->linkname) - 1);
-    } else if (file.type == FileType::CHARACTER_DEVICE) {
-        header->typeflag = '3';
-    } else if (file.type == FileType::BLOCK_DEVICE) {
-        header->typeflag = '4';
-    } else if (file.type == FileType::FIFO) {
-        header->typeflag = '6';
-    } else if (file.type == FileType::SOCKET) {
-        // USTAR 不直接支持 Socket，通常跳过或标记为常规文件
-        // 这里我们标记为 'S' (非标准但常见) 以便识别，或者保持 '0'
-        header->typeflag = 'S'; 
-    } else {
-        header->typeflag = '0';
+    } else if (header->typeflag == '0') {
         fileSize = file.size;
     }
     
@@ -153,8 +291,11 @@ void Packer::fillHeader(const FileInfo& file, TarHeader* header) {
     std::strncpy(header->version, VERSION, sizeof(header->version));
 
     // 5. 用户名和组名
-    std::strncpy(header->uname, file.userName.c_str(), sizeof(header->uname));
-    std::strncpy(header->gname, file.groupName.c_str(), sizeof(header->gname));
+    // 遍历时未解析名称（TraverseOptions::resolveNames = false）则在这里按需解析
+    std::string userName = file.userName.empty() ? NameCache::instance().userName(file.UID) : file.userName;
+    std::string groupName = file.groupName.empty() ? NameCache::instance().groupName(file.GID) : file.groupName;
+    std::strncpy(header->uname, userName.c_str(), sizeof(header->uname));
+    std::strncpy(header->gname, groupName.c_str(), sizeof(header->gname));
 
     // 6. 设备号（仅用于字符设备和块设备）
     if (file.type == FileType::CHARACTER_DEVICE || file.type == FileType::BLOCK_DEVICE) {
@@ -174,22 +315,49 @@ void Packer::calculateChecksum(TarHeader* header) {
     snprintf(header->chksum, sizeof(header->chksum), "%06lo", sum);
 }
 
-bool Packer::writeFileContent(const FileInfo& file, std::ofstream& archive) {
+bool Packer::writeFileContent(const FileInfo& file, const ArchiveSink& sink) {
     std::ifstream input(file.absolutePath, std::ios::binary);
-    if (!input.is_open()) return false;
-    archive << input.rdbuf();
+    bool ok = input.is_open();
+
+    // 头部中已写入 file.size，数据区必须恰好是这么多字节，否则后续头部会错位。
+    // 文件在遍历后被截断时用 0 补齐，变长时截断到遍历时的大小。
+    const size_t bufSize = 64 * 1024;
+    std::vector<char> buffer(bufSize);
+    uint64_t remaining = file.size;
+    while (remaining > 0) {
+        size_t toRead = (remaining < bufSize) ? remaining : bufSize;
+        size_t got = 0;
+        if (ok) {
+            input.read(buffer.data(), toRead);
+            got = static_cast<size_t>(input.gcount());
+            if (got < toRead) ok = false;
+        }
+        if (got < toRead) std::memset(buffer.data() + got, 0, toRead - got);
+        sink(buffer.data(), toRead);
+        remaining -= toRead;
+    }
 
     // 填充至512字节
     size_t padding = (BLOCK_SIZE - (file.size % BLOCK_SIZE)) % BLOCK_SIZE;
     if (padding > 0) {
         char pad[BLOCK_SIZE] = {0};
-        archive.write(pad, padding);
+        sink(pad, padding);
     }
-    return true;
+    return ok;
 }
 
 // 提取实现
 
+size_t readFully(const ArchiveSource& source, char* buf, size_t len) {
+    size_t total = 0;
+    while (total < len) {
+        size_t n = source(buf + total, len - total);
+        if (n == 0) break;
+        total += n;
+    }
+    return total;
+}
+
 bool Packer::unpack(const std::string& inputArchivePath, const std::string& outputDir) {
     std::ifstream archive(inputArchivePath, std::ios::binary);
     if (!archive.is_open()) {
@@ -197,12 +365,19 @@ bool Packer::unpack(const std::string& inputArchivePath, const std::string& outp
         return false;
     }
 
+    return unpack([&archive](char* buf, size_t len) -> size_t {
+        archive.read(buf, len);
+        return static_cast<size_t>(archive.gcount());
+    }, outputDir);
+}
+
+bool Packer::unpack(const ArchiveSource& source, const std::string& outputDir) {
     if (!std::filesystem::exists(outputDir)) {
         std::filesystem::create_directories(outputDir);
     }
 
     TarHeader header;
-    while (archive.read(reinterpret_cast<char*>(&header), sizeof(TarHeader))) {
+    while (readFully(source, reinterpret_cast<char*>(&header), sizeof(TarHeader)) == sizeof(TarHeader)) {
         // 检查归档结束(空块)
         if (header.name[0] == '\0') {
             // 读取可能的第二个空块并退出
@@ -218,6 +393,9 @@ bool Packer::unpack(const std::string& inputArchivePath, const std::string& outp
         // 基本路径安全检查: 防止".."遍历
         if (relPath.find("..") != std::string::npos) {
             std::cerr << "警告: 跳过不安全的路径 " << relPath << std::endl;
+            // 跳过该条目的数据块以保持对齐
+            char skipType = header.typeflag ? header.typeflag : '0';
+            if (skipType == '0') skipBytes(source, fromOctal(header.size, sizeof(header.size)));
             continue; 
         }
 
@@ -260,7 +438,7 @@ bool Packer::unpack(const std::string& inputArchivePath, const std::string& outp
             std::cerr << "信息: 跳过 Socket 文件还原 " << destPath << " (Socket 应由进程创建)" << std::endl;
         }
         else { // 常规文件 ('0' 或 '\0')
-            extractFileContent(archive, destPath.string(), fileSize);
+            extractFileContent(source, destPath.string(), fileSize);
         }
 
         // 恢复元数据(权限和时间)
@@ -279,30 +457,45 @@ bool Packer::verifyChecksum(const TarHeader* header) {
     return storedSum == calcedSum;
 }
 
-void Packer::extractFileContent(std::ifstream& archive, const std::string& destPath, uint64_t size) {
+void Packer::extractFileContent(const ArchiveSource& source, const std::string& destPath, uint64_t size) {
     std::ofstream out(destPath, std::ios::binary | std::ios::trunc);
     if (!out.is_open()) {
         std::cerr << "错误: 无法创建文件 " << destPath << std::endl;
         // 跳过归档中的数据以保持对齐
-        archive.seekg((size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE, std::ios::cur);
+        skipBytes(source, size);
         return;
     }
 
-    const size_t bufSize = 4096;
-    char buffer[bufSize];
+    const size_t bufSize = 64 * 1024;
+    std::vector<char> buffer(bufSize);
     uint64_t remaining = size;
 
     while (remaining > 0) {
         size_t toRead = (remaining < bufSize) ? remaining : bufSize;
-        archive.read(buffer, toRead);
-        out.write(buffer, toRead);
+        size_t got = readFully(source, buffer.data(), toRead);
+        out.write(buffer.data(), got);
+        if (got < toRead) {
+            std::cerr << "错误: 归档数据不完整 " << destPath << std::endl;
+            return;
+        }
         remaining -= toRead;
     }
 
     // 跳过归档中的填充数据
     size_t padding = (BLOCK_SIZE - (size % BLOCK_SIZE)) % BLOCK_SIZE;
     if (padding > 0) {
-        archive.ignore(padding);
+        char pad[BLOCK_SIZE];
+        readFully(source, pad, padding);
+    }
+}
+
+void Packer::skipBytes(const ArchiveSource& source, uint64_t size) {
+    uint64_t remaining = (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    char buffer[BLOCK_SIZE * 8];
+    while (remaining > 0) {
+        size_t toRead = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+        if (readFully(source, buffer, toRead) < toRead) return;
+        remaining -= toRead;
     }
 }
 
@@ -331,4 +524,123 @@ void Packer::restoreMetadata(const std::string& path, const TarHeader* header) {
     utimes(path.c_str(), times);
 }
 
+// 流式解析实现
+
+TarWalker::TarWalker(Callbacks callbacks) : m_callbacks(std::move(callbacks)) {}
+
+void TarWalker::feed(const uint8_t* data, size_t len) {
+    while (len > 0) {
+        switch (m_state) {
+        case State::HEADER:
+        case State::END_BLOCK: {
+            size_t n = std::min(len, BLOCK_SIZE - m_blockFill);
+            std::memcpy(m_block + m_blockFill, data, n);
+            m_blockFill += n;
+            data += n;
+            len -= n;
+            m_offset += n;
+            if (m_blockFill < BLOCK_SIZE) break;
+            m_blockFill = 0;
+
+            bool zero = std::all_of(m_block, m_block + BLOCK_SIZE, [](char c) { return c == 0; });
+            if (m_state == State::END_BLOCK) {
+                if (!zero) throw std::runtime_error("tar 结束标记不完整 (偏移 " + std::to_string(m_offset - BLOCK_SIZE) + ")");
+                m_state = State::TRAILER;
+            } else if (zero) {
+                m_state = State::END_BLOCK;
+            } else {
+                m_headerOffset = m_offset - BLOCK_SIZE;
+                parseHeader();
+            }
+            break;
+        }
+        case State::DATA: {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(len, m_remaining));
+            if (m_callbacks.onData) m_callbacks.onData(data, n);
+            data += n;
+            len -= n;
+            m_offset += n;
+            m_remaining -= n;
+            if (m_remaining == 0) {
+                if (m_callbacks.onEntryEnd) m_callbacks.onEntryEnd();
+                m_remaining = m_padding;
+                m_state = m_padding ? State::PADDING : State::HEADER;
+            }
+            break;
+        }
+        case State::PADDING:
+        case State::TRAILER: {
+            // 填充与结束标记之后的数据都必须为 0
+            size_t n = (m_state == State::PADDING) ? static_cast<size_t>(std::min<uint64_t>(len, m_remaining)) : len;
+            if (!std::all_of(data, data + n, [](uint8_t b) { return b == 0; })) {
+                throw std::runtime_error("tar 数据未按块对齐 (偏移 " + std::to_string(m_offset) + ")");
+            }
+            data += n;
+            len -= n;
+            m_offset += n;
+            if (m_state == State::PADDING) {
+                m_remaining -= n;
+                if (m_remaining == 0) m_state = State::HEADER;
+            }
+            break;
+        }
+        }
+    }
+}
+
+void TarWalker::finish() {
+    if (m_state != State::TRAILER) {
+        throw std::runtime_error("tar 数据被截断 (偏移 " + std::to_string(m_offset) + ")");
+    }
+}
+
+TarEntry TarWalker::decodeHeader(const uint8_t* block, uint64_t headerOffset) {
+    const Packer::TarHeader* header = reinterpret_cast<const Packer::TarHeader*>(block);
+    std::string offsetStr = std::to_string(headerOffset);
+
+    if (std::strncmp(header->magic, MAGIC, 5) != 0) {
+        throw std::runtime_error("tar 头部 magic 错误 (偏移 " + offsetStr + ")");
+    }
+    if (!Packer::verifyChecksum(header)) {
+        throw std::runtime_error("tar 头部校验和错误 (偏移 " + offsetStr + ")");
+    }
+
+    TarEntry entry;
+    std::string name(header->name, strnlen(header->name, sizeof(header->name)));
+    std::string prefix(header->prefix, strnlen(header->prefix, sizeof(header->prefix)));
+    entry.path = prefix.empty() ? name : prefix + "/" + name;
+    entry.typeflag = header->typeflag ? header->typeflag : '0';
+    entry.size = Packer::fromOctal(header->size, sizeof(header->size));
+    entry.mode = static_cast<mode_t>(Packer::fromOctal(header->mode, sizeof(header->mode)));
+    entry.mtime = static_cast<time_t>(Packer::fromOctal(header->mtime, sizeof(header->mtime)));
+    entry.uid = static_cast<uid_t>(Packer::fromOctal(header->uid, sizeof(header->uid)));
+    entry.gid = static_cast<gid_t>(Packer::fromOctal(header->gid, sizeof(header->gid)));
+    entry.userName.assign(header->uname, strnlen(header->uname, sizeof(header->uname)));
+    entry.groupName.assign(header->gname, strnlen(header->gname, sizeof(header->gname)));
+    entry.linkTarget.assign(header->linkname, strnlen(header->linkname, sizeof(header->linkname)));
+
+    if (entry.path.empty()) {
+        throw std::runtime_error("tar 头部路径为空 (偏移 " + offsetStr + ")");
+    }
+    return entry;
+}
+
+void TarWalker::parseHeader() {
+    TarEntry entry = decodeHeader(reinterpret_cast<const uint8_t*>(m_block), m_headerOffset);
+
+    ++m_entries;
+    if (m_callbacks.onEntry) m_callbacks.onEntry(entry, m_headerOffset);
+
+    // 只有常规文件带数据区；其他类型的 size 字段按 0 处理（与 Packer::unpack 一致）
+    uint64_t dataSize = (entry.typeflag == '0') ? entry.size : 0;
+    m_remaining = dataSize;
+    m_padding = (BLOCK_SIZE - (dataSize % BLOCK_SIZE)) % BLOCK_SIZE;
+    if (dataSize > 0) {
+        m_state = State::DATA;
+    } else {
+        if (m_callbacks.onEntryEnd) m_callbacks.onEntryEnd();
+        m_state = State::HEADER;
+    }
+}
+
 } // namespace Backup
\ No newline at end of file
@@ -0,0 +1,679 @@
+#include "pipeline.h"
+#include "bounded_queue.h"
+#include "packer.h"
+#include "hasher.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace Backup {
+
+namespace {
+
+// 记录流水线中第一个失败阶段的异常，并通知其他阶段停止
+class FirstError {
+public:
+    template <typename Abort>
+    void fail(std::exception_ptr error, Abort&& abortAll) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error) m_error = error;
+        }
+        abortAll();
+    }
+
+    void rethrowIfAny() {
+        std::exception_ptr error = get();
+        if (error) std::rethrow_exception(error);
+    }
+
+    std::exception_ptr get() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::exception_ptr m_error;
+};
+
+struct RawChunk {
+    uint64_t seq = 0;
+    bool manifest = false;      // 属于文件清单而非 tar 流
+    std::vector<uint8_t> data;
+};
+
+struct EncodedChunk {
+    bool manifest = false;
+    ChunkRecordHeader record;
+    std::vector<uint8_t> stored;
+};
+
+// 文件清单的暂存区：条目编码后先在内存中累积，超过上限时写入临时文件。
+// 临时文件由 mkstemp 以 0600 创建在目标目录下并立即删除，只通过 fd 访问，异常退出也不会残留
+class ManifestSpill {
+public:
+    ManifestSpill(const std::string& dstFile, size_t limit) : m_dstFile(dstFile), m_limit(limit) {}
+    ~ManifestSpill() {
+        if (m_fd != -1) ::close(m_fd);
+    }
+    ManifestSpill(const ManifestSpill&) = delete;
+    ManifestSpill& operator=(const ManifestSpill&) = delete;
+
+    void add(const ManifestEntry& entry) {
+        appendManifestEntry(entry, m_buffer);
+        ++m_count;
+        if (m_buffer.size() >= m_limit) spill();
+    }
+
+    uint64_t count() const { return m_count; }
+    uint64_t spilledBytes() const { return m_spilled; }
+
+    // 按顺序输出完整的清单：头部、临时文件中的条目、内存中剩余的条目
+    template <typename Sink>
+    void drain(Sink&& sink, size_t blockSize) {
+        uint8_t header[MANIFEST_HEADER_SIZE];
+        encodeManifestHeader(m_count, header);
+        sink(header, sizeof(header));
+        std::vector<uint8_t> block(blockSize);
+        for (uint64_t offset = 0; offset < m_spilled;) {
+            ssize_t n = ::pread(m_fd, block.data(), static_cast<size_t>(std::min<uint64_t>(blockSize, m_spilled - offset)),
+                                static_cast<off_t>(offset));
+            if (n <= 0) throw std::runtime_error("无法读取文件清单临时文件。");
+            sink(block.data(), static_cast<size_t>(n));
+            offset += static_cast<uint64_t>(n);
+        }
+        sink(m_buffer.data(), m_buffer.size());
+    }
+
+private:
+    void spill() {
+        if (m_fd == -1) {
+            std::string path = m_dstFile + ".manifest.XXXXXX";
+            m_fd = ::mkstemp(&path[0]);
+            if (m_fd == -1) throw std::runtime_error("无法创建文件清单临时文件。");
+            ::unlink(path.c_str());
+        }
+        size_t written = 0;
+        while (written < m_buffer.size()) {
+            ssize_t n = ::write(m_fd, m_buffer.data() + written, m_buffer.size() - written);
+            if (n <= 0) throw std::runtime_error("无法写入文件清单临时文件。");
+            written += static_cast<size_t>(n);
+        }
+        m_spilled += written;
+        m_buffer.clear();
+    }
+
+    std::string m_dstFile;
+    size_t m_limit;
+    std::vector<uint8_t> m_buffer;
+    uint64_t m_count = 0;
+    uint64_t m_spilled = 0;
+    int m_fd = -1;
+};
+
+// 指向内存映射区中的一个块记录，不拷贝数据
+struct MappedChunk {
+    uint64_t seq = 0;
+    ChunkRecordHeader record;
+    const uint8_t* stored = nullptr;
+};
+
+unsigned int resolveWorkers(unsigned int workers) {
+    if (workers > 0) return workers;
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 2 : n;
+}
+
+} // namespace
+
+// 加密时校验头部中的密钥校验值，尽早识别错误密码
+static void checkArchiveKey(const ArchiveHeader& header, const Encryptor* encryptor) {
+    if (!(header.flags & ARCHIVE_FLAG_ENCRYPTED)) return;
+    if (!encryptor) {
+        throw std::runtime_error("备份文件已加密，请提供密码。");
+    }
+    uint8_t check[8];
+    encryptor->keyCheck(check);
+    if (std::memcmp(check, header.keyCheck, sizeof(check)) != 0) {
+        throw std::runtime_error("解密失败。密码错误？");
+    }
+}
+
+// 块大小必须落在头部声明的范围内，防止损坏的记录导致超大内存分配
+static void checkRecordBounds(const ArchiveHeader& header, const ChunkRecordHeader& record) {
+    uint64_t maxStored = static_cast<uint64_t>(header.chunkSize) * 2 + 64 * 1024;
+    if (record.rawSize > header.chunkSize || record.storedSize > maxStored) {
+        throw std::runtime_error("数据块记录损坏 (大小越界)。");
+    }
+}
+
+// 从映射区解析头部和尾部，并校验密钥
+static void readArchiveFrame(const MappedFile& file, const Encryptor* encryptor, ArchiveHeader& header, ArchiveFooter& footer) {
+    if (file.size() < ARCHIVE_HEADER_SIZE + ARCHIVE_FOOTER_SIZE) {
+        throw std::runtime_error("备份文件为空或不完整。");
+    }
+    header = decodeArchiveHeader(file.data());
+    footer = decodeArchiveFooter(file.data() + file.size() - ARCHIVE_FOOTER_SIZE);
+    if (footer.indexOffset < ARCHIVE_HEADER_SIZE ||
+        footer.totalChunks() > file.size() / CHUNK_INDEX_ENTRY_SIZE ||
+        footer.indexOffset + footer.totalChunks() * CHUNK_INDEX_ENTRY_SIZE + ARCHIVE_FOOTER_SIZE != file.size()) {
+        throw std::runtime_error("备份文件尾部损坏或不完整。");
+    }
+    checkArchiveKey(header, encryptor);
+}
+
+// 读取并校验尾部索引
+static std::vector<ChunkIndexEntry> readChunkIndex(const MappedFile& file, const ArchiveFooter& footer) {
+    const uint8_t* indexData = file.data() + footer.indexOffset;
+    size_t indexSize = footer.totalChunks() * CHUNK_INDEX_ENTRY_SIZE;
+    if (crc32(indexData, indexSize) != footer.indexCrc) {
+        throw std::runtime_error("备份文件索引损坏 (校验和错误)。");
+    }
+    std::vector<ChunkIndexEntry> index(footer.totalChunks());
+    for (size_t i = 0; i < index.size(); ++i) {
+        index[i] = decodeChunkIndexEntry(indexData + i * CHUNK_INDEX_ENTRY_SIZE);
+    }
+    return index;
+}
+
+// 读取 offset 处的块记录，offset 前进到下一条记录
+static MappedChunk readMappedChunk(const MappedFile& file, const ArchiveHeader& header, const ArchiveFooter& footer,
+                                   uint64_t seq, size_t& offset) {
+    if (offset + CHUNK_RECORD_HEADER_SIZE > footer.indexOffset) {
+        throw std::runtime_error("备份文件被截断。");
+    }
+    MappedChunk chunk;
+    chunk.seq = seq;
+    chunk.record = decodeChunkRecordHeader(file.data() + offset);
+    checkRecordBounds(header, chunk.record);
+    offset += CHUNK_RECORD_HEADER_SIZE;
+    if (offset + chunk.record.storedSize > footer.indexOffset) {
+        throw std::runtime_error("备份文件被截断。");
+    }
+    chunk.stored = file.data() + offset;
+    offset += chunk.record.storedSize;
+    return chunk;
+}
+
+std::vector<uint8_t> encodeChunk(const std::vector<uint8_t>& raw, CompressionAlgorithm algo, const Encryptor* encryptor,
+                                 uint64_t chunkIndex, ChunkRecordHeader& record) {
+    Compressor compressor;
+    std::vector<uint8_t> stored = compressor.compress(raw, algo);
+    if (encryptor) {
+        stored = encryptor->encryptChunk(stored.data(), stored.size(), chunkIndex);
+    }
+    record.rawSize = static_cast<uint32_t>(raw.size());
+    record.storedSize = static_cast<uint32_t>(stored.size());
+    record.rawCrc = crc32(raw.data(), raw.size());
+    record.storedCrc = crc32(stored.data(), stored.size());
+    return stored;
+}
+
+std::vector<uint8_t> decodeChunk(const ArchiveHeader& header, const Encryptor* encryptor, uint64_t chunkIndex,
+                                 const ChunkRecordHeader& record, const uint8_t* stored) {
+    if (crc32(stored, record.storedSize) != record.storedCrc) {
+        throw std::runtime_error("数据块 " + std::to_string(chunkIndex) + " 校验和错误，备份文件已损坏。");
+    }
+
+    // 未加密时直接从存储区（通常是内存映射）解压，不做额外拷贝
+    std::vector<uint8_t> decrypted;
+    const uint8_t* compressed = stored;
+    size_t compressedSize = record.storedSize;
+    if (header.flags & ARCHIVE_FLAG_ENCRYPTED) {
+        if (!encryptor) throw std::runtime_error("备份文件已加密，请提供密码。");
+        decrypted = encryptor->decryptChunk(stored, record.storedSize, chunkIndex);
+        compressed = decrypted.data();
+        compressedSize = decrypted.size();
+    }
+
+    Compressor compressor;
+    std::vector<uint8_t> raw;
+    try {
+        raw = compressor.decompress(compressed, compressedSize);
+    } catch (const std::exception& e) {
+        throw std::runtime_error("解压失败。数据损坏？");
+    }
+
+    if (raw.size() != record.rawSize || crc32(raw.data(), raw.size()) != record.rawCrc) {
+        throw std::runtime_error("数据块 " + std::to_string(chunkIndex) + " 解码结果校验失败。");
+    }
+    return raw;
+}
+
+// ---------------------------------------------------------
+// 备份流水线
+// ---------------------------------------------------------
+
+BackupPipeline::BackupPipeline(CompressionAlgorithm algo, const Encryptor* encryptor, const PipelineOptions& options)
+    : m_algo(algo), m_encryptor(encryptor), m_options(options) {
+    m_options.workers = resolveWorkers(m_options.workers);
+    if (m_options.queueDepth == 0) m_options.queueDepth = m_options.workers * 2;
+    if (m_options.chunkSize == 0) m_options.chunkSize = PipelineOptions().chunkSize;
+}
+
+PipelineStats BackupPipeline::run(const std::vector<FileInfo>& files, const std::string& dstFile) {
+    return run([&files](const ArchiveSink& sink) { Packer().pack(files, sink); }, dstFile);
+}
+
+PipelineStats BackupPipeline::run(const Producer& producer, const std::string& dstFile) {
+    std::string partFile = dstFile + ".part";
+    std::ofstream out(partFile, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("无法写入目标文件。");
+    }
+
+    ArchiveHeader header;
+    header.flags = m_encryptor ? ARCHIVE_FLAG_ENCRYPTED : 0;
+    if (m_options.delta) header.flags |= ARCHIVE_FLAG_DELTA;
+    header.algorithm = static_cast<uint8_t>(m_algo);
+    header.chunkSize = static_cast<uint32_t>(m_options.chunkSize);
+    if (m_encryptor) m_encryptor->keyCheck(header.keyCheck);
+
+    uint8_t headerBuf[ARCHIVE_HEADER_SIZE];
+    encodeArchiveHeader(header, headerBuf);
+    out.write(reinterpret_cast<const char*>(headerBuf), sizeof(headerBuf));
+
+    BoundedQueue<RawChunk> rawQueue(m_options.queueDepth);
+    ReorderBuffer<EncodedChunk> encoded(m_options.queueDepth);
+    FirstError errors;
+    uint64_t entryCount = 0;
+    uint64_t manifestSpilled = 0;
+    auto abortAll = [&] {
+        rawQueue.abort();
+        encoded.abort();
+    };
+
+    // 阶段 1: 打包，把 tar 字节流切成固定大小的块送入队列
+    std::thread packStage([&] {
+        try {
+            RawChunk current;
+            current.data.reserve(m_options.chunkSize);
+            uint64_t seq = 0;
+            bool inManifest = false;
+
+            auto flush = [&] {
+                current.seq = seq++;
+                current.manifest = inManifest;
+                if (!rawQueue.push(std::move(current))) {
+                    throw std::runtime_error("备份流水线已中止。");
+                }
+                current = RawChunk();
+                current.data.reserve(m_options.chunkSize);
+            };
+            auto append = [&](const uint8_t* p, size_t len) {
+                while (len > 0) {
+                    size_t n = std::min(len, m_options.chunkSize - current.data.size());
+                    current.data.insert(current.data.end(), p, p + n);
+                    p += n;
+                    len -= n;
+                    if (current.data.size() == m_options.chunkSize) flush();
+                }
+            };
+
+            // 打包输出同时经过 TarWalker，逐个文件计算内容哈希，生成文件清单。
+            // 条目的哈希在内容结束时才确定，因此只保留当前条目，下一个条目开始时写入暂存区
+            ManifestSpill manifest(dstFile, m_options.manifestMemory);
+            ManifestEntry item;
+            bool haveItem = false;
+            Sha256 hasher;
+            TarWalker::Callbacks callbacks;
+            callbacks.onEntry = [&](const TarEntry& entry, uint64_t headerOffset) {
+                if (haveItem) manifest.add(item);
+                item = ManifestEntry();
+                item.path = entry.path;
+                item.typeflag = entry.typeflag;
+                item.size = entry.size;
+                item.mtime = entry.mtime;
+                item.headerOffset = headerOffset;
+                haveItem = true;
+                hasher.reset();
+            };
+            callbacks.onData = [&](const uint8_t* data, size_t len) { hasher.update(data, len); };
+            callbacks.onEntryEnd = [&] {
+                if (item.typeflag != '0') return;
+                item.sha256 = hasher.finish();
+                item.hasHash = true;
+            };
+            TarWalker walker(std::move(callbacks));
+
+            producer([&](const char* data, size_t len) {
+                const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+                walker.feed(p, len);
+                append(p, len);
+            });
+            walker.finish();
+            if (haveItem) manifest.add(item);
+            if (!current.data.empty()) flush();
+
+            // 文件清单紧接在 tar 流之后，使用独立的块
+            inManifest = true;
+            manifest.drain(append, m_options.chunkSize);
+            if (!current.data.empty()) flush();
+            entryCount = manifest.count();
+            manifestSpilled = manifest.spilledBytes();
+
+            rawQueue.close();
+            encoded.finish(seq);
+        } catch (...) {
+            errors.fail(std::current_exception(), abortAll);
+        }
+    });
+
+    // 阶段 2: 并行压缩 + 加密
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < m_options.workers; ++t) {
+        workers.emplace_back([&] {
+            try {
+                RawChunk chunk;
+                while (rawQueue.pop(chunk)) {
+                    EncodedChunk result;
+                    result.manifest = chunk.manifest;
+                    result.stored = encodeChunk(chunk.data, m_algo, m_encryptor, chunk.seq, result.record);
+                    if (!encoded.put(chunk.seq, std::move(result))) break;
+                }
+            } catch (...) {
+                errors.fail(std::current_exception(), abortAll);
+            }
+        });
+    }
+
+    // 阶段 3: 按序写入（当前线程）
+    PipelineStats stats;
+    std::vector<ChunkIndexEntry> index;
+    uint64_t offset = ARCHIVE_HEADER_SIZE;
+    uint64_t dataChunks = 0;
+    try {
+        EncodedChunk chunk;
+        while (encoded.take(chunk)) {
+            uint8_t recordBuf[CHUNK_RECORD_HEADER_SIZE];
+            encodeChunkRecordHeader(chunk.record, recordBuf);
+            out.write(reinterpret_cast<const char*>(recordBuf), sizeof(recordBuf));
+            out.write(reinterpret_cast<const char*>(chunk.stored.data()), chunk.stored.size());
+            if (!out) throw std::runtime_error("无法写入目标文件。");
+
+            ChunkIndexEntry entry;
+            entry.offset = offset;
+            entry.rawOffset = chunk.manifest ? stats.manifestBytes : stats.rawBytes;
+            entry.rawSize = chunk.record.rawSize;
+            entry.storedSize = chunk.record.storedSize;
+            entry.rawCrc = chunk.record.rawCrc;
+            entry.storedCrc = chunk.record.storedCrc;
+            index.push_back(entry);
+
+            offset += CHUNK_RECORD_HEADER_SIZE + chunk.stored.size();
+            if (chunk.manifest) {
+                stats.manifestBytes += chunk.record.rawSize;
+            } else {
+                stats.rawBytes += chunk.record.rawSize;
+                ++dataChunks;
+            }
+        }
+    } catch (...) {
+        errors.fail(std::current_exception(), abortAll);
+    }
+
+    packStage.join();
+    for (auto& w : workers) w.join();
+
+    try {
+        errors.rethrowIfAny();
+
+        // 块索引 + 尾部
+        std::vector<uint8_t> indexBuf(index.size() * CHUNK_INDEX_ENTRY_SIZE);
+        for (size_t i = 0; i < index.size(); ++i) {
+            encodeChunkIndexEntry(index[i], indexBuf.data() + i * CHUNK_INDEX_ENTRY_SIZE);
+        }
+        out.write(reinterpret_cast<const char*>(indexBuf.data()), indexBuf.size());
+
+        ArchiveFooter footer;
+        footer.indexOffset = offset;
+        footer.chunkCount = dataChunks;
+        footer.manifestChunks = index.size() - dataChunks;
+        footer.rawSize = stats.rawBytes;
+        footer.manifestSize = stats.manifestBytes;
+        footer.indexCrc = crc32(indexBuf.data(), indexBuf.size());
+        uint8_t footerBuf[ARCHIVE_FOOTER_SIZE];
+        encodeArchiveFooter(footer, footerBuf);
+        out.write(reinterpret_cast<const char*>(footerBuf), sizeof(footerBuf));
+
+        out.close();
+        if (!out) throw std::runtime_error("无法写入目标文件。");
+        std::filesystem::rename(partFile, dstFile);
+
+        stats.chunks = dataChunks;
+        stats.entries = entryCount;
+        stats.manifestSpilled = manifestSpilled;
+        stats.storedBytes = offset + indexBuf.size() + ARCHIVE_FOOTER_SIZE;
+    } catch (...) {
+        out.close();
+        std::error_code ec;
+        std::filesystem::remove(partFile, ec);
+        throw;
+    }
+    return stats;
+}
+
+// ---------------------------------------------------------
+// 还原流水线
+// ---------------------------------------------------------
+
+RestorePipeline::RestorePipeline(const Encryptor* encryptor, const PipelineOptions& options)
+    : m_encryptor(encryptor), m_options(options) {
+    m_options.workers = resolveWorkers(m_options.workers);
+    if (m_options.queueDepth == 0) m_options.queueDepth = m_options.workers * 2;
+}
+
+PipelineStats RestorePipeline::run(const std::string& srcFile, const Consumer& consumer) {
+    MappedFile file(srcFile, MappedFile::Access::SEQUENTIAL);
+    ArchiveHeader header;
+    ArchiveFooter footer;
+    readArchiveFrame(file, m_encryptor, header, footer);
+
+    BoundedQueue<MappedChunk> storedQueue(m_options.queueDepth);
+    ReorderBuffer<std::vector<uint8_t>> decoded(m_options.queueDepth);
+    FirstError errors;
+    auto abortAll = [&] {
+        storedQueue.abort();
+        decoded.abort();
+    };
+
+    // 阶段 1: 顺序解析块记录（只传递映射区指针）
+    std::thread readStage([&] {
+        try {
+            size_t offset = ARCHIVE_HEADER_SIZE;
+            for (uint64_t seq = 0; seq < footer.chunkCount; ++seq) {
+                if (!storedQueue.push(readMappedChunk(file, header, footer, seq, offset))) return;
+            }
+            storedQueue.close();
+            decoded.finish(footer.chunkCount);
+        } catch (...) {
+            errors.fail(std::current_exception(), abortAll);
+        }
+    });
+
+    // 阶段 2: 并行解密 + 解压
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < m_options.workers; ++t) {
+        workers.emplace_back([&] {
+            try {
+                MappedChunk chunk;
+                while (storedQueue.pop(chunk)) {
+                    std::vector<uint8_t> raw = decodeChunk(header, m_encryptor, chunk.seq, chunk.record, chunk.stored);
+                    if (!decoded.put(chunk.seq, std::move(raw))) break;
+                }
+            } catch (...) {
+                errors.fail(std::current_exception(), abortAll);
+            }
+        });
+    }
+
+    // 阶段 3: 消费者按序拉取（当前线程）
+    PipelineStats stats;
+    std::vector<uint8_t> current;
+    size_t pos = 0;
+    ArchiveSource source = [&](char* buf, size_t len) -> size_t {
+        while (pos >= current.size()) {
+            if (!decoded.take(current)) return 0;
+            pos = 0;
+            ++stats.chunks;
+            stats.rawBytes += current.size();
+        }
+        size_t n = std::min(len, current.size() - pos);
+        std::memcpy(buf, current.data() + pos, n);
+        pos += n;
+        return n;
+    };
+
+    try {
+        consumer(source);
+    } catch (...) {
+        errors.fail(std::current_exception(), abortAll);
+    }
+    // 只关心消费者结束之前发生的错误：阶段失败会让 source 提前返回 0，
+    // 消费者看到的是被截断的流。之后的错误只涉及消费者不再需要的块。
+    std::exception_ptr error = errors.get();
+
+    // 消费者可能在 tar 结束标记处提前返回，剩余块无需再解码
+    abortAll();
+    readStage.join();
+    for (auto& w : workers) w.join();
+    if (error) std::rethrow_exception(error);
+    stats.storedBytes = file.size();
+    return stats;
+}
+
+std::vector<ManifestEntry> readManifest(const std::string& path, const Encryptor* encryptor) {
+    ArchiveReader reader(path, encryptor, MappedFile::Access::RANDOM);
+    return readManifest(reader);
+}
+
+std::vector<ManifestEntry> readManifest(ArchiveReader& reader) {
+    ManifestReader manifest(reader);
+    std::vector<ManifestEntry> entries;
+    ManifestEntry entry;
+    while (manifest.next(entry)) entries.push_back(std::move(entry));
+    return entries;
+}
+
+ManifestReader::ManifestReader(ArchiveReader& reader) : m_reader(reader), m_nextChunk(reader.footer().chunkCount) {
+    while (m_data.size() < MANIFEST_HEADER_SIZE && fill()) {}
+    m_count = decodeManifestHeader(m_data.data(), m_data.size());
+    m_pos = MANIFEST_HEADER_SIZE;
+}
+
+bool ManifestReader::fill() {
+    if (m_nextChunk >= m_reader.footer().totalChunks()) return false;
+    std::vector<uint8_t> raw;
+    m_reader.readChunk(m_nextChunk++, raw);
+    m_rawBytes += raw.size();
+    if (m_pos == m_data.size()) {
+        m_data.swap(raw);
+    } else {
+        // 跨块的条目：只保留上一块中未解码的尾部
+        m_data.erase(m_data.begin(), m_data.begin() + static_cast<std::ptrdiff_t>(m_pos));
+        m_data.insert(m_data.end(), raw.begin(), raw.end());
+    }
+    m_pos = 0;
+    return true;
+}
+
+bool ManifestReader::next(ManifestEntry& entry) {
+    if (m_read == m_count) {
+        if (!m_finished) {
+            m_finished = true;
+            if (m_pos != m_data.size() || m_nextChunk != m_reader.footer().totalChunks()) {
+                throw std::runtime_error("文件清单损坏 (多余数据)。");
+            }
+            if (m_rawBytes != m_reader.footer().manifestSize) {
+                throw std::runtime_error("文件清单损坏 (长度不符)。");
+            }
+        }
+        return false;
+    }
+    for (;;) {
+        size_t n = decodeManifestEntry(m_data.data() + m_pos, m_data.size() - m_pos, entry);
+        if (n > 0) {
+            m_pos += n;
+            ++m_read;
+            return true;
+        }
+        if (!fill()) throw std::runtime_error("文件清单损坏 (长度越界)。");
+    }
+}
+
+// ---------------------------------------------------------
+// 读取器
+// ---------------------------------------------------------
+
+ArchiveReader::ArchiveReader(const std::string& path, const Encryptor* encryptor, MappedFile::Access access)
+    : m_file(path, access), m_encryptor(encryptor) {
+    readArchiveFrame(m_file, m_encryptor, m_header, m_footer);
+}
+
+const std::vector<ChunkIndexEntry>& ArchiveReader::index() {
+    if (!m_indexLoaded) {
+        m_index = readChunkIndex(m_file, m_footer);
+        m_indexLoaded = true;
+    }
+    return m_index;
+}
+
+void ArchiveReader::checkIndex() {
+    const std::vector<ChunkIndexEntry>& entries = index();
+    uint64_t offset = ARCHIVE_HEADER_SIZE;
+    uint64_t rawOffset = 0;
+    for (uint64_t seq = 0; seq < entries.size(); ++seq) {
+        const ChunkIndexEntry& entry = entries[seq];
+        if (seq == m_footer.chunkCount) {
+            // 文件清单的 rawOffset 重新从 0 开始
+            if (rawOffset != m_footer.rawSize) throw std::runtime_error("备份文件索引损坏 (原始大小不符)。");
+            rawOffset = 0;
+        }
+        ChunkRecordHeader record;
+        record.rawSize = entry.rawSize;
+        record.storedSize = entry.storedSize;
+        checkRecordBounds(m_header, record);
+        if (entry.offset != offset || entry.rawOffset != rawOffset) {
+            throw std::runtime_error("备份文件索引损坏 (块 " + std::to_string(seq) + " 偏移不连续)。");
+        }
+        offset += CHUNK_RECORD_HEADER_SIZE + entry.storedSize;
+        rawOffset += entry.rawSize;
+    }
+    uint64_t expectedRaw = m_footer.manifestChunks ? m_footer.manifestSize : m_footer.rawSize;
+    if (offset != m_footer.indexOffset || rawOffset != expectedRaw) {
+        throw std::runtime_error("备份文件索引损坏 (与尾部不一致)。");
+    }
+}
+
+void ArchiveReader::readChunk(uint64_t seq, std::vector<uint8_t>& raw) {
+    const std::vector<ChunkIndexEntry>& entries = index();
+    if (seq >= entries.size()) {
+        throw std::runtime_error("数据块序号越界: " + std::to_string(seq));
+    }
+    const ChunkIndexEntry& entry = entries[seq];
+    size_t offset = entry.offset;
+    MappedChunk chunk = readMappedChunk(m_file, m_header, m_footer, seq, offset);
+    if (chunk.record.rawSize != entry.rawSize || chunk.record.storedSize != entry.storedSize ||
+        chunk.record.rawCrc != entry.rawCrc || chunk.record.storedCrc != entry.storedCrc) {
+        throw std::runtime_error("备份文件索引与数据块 " + std::to_string(seq) + " 不一致。");
+    }
+    raw = decodeChunk(m_header, m_encryptor, seq, chunk.record, chunk.stored);
+}
+
+bool ArchiveReader::next(std::vector<uint8_t>& raw) {
+    if (m_nextChunk >= m_footer.chunkCount) return false;
+
+    MappedChunk chunk = readMappedChunk(m_file, m_header, m_footer, m_nextChunk++, m_offset);
+    raw = decodeChunk(m_header, m_encryptor, chunk.seq, chunk.record, chunk.stored);
+    return true;
+}
+
+} // namespace Backup
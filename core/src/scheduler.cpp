@@ -1,4 +1,5 @@
 #include "scheduler.h"
+#include "scheduler_state.h"
 #include "traverser.h"
 #include <filesystem>
 #include <iostream>
@@ -6,39 +7,132 @@
 #include <chrono>
 #include <iomanip>
 #include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
 
 namespace fs = std::filesystem;
 
 namespace Backup {
 
-BackupScheduler::BackupScheduler() : m_running(false) {}
+// 没有事件监视器的实时任务的完整扫描间隔
+static const std::chrono::seconds POLL_INTERVAL(2);
+
+// 唤醒与派发本身的延迟不算晚点
+static const std::chrono::milliseconds LAG_GRACE(100);
+
+// 变化集合不完整时（需要完整备份）无需再记录路径
+void PendingChanges::noteChanged(const std::string& path) {
+    if (incomplete) return;
+    removed.erase(path);
+    changed.insert(path);
+}
+
+void PendingChanges::noteRemoved(const std::string& path) {
+    if (incomplete) return;
+    changed.erase(path);
+    removed.insert(path);
+}
+
+void PendingChanges::markIncomplete() {
+    incomplete = true;
+    changed.clear();
+    removed.clear();
+}
+
+void PendingChanges::merge(const PendingChanges& later) {
+    if (later.incomplete) markIncomplete();
+    for (const auto& path : later.changed) noteChanged(path);
+    for (const auto& path : later.removed) noteRemoved(path);
+}
+
+BackupScheduler::BackupScheduler(unsigned int maxConcurrent)
+    : m_running(false), m_maxConcurrent(std::max(1u, maxConcurrent)) {}
 
 BackupScheduler::~BackupScheduler() {
     stop();
+    // 监视器的回调引用本对象，必须在成员析构之前停止
+    for (auto& task : m_tasks) {
+        if (task->snapshot && task->snapshot->watcher) task->snapshot->watcher->stop();
+    }
 }
 
 void BackupScheduler::start() {
     if (m_running) return;
+    m_cancel = false;
     m_running = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        spawnWorkers();
+        m_stateDirty = true;    // 运行期间的状态文件不再标记为正常退出
+    }
+    flushState();
     m_thread = std::thread(&BackupScheduler::loop, this);
     std::cout << "[Scheduler] Started background service." << std::endl;
 }
 
 void BackupScheduler::stop() {
     if (!m_running) return;
-    m_running = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_cancel = true;    // 正在执行的备份尽快中止
+    }
     m_cv.notify_all();
     if (m_thread.joinable()) {
         m_thread.join();
     }
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) worker.join();
+    }
+    m_workers.clear();
+
+    // 尚未执行的备份撤销派发，变化留待下次启动
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_queue.empty()) {
+            finishJob(m_queue.front(), false, false);
+            m_queue.pop_front();
+        }
+        m_stateDirty = true;
+    }
+    flushState();
     std::cout << "[Scheduler] Stopped background service." << std::endl;
 }
 
+void BackupScheduler::setTaskResourcePolicy(int taskId, const ResourcePolicy& policy) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& task : m_tasks) {
+            if (task->id == taskId) {
+                task->resources = policy;
+                task->systemInstance.setResourcePolicy(policy);
+                m_stateDirty = true;
+                break;
+            }
+        }
+    }
+    flushState();
+}
+
+void BackupScheduler::setMaxConcurrentTasks(unsigned int maxConcurrent) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_maxConcurrent = std::max(1u, maxConcurrent);
+        if (m_running) spawnWorkers();
+    }
+    m_cv.notify_all();
+}
+
+void BackupScheduler::spawnWorkers() {
+    // 只增不减：多出的工作线程受 m_maxConcurrent 限制而空闲
+    while (m_workers.size() < m_maxConcurrent) {
+        m_workers.emplace_back(&BackupScheduler::workerLoop, this);
+    }
+}
+
 int BackupScheduler::addScheduledTask(const std::string& srcDir, const std::string& dstDir, 
                                       const std::string& prefix, int intervalSec, int maxKeep) {
-    std::lock_guard<std::mutex> lock(m_mutex);
     auto task = std::make_shared<BackupTask>();
-    task->id = m_nextId++;
     task->type = TaskType::SCHEDULED;
     task->srcDir = srcDir;
     task->dstDir = dstDir;
@@ -48,15 +142,23 @@ int BackupScheduler::addScheduledTask(const std::string& srcDir, const std::stri
     task->lastRunTime = 0;
     
     fs::create_directories(dstDir);
-    m_tasks.push_back(task);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        task->id = m_nextId++;
+        m_tasks.push_back(task);
+        scheduleAt(task, std::chrono::steady_clock::now()); // 首次立即运行
+        m_stateDirty = true;
+        m_wakeup = true;
+    }
+    m_cv.notify_all();
+    flushState();
     return task->id;
 }
 
 int BackupScheduler::addRealtimeTask(const std::string& srcDir, const std::string& dstDir, 
                                      const std::string& prefix, int maxKeep) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    // 建立基线可能需要遍历整棵目录树，不持有调度锁
     auto task = std::make_shared<BackupTask>();
-    task->id = m_nextId++;
     task->type = TaskType::REALTIME;
     task->srcDir = srcDir;
     task->dstDir = dstDir;
@@ -66,152 +168,852 @@ int BackupScheduler::addRealtimeTask(const std::string& srcDir, const std::strin
     
     fs::create_directories(dstDir);
 
-    Traverser t;
-    try {
-        auto files = t.traverse(srcDir);
-        for (const auto& f : files) {
-            task->fileSnapshot[f.relativePath] = f.lastModified;
-        }
-    } catch (...) {}
+    task->snapshot = acquireSnapshot(srcDir, dstDir, prefix, task->snapshotPrefix);
 
-    m_tasks.push_back(task);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        task->id = m_nextId++;
+        m_tasks.push_back(task);
+        m_realtimeTasks.push_back(task);
+        m_stateDirty = true;
+    }
+    flushState();
     return task->id;
 }
 
 void BackupScheduler::setTaskFilter(int taskId, const Filter& opts) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    for (auto& task : m_tasks) {
-        if (task->id == taskId) {
-            task->systemInstance.setFilter(opts);
-            task->filter = opts;
-            break;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& task : m_tasks) {
+            if (task->id == taskId) {
+                task->systemInstance.setFilter(opts);
+                task->filter = opts;
+                task->hasFilter = true;
+                m_stateDirty = true;
+                break;
+            }
         }
     }
+    flushState();
 }
 
 void BackupScheduler::setTaskPassword(int taskId, const std::string& pwd) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    for (auto& task : m_tasks) {
-        if (task->id == taskId) {
-            task->systemInstance.setPassword(pwd); // 设置该任务独立实例的密码
-            break;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& task : m_tasks) {
+            if (task->id == taskId) {
+                // 恢复的加密任务不能以空密码继续，否则会静默写出未加密的备份
+                if (task->awaitingPassword && pwd.empty()) {
+                    throw std::runtime_error("加密任务的密码不能为空。");
+                }
+                task->systemInstance.setPassword(pwd); // 设置该任务独立实例的密码
+                task->encrypted = !pwd.empty();
+                if (task->awaitingPassword) {
+                    // 恢复的加密任务从此开始执行，错过的定时运行立即补上
+                    task->awaitingPassword = false;
+                    if (task->type == TaskType::SCHEDULED) scheduleAt(task, task->nextRun);
+                    m_wakeup = true;
+                    m_cv.notify_all();
+                }
+                m_stateDirty = true;
+                break;
+            }
         }
     }
+    flushState();
 }
 
 // 设置任务压缩算法
 void BackupScheduler::setTaskCompressionAlgorithm(int taskId, int algo) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& task : m_tasks) {
+            if (task->id == taskId) {
+                task->systemInstance.setCompressionAlgorithm(algo);
+                task->compressionAlgo = algo;
+                m_stateDirty = true;
+                break;
+            }
+        }
+    }
+    flushState();
+}
+
+void BackupScheduler::setTaskDebounce(int taskId, const DebounceOptions& options) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& task : m_tasks) {
+            if (task->id == taskId) {
+                task->debounce = options;
+                m_stateDirty = true;
+                break;
+            }
+        }
+    }
+    flushState();
+}
+
+void BackupScheduler::setTaskDelta(int taskId, const DeltaOptions& options) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& task : m_tasks) {
+            if (task->id == taskId) {
+                task->delta = options;
+                m_stateDirty = true;
+                break;
+            }
+        }
+    }
+    flushState();
+}
+
+void BackupScheduler::setTaskOverlap(int taskId, const OverlapOptions& options) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& task : m_tasks) {
+            if (task->id == taskId) {
+                task->overlap = options;
+                m_stateDirty = true;
+                break;
+            }
+        }
+    }
+    flushState();
+}
+
+ScheduleStats BackupScheduler::scheduleStats(int taskId) {
     std::lock_guard<std::mutex> lock(m_mutex);
     for (auto& task : m_tasks) {
-        if (task->id == taskId) {
-            task->systemInstance.setCompressionAlgorithm(algo);
-            break;
+        if (task->id == taskId) return task->stats;
+    }
+    return ScheduleStats();
+}
+
+bool BackupScheduler::restoreTask(int taskId, time_t pointInTime, const std::string& restoreDir) {
+    std::shared_ptr<BackupTask> target;
+    BackupSystem system;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& task : m_tasks) {
+            if (task->id == taskId) {
+                target = task;
+                system = task->systemInstance;
+                break;
+            }
+        }
+    }
+    if (!target) return false;
+    std::vector<std::string> chain = backupChain(target->dstDir, target->filePrefix, pointInTime);
+    if (chain.empty()) return false;
+    return system.restoreChain(chain, restoreDir);
+}
+
+size_t BackupScheduler::loadState(const std::string& stateFile) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_tasks.empty()) {
+            throw std::runtime_error("已有任务时不能加载调度状态。");
         }
     }
+    SchedulerState state;
+    bool found = loadSchedulerState(stateFile, state);
+
+    // 建立快照可能需要遍历目录树，不持有调度锁
+    std::vector<std::shared_ptr<BackupTask>> restored;
+    for (const auto& saved : state.tasks) {
+        std::error_code ec;
+        fs::create_directories(saved.dstDir, ec);
+        auto task = taskFromState(saved, state.clean);
+        if (task->type == TaskType::REALTIME) {
+            // 索引丢失时重新建立的基线不含停机期间的变化，只能完整备份
+            if (!fs::exists(saved.indexPath)) task->needFull = true;
+            task->snapshot = acquireSnapshot(task->srcDir, task->dstDir, task->filePrefix, task->snapshotPrefix);
+        }
+        restored.push_back(task);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stateFile = stateFile;
+        m_nextId = std::max(m_nextId, state.nextId);
+        for (auto& task : restored) {
+            m_tasks.push_back(task);
+            if (task->type == TaskType::REALTIME) {
+                m_realtimeTasks.push_back(task);
+            } else if (!task->awaitingPassword) {
+                scheduleAt(task, task->nextRun);
+            }
+        }
+        m_stateDirty = true;
+        m_wakeup = true;
+    }
+    m_cv.notify_all();
+    flushState();
+    if (found) {
+        std::cout << "[Scheduler] Restored " << restored.size() << " tasks from: " << stateFile << std::endl;
+    }
+    return restored.size();
+}
+
+std::vector<TaskState> BackupScheduler::taskStates() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<TaskState> states;
+    states.reserve(m_tasks.size());
+    for (const auto& task : m_tasks) states.push_back(stateOf(*task));
+    return states;
+}
+
+TaskState BackupScheduler::stateOf(const BackupTask& task) const {
+    TaskState state;
+    state.id = task.id;
+    state.type = task.type;
+    state.srcDir = task.srcDir;
+    state.dstDir = task.dstDir;
+    state.filePrefix = task.filePrefix;
+    state.intervalSeconds = task.intervalSeconds;
+    state.maxBackups = task.maxBackups;
+    state.compressionAlgo = task.compressionAlgo;
+    state.encrypted = task.encrypted;
+    state.hasFilter = task.hasFilter;
+    state.filter = task.filter;
+    state.debounce = task.debounce;
+    state.delta = task.delta;
+    state.resources = task.resources;
+    state.overlap = task.overlap;
+    state.lastRunTime = task.lastRunTime;
+    state.lastArchive = task.lastArchive;
+
+    if (task.type == TaskType::SCHEDULED) {
+        // 单调时钟只在本进程内有意义，换算为墙上时钟保存
+        auto remaining = std::chrono::duration_cast<std::chrono::seconds>(task.nextRun - std::chrono::steady_clock::now());
+        state.nextRunTime = std::time(nullptr) + std::max<int64_t>(0, remaining.count());
+    } else {
+        state.indexPath = task.snapshot ? task.snapshot->index->path() : metadataIndexPath(task.dstDir, task.filePrefix);
+        // 正在执行的备份的变化不在 pending 中：这时写入的状态不会标记为正常退出，恢复时完整备份
+        state.pending = task.pending;
+        state.needFull = task.needFull;
+        state.deltasSinceFull = task.deltasSinceFull;
+    }
+    return state;
+}
+
+std::shared_ptr<BackupTask> BackupScheduler::taskFromState(const TaskState& state, bool clean) {
+    using namespace std::chrono;
+    auto task = std::make_shared<BackupTask>();
+    task->id = state.id;
+    task->type = state.type;
+    task->srcDir = state.srcDir;
+    task->dstDir = state.dstDir;
+    task->filePrefix = state.filePrefix;
+    task->intervalSeconds = state.intervalSeconds;
+    task->maxBackups = state.maxBackups;
+    task->lastRunTime = state.lastRunTime;
+    task->lastArchive = state.lastArchive;
+
+    task->compressionAlgo = state.compressionAlgo;
+    task->systemInstance.setCompressionAlgorithm(state.compressionAlgo);
+    task->resources = state.resources;
+    task->systemInstance.setResourcePolicy(state.resources);
+    task->hasFilter = state.hasFilter;
+    task->filter = state.filter;
+    if (state.hasFilter) task->systemInstance.setFilter(state.filter);
+    task->debounce = state.debounce;
+    task->delta = state.delta;
+    task->overlap = state.overlap;
+    task->encrypted = state.encrypted;
+    task->awaitingPassword = state.encrypted;
+
+    auto steadyNow = steady_clock::now();
+    time_t wallNow = std::time(nullptr);
+    if (state.lastRunTime > 0) task->lastRun = steadyNow - seconds(std::max<int64_t>(0, wallNow - state.lastRunTime));
+    // 停机期间错过的定时运行在启动后立即补上（只补一次）
+    task->nextRun = steadyNow + seconds(std::max<int64_t>(0, state.nextRunTime - wallNow));
+
+    if (task->type == TaskType::REALTIME) {
+        task->pending = state.pending;
+        task->needFull = state.needFull;
+        task->deltasSinceFull = state.deltasSinceFull;
+        // 异常退出时索引可能已记录了未保存的变化；上一次备份文件或完整备份缺失时增量链已断开
+        if (!clean || !hasFullBackup(task->dstDir, task->filePrefix) ||
+            (!task->lastArchive.empty() && !fs::exists(task->lastArchive))) {
+            task->needFull = true;
+        }
+        if (!task->pending.empty()) {
+            task->changePending = true;
+            task->firstChange = task->lastChange = steadyNow;
+        }
+    }
+    return task;
+}
+
+void BackupScheduler::flushState() {
+    // 写入串行化：后取得写锁的调用者复制的状态一定更新，文件不会被旧状态覆盖
+    std::lock_guard<std::mutex> writing(m_stateWriteMutex);
+    SchedulerState state;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stateFile.empty() || !m_stateDirty) return;
+        m_stateDirty = false;
+        path = m_stateFile;
+        state.nextId = m_nextId;
+        state.clean = !m_running;
+        for (const auto& task : m_tasks) state.tasks.push_back(stateOf(*task));
+    }
+    // 写入与 fsync 不持有调度锁，磁盘延迟不会阻塞调度线程与设置调用
+    try {
+        saveSchedulerState(path, state);
+    } catch (const std::exception& e) {
+        std::cerr << "[Scheduler] Failed to save state: " << e.what() << std::endl;
+    }
+}
+
+bool BackupScheduler::hasFullBackup(const std::string& dstDir, const std::string& prefix) {
+    std::vector<BackupFileEntry> backups = listBackups(dstDir, prefix);
+    return std::any_of(backups.begin(), backups.end(), [](const BackupFileEntry& b) { return !b.delta; });
+}
+
+std::chrono::steady_clock::time_point BackupScheduler::debounceDue(const BackupTask& task) {
+    using std::chrono::milliseconds;
+    // 平息时间与最长延迟取先到者，再满足最小间隔
+    auto due = std::min(task.lastChange + milliseconds(task.debounce.quietMs),
+                        task.firstChange + milliseconds(task.debounce.maxDelayMs));
+    return std::max(due, task.lastRun + milliseconds(task.debounce.minIntervalMs));
 }
 
 void BackupScheduler::loop() {
+    using Clock = std::chrono::steady_clock;
     while (m_running) {
+        std::vector<std::shared_ptr<BackupTask>> realtime;
         {
             std::lock_guard<std::mutex> lock(m_mutex);
-            time_t now = std::time(nullptr);
-
-            for (auto& task : m_tasks) {
-                bool shouldRun = false;
-
-                if (task->type == TaskType::SCHEDULED) {
-                    if (task->lastRunTime == 0 || (now - task->lastRunTime) >= task->intervalSeconds) {
-                        shouldRun = true;
-                    }
-                } 
-                else if (task->type == TaskType::REALTIME) {
-                    if (checkChanges(*task)) {
-                        shouldRun = true;
-                        std::cout << "[Scheduler] Detected changes in: " << task->srcDir << std::endl;
-                    }
+            m_wakeup = false;
+            realtime = m_realtimeTasks;
+        }
+
+        // 变化检测（可能是完整扫描）不持有调度锁；索引只由本线程访问。
+        // 每个共享快照只检测一次：有监视器时只处理事件报告的路径，否则按扫描间隔做完整扫描
+        auto detectAt = Clock::now();
+        std::map<SourceSnapshot*, PendingChanges> bySnapshot;
+        for (const auto& task : realtime) {
+            SourceSnapshot& snapshot = *task->snapshot;
+            if (bySnapshot.count(&snapshot) || !m_running) continue;
+            PendingChanges& found = bySnapshot[&snapshot];
+            if (snapshot.rescan) {
+                // 加载的索引：完整扫描一次以发现停机期间的变化，此前的事件已包含在扫描结果中
+                if (snapshot.watched()) snapshot.watcher->takeChanges();
+                checkChanges(snapshot, found);
+                snapshot.rescan = false;
+                snapshot.nextPoll = detectAt + POLL_INTERVAL;
+            } else if (snapshot.watched()) {
+                applyWatchedChanges(snapshot, found);
+            } else if (snapshot.nextPoll <= detectAt) {
+                checkChanges(snapshot, found);
+                snapshot.nextPoll = detectAt + POLL_INTERVAL;
+            }
+        }
+        std::vector<PendingChanges> detected(realtime.size());
+        std::vector<bool> changed(realtime.size(), false);
+        for (size_t i = 0; i < realtime.size(); ++i) {
+            auto found = bySnapshot.find(realtime[i]->snapshot.get());
+            if (found == bySnapshot.end()) continue;
+            changed[i] = projectChanges(found->second, realtime[i]->snapshotPrefix, detected[i]);
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto now = Clock::now();
+        auto wakeAt = Clock::time_point::max();
+        bool dispatched = false;
+
+        // 索引已经更新，检测到的变化先记入任务，停止时随状态保存，不会丢失
+        for (size_t i = 0; i < realtime.size(); ++i) {
+            auto& task = realtime[i];
+            task->pending.merge(detected[i]);
+            if (changed[i]) {
+                if (!task->changePending) {
+                    task->changePending = true;
+                    task->firstChange = now;
+                    std::cout << "[Scheduler] Detected changes in: " << task->srcDir << std::endl;
                 }
+                task->lastChange = now;
+            }
+        }
+        if (!m_running) break;
 
-                if (shouldRun) {
-                    performBackup(*task);
-                    task->lastRunTime = std::time(nullptr); 
+        for (auto& task : realtime) {
+            // 变化合并：到期才备份，否则把到期时间作为下一次唤醒时间；
+            // 上一次备份仍在执行时保持待备份状态，执行完毕后再派发
+            if (task->changePending && !task->running && !task->awaitingPassword) {
+                auto due = debounceDue(*task);
+                if (due <= now) {
+                    task->changePending = false;
+                    task->running = true;
+                    m_queue.push_back(makeJob(task));
+                    dispatched = true;
+                } else {
+                    wakeAt = std::min(wakeAt, due);
                 }
             }
+            if (!task->snapshot->watched()) wakeAt = std::min(wakeAt, task->snapshot->nextPoll);
+        }
+
+        // 定时任务：取出所有到期的定时器，作废的条目直接丢弃
+        while (!m_timers.empty() && m_timers.top().due <= now) {
+            TimerEntry entry = m_timers.top();
+            m_timers.pop();
+            if (entry.seq != entry.task->timerSeq || entry.task->running) continue;
+            entry.task->running = true;
+            m_queue.push_back(makeJob(entry.task));
+            dispatched = true;
+        }
+        if (!m_timers.empty()) wakeAt = std::min(wakeAt, m_timers.top().due);
+        if (dispatched) m_cv.notify_all();
+
+        // 精确睡眠到最早的到期时间；没有任何到期时间时只等待事件
+        auto woken = [this] { return !m_running || m_wakeup; };
+        if (wakeAt == Clock::time_point::max()) {
+            m_cv.wait(lock, woken);
+        } else {
+            m_cv.wait_until(lock, wakeAt, woken);
         }
-        std::unique_lock<std::mutex> waitLock(m_mutex);
-        m_cv.wait_for(waitLock, std::chrono::seconds(2), [this] { return !m_running; });
     }
 }
 
-bool BackupScheduler::checkChanges(BackupTask& task) {
-    Traverser t;
-    std::vector<FileInfo> currentFiles;
-    try {
-        currentFiles = t.traverse(task.srcDir);
-    } catch (...) { return false; }
+void BackupScheduler::scheduleAt(const std::shared_ptr<BackupTask>& task, std::chrono::steady_clock::time_point due) {
+    task->nextRun = due;
+    m_timers.push({due, ++task->timerSeq, task});
+}
 
-    bool changed = false;
-    std::map<std::string, time_t> newSnapshot;
+std::chrono::steady_clock::duration BackupScheduler::lagTolerance(const OverlapOptions& overlap) {
+    return std::chrono::seconds(std::max(0, overlap.maxLagSeconds)) + LAG_GRACE;
+}
+
+std::chrono::steady_clock::time_point BackupScheduler::nextScheduledRun(BackupTask& task, std::chrono::steady_clock::time_point now) {
+    return nextScheduledRun(task.nextRun, now, task.intervalSeconds, task.overlap, task.stats.skippedRuns);
+}
 
-    for (const auto& f : currentFiles) {
-        if (f.type == FileType::DIRECTORY) continue;
-        newSnapshot[f.relativePath] = f.lastModified;
+std::chrono::steady_clock::time_point BackupScheduler::nextScheduledRun(std::chrono::steady_clock::time_point scheduled,
+                                                                        std::chrono::steady_clock::time_point now,
+                                                                        int intervalSeconds, const OverlapOptions& overlap,
+                                                                        uint64_t& skipped) {
+    auto interval = std::chrono::steady_clock::duration(std::chrono::seconds(std::max(1, intervalSeconds)));
+    auto next = scheduled + interval;
+    if (next >= now) return next;
 
-        auto it = task.fileSnapshot.find(f.relativePath);
-        if (it == task.fileSnapshot.end() || it->second != f.lastModified) {
-            changed = true; 
+    // 已经落后：late 为第一个错过的时间点至今的延迟
+    auto late = now - next;
+    auto tolerance = lagTolerance(overlap);
+    int64_t skip = 0;
+    switch (overlap.policy) {
+    case OverlapPolicy::COALESCE:
+        // 运行超时错过的时间点全部合并，等待网格上的下一个时间点，不会紧接着再次运行
+        skip = late / interval + 1;
+        break;
+    case OverlapPolicy::SKIP_IF_LATE:
+        // 只保留最近一个已到期的时间点，仍在最大延迟之内才运行，否则等待下一个
+        skip = late / interval;
+        if (late - skip * interval > tolerance) ++skip;
+        break;
+    case OverlapPolicy::QUEUE:
+        // 逐个补跑，只丢弃落后超过最大延迟的时间点
+        if (late > tolerance) skip = (late - tolerance + interval - std::chrono::steady_clock::duration(1)) / interval;
+        break;
+    }
+    skipped += static_cast<uint64_t>(skip);
+    return next + skip * interval;
+}
+
+void BackupScheduler::notifyWakeup() {
+    // 在锁内置位，避免调度线程检查条件之后、开始等待之前的通知丢失
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wakeup = true;
+    }
+    m_cv.notify_all();
+}
+
+BackupScheduler::BackupJob BackupScheduler::makeJob(const std::shared_ptr<BackupTask>& task) {
+    BackupJob job;
+    job.task = task;
+    job.system = task->systemInstance;
+    job.system.setCancelFlag(&m_cancel);
+    job.resources = task->resources;
+    job.due = task->nextRun;
+
+    // 实时任务在变化集合完整时只备份变化的部分，并定期做完整备份
+    BackupTask& t = *task;
+    if (t.pending.incomplete) t.needFull = true;
+    job.delta = t.type == TaskType::REALTIME && t.delta.enabled && !t.needFull &&
+                (t.delta.fullEvery <= 0 || t.deltasSinceFull < t.delta.fullEvery);
+    if (job.delta) {
+        ++t.deltasSinceFull;
+    } else {
+        t.deltasSinceFull = 0;
+        t.needFull = false;
+    }
+    // 派发之后的变化记入新的集合，留给下一次备份
+    job.changes = std::move(t.pending);
+    t.pending = PendingChanges();
+    return job;
+}
+
+void BackupScheduler::finishJob(BackupJob& job, bool success, bool ran) {
+    BackupTask& task = *job.task;
+    task.running = false;
+    if (ran) {
+        task.lastRunTime = std::time(nullptr);
+        task.lastRun = std::chrono::steady_clock::now();
+    }
+    // 定时任务按固定频率推进（不累积执行时间造成的漂移），落后时按重叠策略处理；
+    // 未执行的保持原到期时间
+    if (task.type == TaskType::SCHEDULED) {
+        scheduleAt(job.task, ran ? nextScheduledRun(task, std::chrono::steady_clock::now()) : task.nextRun);
+    }
+    if (success) {
+        task.lastArchive = job.archive;
+        m_stateDirty = true;
+        return;
+    }
+
+    // 失败时撤销派发：本次的变化与之后的变化合并，完整备份失败则下次仍需完整备份
+    if (job.delta) {
+        --task.deltasSinceFull;
+    } else {
+        task.needFull = true;
+    }
+    job.changes.merge(task.pending);
+    task.pending = std::move(job.changes);
+    if (task.type == TaskType::REALTIME && !task.changePending) {
+        task.changePending = true;
+        task.firstChange = task.lastChange = std::chrono::steady_clock::now();
+    }
+    m_stateDirty = true;
+}
+
+void BackupScheduler::workerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this] { return !m_running || (!m_queue.empty() && m_activeJobs < m_maxConcurrent); });
+        if (!m_running) break;
+        BackupJob job = std::move(m_queue.front());
+        m_queue.pop_front();
+
+        // 定时任务的调度延迟：在队列中等待工作线程的时间也计入；
+        // 按策略已经太晚的运行不再执行，直接推进到下一个时间点
+        if (job.task->type == TaskType::SCHEDULED) {
+            BackupTask& task = *job.task;
+            auto now = std::chrono::steady_clock::now();
+            auto lag = now - job.due;
+            if (task.overlap.policy != OverlapPolicy::COALESCE && lag > lagTolerance(task.overlap)) {
+                task.running = false;
+                ++task.stats.skippedRuns;
+                std::cout << "[Scheduler] Skipping late run of task " << task.id << " ("
+                          << std::chrono::duration_cast<std::chrono::milliseconds>(lag).count() << " ms behind)" << std::endl;
+                scheduleAt(job.task, nextScheduledRun(task, now));
+                m_wakeup = true;
+                m_cv.notify_all();
+                continue;
+            }
+            task.stats.lastLagMs = std::chrono::duration_cast<std::chrono::milliseconds>(lag).count();
+            task.stats.maxLagMs = std::max(task.stats.maxLagMs, task.stats.lastLagMs);
+            ++task.stats.runs;
         }
+        ++m_activeJobs;
+
+        // 执行期间不持有调度锁
+        lock.unlock();
+        bool success = performBackup(job);
+        lock.lock();
+
+        // 被 stop() 取消的运行不计入运行时间
+        finishJob(job, success, success || !m_cancel);
+        --m_activeJobs;
+        m_wakeup = true;
+        m_cv.notify_all();
+
+        lock.unlock();
+        flushState();
+        lock.lock();
+    }
+}
+
+std::shared_ptr<SourceSnapshot> BackupScheduler::acquireSnapshot(const std::string& srcDir, const std::string& dstDir,
+                                                                 const std::string& prefix, std::string& snapshotPrefix) {
+    std::lock_guard<std::mutex> creating(m_snapshotMutex);
+    std::error_code ec;
+    fs::path root = fs::weakly_canonical(srcDir, ec);
+    if (ec) root = fs::absolute(srcDir);
+
+    // 已有快照覆盖同一目录或其上级目录时直接引用
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_snapshots.begin(); it != m_snapshots.end();) {
+            auto snapshot = it->second.lock();
+            if (!snapshot) {
+                it = m_snapshots.erase(it);
+                continue;
+            }
+            fs::path relative = root.lexically_relative(snapshot->root);
+            if (!relative.empty() && *relative.begin() != "..") {
+                snapshotPrefix = (relative == ".") ? std::string() : relative.generic_string();
+                std::cout << "[Scheduler] Sharing snapshot of " << snapshot->root << " for: " << srcDir << std::endl;
+                return snapshot;
+            }
+            ++it;
+        }
+    }
+
+    auto snapshot = std::make_shared<SourceSnapshot>();
+    snapshot->root = root.string();
+    snapshotPrefix.clear();
+
+    // 先建立监视再建立基线，期间的变化不会丢失
+    if (ChangeWatcher::supported()) {
+        snapshot->watcher = std::make_unique<ChangeWatcher>(snapshot->root, [this] { notifyWakeup(); });
+        if (!snapshot->watcher->start()) snapshot->watcher.reset();
+    }
+
+    // 已有索引（上次运行留下的）直接使用，下一次 checkChanges 会发现停机期间的变化；
+    // 否则遍历一次建立基线
+    snapshot->index = openMetadataIndex(dstDir, prefix);
+    snapshot->rescan = !snapshot->index->empty();
+    if (snapshot->index->empty()) {
+        TraverseOptions options;
+        options.statDirectories = false; // 变化检测只比较文件的元数据
+        options.resolveNames = false;
+        Traverser t(options);
+        try {
+            MetadataIndex& index = *snapshot->index;
+            index.beginScan();
+            t.traverse(snapshot->root, [&index](FileInfo& f) {
+                if (f.type == FileType::DIRECTORY) return; // 与 checkChanges 保持一致
+                index.update(f.relativePath, MetadataIndex::recordOf(f));
+            });
+            index.endScan();
+            index.sync();
+        } catch (...) {}
+    } else {
+        std::cout << "[Scheduler] Loaded metadata index with " << snapshot->index->size()
+                  << " entries for: " << srcDir << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_snapshots[snapshot->root] = snapshot;
+    return snapshot;
+}
+
+bool BackupScheduler::projectChanges(const PendingChanges& changes, const std::string& prefix, PendingChanges& out) {
+    if (prefix.empty()) {
+        out.merge(changes);
+        return !changes.empty();
+    }
+    // 只保留任务源目录之下的路径，并改为相对任务源目录
+    bool any = false;
+    if (changes.incomplete) {
+        out.markIncomplete();
+        any = true;
+    }
+    const std::string head = prefix + "/";
+    for (const auto& path : changes.changed) {
+        if (path.compare(0, head.size(), head) != 0) continue;
+        out.noteChanged(path.substr(head.size()));
+        any = true;
     }
+    for (const auto& path : changes.removed) {
+        if (path.compare(0, head.size(), head) != 0) continue;
+        out.noteRemoved(path.substr(head.size()));
+        any = true;
+    }
+    return any;
+}
+
+bool BackupScheduler::checkChanges(SourceSnapshot& snapshot, PendingChanges& changes) {
+    TraverseOptions options;
+    options.statDirectories = false; // 目录不参与比较，无需 stat
+    options.resolveNames = false;    // 也不需要用户名/组名
+    Traverser t(options);
+    MetadataIndex& index = *snapshot.index;
 
-    if (!changed && task.fileSnapshot.size() != newSnapshot.size()) {
+    // 边遍历边与索引比较并就地更新，本轮未出现的记录即为已删除的文件
+    bool changed = false;
+    index.beginScan();
+    try {
+        t.traverse(snapshot.root, [&](FileInfo& f) {
+            if (f.type == FileType::DIRECTORY) return;
+            if (index.update(f.relativePath, MetadataIndex::recordOf(f))) {
+                changes.noteChanged(f.relativePath);
+                changed = true;
+            }
+        });
+    } catch (...) {
+        // 遍历不完整时不能据此判定删除；已更新的记录保持
+        return changed;
+    }
+    // 索引只保存路径哈希，删除的文件无法得到路径，只能以完整备份记录
+    if (index.endScan() > 0) {
+        changes.markIncomplete();
         changed = true;
     }
 
-    if (changed) task.fileSnapshot = std::move(newSnapshot);
+    if (changed) index.sync();
+    return changed;
+}
+
+bool BackupScheduler::applyWatchedChanges(SourceSnapshot& snapshot, PendingChanges& pending) {
+    ChangeSet changes = snapshot.watcher->takeChanges();
+    if (changes.empty()) return false;
+    if (changes.rescan) return checkChanges(snapshot, pending);
+
+    // 只 lstat 变化的路径并更新索引，目录不参与比较
+    MetadataIndex& index = *snapshot.index;
+    bool changed = false;
+    for (const auto& path : changes.paths) {
+        struct stat fileStat;
+        if (lstat((fs::path(snapshot.root) / path).c_str(), &fileStat) != 0) {
+            if (index.remove(path)) {
+                pending.noteRemoved(path);
+                changed = true;
+            }
+        } else if (!S_ISDIR(fileStat.st_mode)) {
+            if (index.update(path, MetadataIndex::recordOf(fileStat))) {
+                pending.noteChanged(path);
+                changed = true;
+            }
+        }
+    }
+    if (changed) index.sync();
     return changed;
 }
 
-std::string BackupScheduler::generateFileName(const std::string& dir, const std::string& prefix) {
+std::string BackupScheduler::metadataIndexPath(const std::string& dstDir, const std::string& prefix) {
+    return (fs::path(dstDir) / ("." + prefix + ".index")).string();
+}
+
+std::unique_ptr<MetadataIndex> BackupScheduler::openMetadataIndex(const std::string& dstDir, const std::string& prefix) {
+    std::string path = metadataIndexPath(dstDir, prefix);
+    try {
+        return std::make_unique<MetadataIndex>(path);
+    } catch (const std::exception& e) {
+        // 索引只是缓存：损坏时丢弃重建
+        std::cerr << "[Scheduler] Discarding metadata index: " << e.what() << std::endl;
+        fs::remove(path);
+        return std::make_unique<MetadataIndex>(path);
+    }
+}
+
+std::string BackupScheduler::generateFileName(const std::string& dir, const std::string& prefix, bool delta) {
     auto now = std::chrono::system_clock::now();
     auto in_time_t = std::chrono::system_clock::to_time_t(now);
     std::stringstream ss;
     ss << dir << "/" << prefix << "_";
     ss << std::put_time(std::localtime(&in_time_t), "%Y%m%d_%H%M%S");
-    ss << ".bin";
-    return ss.str();
+    std::string base = ss.str();
+    const char* ext = delta ? ".delta.bin" : ".bin";
+
+    // 同一秒内的多次备份追加序号
+    std::string name = base + ext;
+    for (int counter = 1; fs::exists(name); ++counter) {
+        name = base + "_" + std::to_string(counter) + ext;
+    }
+    return name;
 }
 
-void BackupScheduler::performBackup(BackupTask& task) {
-    std::string dstFile = generateFileName(task.dstDir, task.filePrefix);
+bool BackupScheduler::performBackup(BackupJob& job) {
+    const BackupTask& task = *job.task;
+    std::string dstFile = generateFileName(task.dstDir, task.filePrefix, job.delta);
+    job.archive = dstFile;
     std::cout << "[Scheduler] Running task " << task.id << ": " << dstFile << std::endl;
-    
-    bool success = task.systemInstance.backup(task.srcDir, dstFile);
+
+    bool success = false;
+    auto run = [&] {
+        try {
+            if (job.delta) {
+                std::vector<std::string> changed(job.changes.changed.begin(), job.changes.changed.end());
+                std::vector<std::string> removed(job.changes.removed.begin(), job.changes.removed.end());
+                success = job.system.backupDelta(task.srcDir, changed, removed, dstFile);
+            } else {
+                success = job.system.backup(task.srcDir, dstFile);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "[Scheduler] Task " << task.id << " failed: " << e.what() << std::endl;
+        }
+    };
+    if (job.resources.changesPriority()) {
+        // 降低的 nice 值无法调回：在专用线程中降低优先级后执行，流水线线程继承该优先级，
+        // 工作线程本身不受影响
+        std::thread runner([&] {
+            Throttle::applyThreadPriority(job.resources);
+            run();
+        });
+        runner.join();
+    } else {
+        run();
+    }
+    // 失败时由调用者保留变化集合，下一次一起备份
     if (success) pruneOldBackups(task);
+    return success;
 }
 
-void BackupScheduler::pruneOldBackups(const BackupTask& task) {
-    if (task.maxBackups <= 0) return;
-    std::vector<fs::path> backups;
+std::vector<BackupFileEntry> BackupScheduler::listBackups(const std::string& dstDir, const std::string& prefix) {
+    std::vector<std::pair<int64_t, BackupFileEntry>> found;
+    const std::string head = prefix + "_";
     try {
-        for (const auto& entry : fs::directory_iterator(task.dstDir)) {
-            if (entry.is_regular_file()) {
-                std::string fname = entry.path().filename().string();
-                if (fname.find(task.filePrefix) == 0 && fname.rfind(".bin") == fname.length() - 4) {
-                    backups.push_back(entry.path());
-                }
-            }
+        for (const auto& entry : fs::directory_iterator(dstDir)) {
+            if (!entry.is_regular_file()) continue;
+            std::string fname = entry.path().filename().string();
+            if (fname.compare(0, head.size(), head) != 0 || fname.size() < 4 ||
+                fname.compare(fname.size() - 4, 4, ".bin") != 0) continue;
+            struct stat fileStat;
+            if (stat(entry.path().c_str(), &fileStat) != 0) continue;
+
+            BackupFileEntry backup;
+            backup.path = entry.path().string();
+            backup.time = fileStat.st_mtime;
+            backup.delta = fname.size() > 10 && fname.compare(fname.size() - 10, 10, ".delta.bin") == 0;
+            MetadataRecord record = MetadataIndex::recordOf(fileStat);
+            found.emplace_back(record.mtimeNs, std::move(backup));
         }
-    } catch (...) { return; }
+    } catch (...) {}
 
-    std::sort(backups.begin(), backups.end(), [](const fs::path& a, const fs::path& b) {
-        return fs::last_write_time(a) < fs::last_write_time(b);
+    // 按纳秒级写入时间排序，同一秒内的增量备份也能保持先后顺序
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first < b.first : a.second.path < b.second.path;
     });
+    std::vector<BackupFileEntry> backups;
+    backups.reserve(found.size());
+    for (auto& item : found) backups.push_back(std::move(item.second));
+    return backups;
+}
+
+std::vector<std::string> BackupScheduler::backupChain(const std::string& dstDir, const std::string& prefix, time_t pointInTime) {
+    std::vector<BackupFileEntry> backups = listBackups(dstDir, prefix);
+    if (pointInTime != 0) {
+        backups.erase(std::remove_if(backups.begin(), backups.end(),
+                                     [pointInTime](const BackupFileEntry& b) { return b.time > pointInTime; }),
+                      backups.end());
+    }
+    auto full = std::find_if(backups.rbegin(), backups.rend(), [](const BackupFileEntry& b) { return !b.delta; });
+    std::vector<std::string> chain;
+    if (full == backups.rend()) return chain;
+    for (auto it = full.base() - 1; it != backups.end(); ++it) chain.push_back(it->path);
+    return chain;
+}
+
+void BackupScheduler::pruneOldBackups(const BackupTask& task) {
+    if (task.maxBackups <= 0) return;
+    std::vector<BackupFileEntry> backups = listBackups(task.dstDir, task.filePrefix);
 
-    if (backups.size() > (size_t)task.maxBackups) {
-        size_t removeCount = backups.size() - task.maxBackups;
-        for (size_t i = 0; i < removeCount; ++i) {
-            std::cout << "[Scheduler] Pruning old backup: " << backups[i] << std::endl;
-            fs::remove(backups[i]);
+    // 按完整备份计数；删除完整备份时，依赖它的增量备份一并删除
+    size_t fulls = std::count_if(backups.begin(), backups.end(), [](const BackupFileEntry& b) { return !b.delta; });
+    if (fulls <= (size_t)task.maxBackups) return;
+    size_t removeFulls = fulls - task.maxBackups;
+    for (const auto& backup : backups) {
+        if (!backup.delta) {
+            if (removeFulls == 0) break;
+            --removeFulls;
         }
+        std::cout << "[Scheduler] Pruning old backup: " << backup.path << std::endl;
+        fs::remove(backup.path);
     }
 }
 
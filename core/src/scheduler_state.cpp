@@ -0,0 +1,281 @@
+#include "scheduler_state.h"
+#include "archive_format.h"
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Backup {
+
+static const char STATE_MAGIC[4] = {'F', 'B', 'K', 'S'};
+static const uint32_t STATE_VERSION = 2;     // 版本 1 没有重叠策略
+
+namespace {
+
+// 小端序写入，字符串为 len(4) + 字节
+class StateWriter {
+public:
+    void u8(uint8_t value) { m_out.push_back(value); }
+    void u32(uint32_t value) { put(value, 4); }
+    void u64(uint64_t value) { put(value, 8); }
+    void i64(int64_t value) { put(static_cast<uint64_t>(value), 8); }
+    void f64(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put(bits, 8);
+    }
+    void str(const std::string& value) {
+        u32(static_cast<uint32_t>(value.size()));
+        m_out.insert(m_out.end(), value.begin(), value.end());
+    }
+    template <typename Container>
+    void strings(const Container& values) {
+        u32(static_cast<uint32_t>(values.size()));
+        for (const auto& value : values) str(value);
+    }
+    std::vector<uint8_t>& data() { return m_out; }
+
+private:
+    void put(uint64_t value, size_t bytes) {
+        for (size_t i = 0; i < bytes; ++i) m_out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+
+    std::vector<uint8_t> m_out;
+};
+
+class StateReader {
+public:
+    StateReader(const uint8_t* in, size_t len) : m_in(in), m_len(len) {}
+
+    uint8_t u8() { return static_cast<uint8_t>(get(1)); }
+    uint32_t u32() { return static_cast<uint32_t>(get(4)); }
+    uint64_t u64() { return get(8); }
+    int64_t i64() { return static_cast<int64_t>(get(8)); }
+    double f64() {
+        uint64_t bits = get(8);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    std::string str() {
+        uint32_t len = u32();
+        need(len);
+        std::string value(reinterpret_cast<const char*>(m_in + m_pos), len);
+        m_pos += len;
+        return value;
+    }
+    std::vector<std::string> strings() {
+        uint32_t count = u32();
+        std::vector<std::string> values;
+        for (uint32_t i = 0; i < count; ++i) values.push_back(str());
+        return values;
+    }
+    bool done() const { return m_pos == m_len; }
+
+private:
+    void need(size_t n) {
+        if (n > m_len - m_pos) throw std::runtime_error("调度状态损坏 (长度越界)。");
+    }
+    uint64_t get(size_t bytes) {
+        need(bytes);
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(m_in[m_pos + i]) << (i * 8);
+        m_pos += bytes;
+        return value;
+    }
+
+    const uint8_t* m_in;
+    size_t m_len;
+    size_t m_pos = 0;
+};
+
+} // namespace
+
+// 布局: magic(4) version(4) nextId(4) clean(1) taskCount(4) 任务... crc32(4)
+std::vector<uint8_t> encodeSchedulerState(const SchedulerState& state) {
+    StateWriter w;
+    for (char c : STATE_MAGIC) w.u8(static_cast<uint8_t>(c));
+    w.u32(STATE_VERSION);
+    w.u32(static_cast<uint32_t>(state.nextId));
+    w.u8(state.clean ? 1 : 0);
+    w.u32(static_cast<uint32_t>(state.tasks.size()));
+
+    for (const auto& task : state.tasks) {
+        w.u32(static_cast<uint32_t>(task.id));
+        w.u8(static_cast<uint8_t>(task.type));
+        w.str(task.srcDir);
+        w.str(task.dstDir);
+        w.str(task.filePrefix);
+        w.u32(static_cast<uint32_t>(task.intervalSeconds));
+        w.u32(static_cast<uint32_t>(task.maxBackups));
+        w.u32(static_cast<uint32_t>(task.compressionAlgo));
+        w.u8(task.encrypted ? 1 : 0);
+
+        w.u8(task.hasFilter ? 1 : 0);
+        const Filter& f = task.filter;
+        w.u8(f.enabled ? 1 : 0);
+        w.strings(f.nameKeywords);
+        w.str(f.nameRegex);
+        w.strings(f.suffixes);
+        w.u64(f.minSize);
+        w.u64(f.maxSize);
+        w.i64(f.startTime);
+        w.i64(f.endTime);
+        w.str(f.userName);
+        w.strings(f.excludePatterns);
+
+        w.u32(static_cast<uint32_t>(task.debounce.quietMs));
+        w.u32(static_cast<uint32_t>(task.debounce.maxDelayMs));
+        w.u32(static_cast<uint32_t>(task.debounce.minIntervalMs));
+        w.u8(task.delta.enabled ? 1 : 0);
+        w.u32(static_cast<uint32_t>(task.delta.fullEvery));
+
+        const ResourcePolicy& r = task.resources;
+        w.u32(r.maxThreads);
+        w.u64(r.ioBytesPerSec);
+        w.u8(r.ioIdle ? 1 : 0);
+        w.u32(static_cast<uint32_t>(r.niceLevel));
+        w.f64(r.maxLoadPerCpu);
+        w.f64(r.maxPressure);
+        w.u32(static_cast<uint32_t>(r.maxPauseSeconds));
+        w.u8(static_cast<uint8_t>(task.overlap.policy));
+        w.u32(static_cast<uint32_t>(task.overlap.maxLagSeconds));
+
+        w.i64(task.lastRunTime);
+        w.i64(task.nextRunTime);
+        w.str(task.lastArchive);
+        w.str(task.indexPath);
+        w.u8(task.pending.incomplete ? 1 : 0);
+        w.strings(task.pending.changed);
+        w.strings(task.pending.removed);
+        w.u8(task.needFull ? 1 : 0);
+        w.u32(static_cast<uint32_t>(task.deltasSinceFull));
+    }
+
+    uint32_t crc = crc32(w.data().data(), w.data().size());
+    w.u32(crc);
+    return std::move(w.data());
+}
+
+SchedulerState decodeSchedulerState(const uint8_t* in, size_t len) {
+    if (len < 8 || std::memcmp(in, STATE_MAGIC, 4) != 0) {
+        throw std::runtime_error("调度状态损坏 (魔数错误)。");
+    }
+    StateReader crcReader(in + len - 4, 4);
+    if (crcReader.u32() != crc32(in, len - 4)) {
+        throw std::runtime_error("调度状态损坏 (校验失败)。");
+    }
+
+    StateReader r(in + 4, len - 8);
+    uint32_t version = r.u32();
+    if (version < 1 || version > STATE_VERSION) {
+        throw std::runtime_error("调度状态版本不兼容。");
+    }
+    SchedulerState state;
+    state.nextId = static_cast<int>(r.u32());
+    state.clean = r.u8() != 0;
+    uint32_t count = r.u32();
+
+    for (uint32_t i = 0; i < count; ++i) {
+        TaskState task;
+        task.id = static_cast<int>(r.u32());
+        uint8_t type = r.u8();
+        if (type > static_cast<uint8_t>(TaskType::REALTIME)) {
+            throw std::runtime_error("调度状态损坏 (任务类型错误)。");
+        }
+        task.type = static_cast<TaskType>(type);
+        task.srcDir = r.str();
+        task.dstDir = r.str();
+        task.filePrefix = r.str();
+        task.intervalSeconds = static_cast<int>(r.u32());
+        task.maxBackups = static_cast<int>(r.u32());
+        task.compressionAlgo = static_cast<int>(r.u32());
+        task.encrypted = r.u8() != 0;
+
+        task.hasFilter = r.u8() != 0;
+        Filter& f = task.filter;
+        f.enabled = r.u8() != 0;
+        f.nameKeywords = r.strings();
+        f.nameRegex = r.str();
+        f.suffixes = r.strings();
+        f.minSize = r.u64();
+        f.maxSize = r.u64();
+        f.startTime = static_cast<time_t>(r.i64());
+        f.endTime = static_cast<time_t>(r.i64());
+        f.userName = r.str();
+        f.excludePatterns = r.strings();
+
+        task.debounce.quietMs = static_cast<int>(r.u32());
+        task.debounce.maxDelayMs = static_cast<int>(r.u32());
+        task.debounce.minIntervalMs = static_cast<int>(r.u32());
+        task.delta.enabled = r.u8() != 0;
+        task.delta.fullEvery = static_cast<int>(r.u32());
+
+        ResourcePolicy& res = task.resources;
+        res.maxThreads = r.u32();
+        res.ioBytesPerSec = r.u64();
+        res.ioIdle = r.u8() != 0;
+        res.niceLevel = static_cast<int>(r.u32());
+        res.maxLoadPerCpu = r.f64();
+        res.maxPressure = r.f64();
+        res.maxPauseSeconds = static_cast<int>(r.u32());
+        if (version >= 2) {
+            uint8_t policy = r.u8();
+            if (policy > static_cast<uint8_t>(OverlapPolicy::QUEUE)) {
+                throw std::runtime_error("调度状态损坏 (重叠策略错误)。");
+            }
+            task.overlap.policy = static_cast<OverlapPolicy>(policy);
+            task.overlap.maxLagSeconds = static_cast<int>(r.u32());
+        }
+
+        task.lastRunTime = static_cast<time_t>(r.i64());
+        task.nextRunTime = static_cast<time_t>(r.i64());
+        task.lastArchive = r.str();
+        task.indexPath = r.str();
+        task.pending.incomplete = r.u8() != 0;
+        for (auto& path : r.strings()) task.pending.changed.insert(std::move(path));
+        for (auto& path : r.strings()) task.pending.removed.insert(std::move(path));
+        task.needFull = r.u8() != 0;
+        task.deltasSinceFull = static_cast<int>(r.u32());
+        state.tasks.push_back(std::move(task));
+    }
+    if (!r.done()) {
+        throw std::runtime_error("调度状态损坏 (多余数据)。");
+    }
+    return state;
+}
+
+void saveSchedulerState(const std::string& path, const SchedulerState& state) {
+    std::vector<uint8_t> data = encodeSchedulerState(state);
+    std::string tmpPath = path + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        throw std::runtime_error("无法写入调度状态: " + path);
+    }
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n <= 0) break;
+        written += static_cast<size_t>(n);
+    }
+    // 先落盘再替换：任何时刻崩溃，状态文件要么是旧版本要么是新版本
+    bool ok = written == data.size() && fsync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        throw std::runtime_error("无法写入调度状态: " + path);
+    }
+}
+
+bool loadSchedulerState(const std::string& path, SchedulerState& state) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    state = decodeSchedulerState(data.data(), data.size());
+    return true;
+}
+
+} // namespace Backup
@@ -0,0 +1,114 @@
+#include "throttle.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <stdexcept>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#ifdef __linux__
+    #include <sys/syscall.h>
+#endif
+
+namespace Backup {
+
+// 压力检查的间隔（读取 /proc 的开销很小，但没有必要每个块都读）
+static const std::chrono::seconds CHECK_INTERVAL(1);
+// 暂停与限速时每次睡眠的最长时间，保证能及时响应取消
+static const std::chrono::milliseconds SLEEP_SLICE(100);
+
+Throttle::Throttle(const ResourcePolicy& policy, const std::atomic<bool>* cancel)
+    : m_policy(policy), m_cancel(cancel),
+      m_tokens(static_cast<double>(policy.ioBytesPerSec) / 4),
+      m_lastRefill(Clock::now()), m_nextCheck(Clock::now()) {}
+
+void Throttle::waitForCapacity() {
+    auto budget = std::chrono::seconds(std::max(0, m_policy.maxPauseSeconds));
+    while (m_paused < budget && overloaded()) {
+        sleepFor(std::min<Clock::duration>(CHECK_INTERVAL, budget - m_paused));
+    }
+    m_nextCheck = Clock::now() + CHECK_INTERVAL;
+    m_lastRefill = Clock::now(); // 暂停期间不积累令牌
+}
+
+void Throttle::consume(size_t bytes) {
+    if (m_policy.maxLoadPerCpu > 0.0 || m_policy.maxPressure > 0.0) {
+        if (Clock::now() >= m_nextCheck) waitForCapacity();
+    }
+    if (m_policy.ioBytesPerSec == 0) return;
+
+    // 令牌桶：按速率补充，容量为 1/4 秒的字节数；不足时睡眠到补足为止
+    double rate = static_cast<double>(m_policy.ioBytesPerSec);
+    auto now = Clock::now();
+    m_tokens = std::min(rate / 4, m_tokens + rate * std::chrono::duration<double>(now - m_lastRefill).count());
+    m_lastRefill = now;
+    m_tokens -= static_cast<double>(bytes);
+    if (m_tokens < 0) {
+        auto wait = std::chrono::duration<double>(-m_tokens / rate);
+        auto start = Clock::now();
+        while (Clock::now() - start < wait) {
+            if (m_cancel && m_cancel->load()) throw std::runtime_error("备份已取消。");
+            std::this_thread::sleep_for(std::min<Clock::duration>(SLEEP_SLICE,
+                std::chrono::duration_cast<Clock::duration>(wait - (Clock::now() - start))));
+        }
+        m_tokens = 0;
+        m_lastRefill = Clock::now();
+    }
+}
+
+bool Throttle::overloaded() const {
+    if (m_policy.maxLoadPerCpu > 0.0) {
+        double load[1];
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (getloadavg(load, 1) == 1 && cpus > 0 && load[0] / cpus > m_policy.maxLoadPerCpu) return true;
+    }
+    if (m_policy.maxPressure > 0.0) {
+        if (readPressure("/proc/pressure/cpu") > m_policy.maxPressure) return true;
+        if (readPressure("/proc/pressure/io") > m_policy.maxPressure) return true;
+    }
+    return false;
+}
+
+void Throttle::sleepFor(Clock::duration duration) {
+    auto start = Clock::now();
+    while (Clock::now() - start < duration) {
+        if (m_cancel && m_cancel->load()) throw std::runtime_error("备份已取消。");
+        std::this_thread::sleep_for(std::min<Clock::duration>(SLEEP_SLICE, duration - (Clock::now() - start)));
+    }
+    m_paused += Clock::now() - start;
+}
+
+double Throttle::readPressure(const char* path) {
+    // 格式: "some avg10=1.23 avg60=0.50 avg300=0.10 total=12345"
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 5, "some ") != 0) continue;
+        size_t pos = line.find("avg10=");
+        if (pos == std::string::npos) return -1.0;
+        return std::strtod(line.c_str() + pos + 6, nullptr);
+    }
+    return -1.0;
+}
+
+void Throttle::applyThreadPriority(const ResourcePolicy& policy) {
+#ifdef __linux__
+    // Linux 下 nice 值与 I/O 优先级都是线程属性，who = 0 / tid 表示调用线程
+    if (policy.ioIdle) {
+        const int IOPRIO_CLASS_IDLE = 3;
+        const int IOPRIO_CLASS_SHIFT = 13;
+        const int IOPRIO_WHO_PROCESS = 1;
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+    }
+    if (policy.niceLevel != 0) {
+        setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), policy.niceLevel);
+    }
+#else
+    (void)policy;
+#endif
+}
+
+} // namespace Backup
@@ -1,18 +1,32 @@
 #include "traverser.h"
+#include "name_cache.h"
 #include <string>
 #include <vector>
 #include <sys/stat.h>
 #include <dirent.h>
-#include <unistd.h>     // for readlink
-#include <pwd.h>        // for getpwuid
-#include <grp.h>        // for getgrgid
+#include <fcntl.h>      // for openat / fstatat
+#include <unistd.h>     // for readlinkat
 #include <limits.h>     // for PATH_MAX
 #include <filesystem>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <cstring>
 
 // macOS 的 major/minor 宏已在 sys/types.h 中定义
 // Linux 系统可能需要 sys/sysmacros.h
 #ifdef __linux__
     #include <sys/sysmacros.h>
+    #include <sys/syscall.h>
+    #include <sys/vfs.h>        // for fstatfs
+#else
+    #include <sys/param.h>
+    #include <sys/mount.h>      // for fstatfs (f_fstypename)
 #endif
 
 namespace Backup {
@@ -27,66 +41,544 @@ std::string joinPaths(const std::string & base, const std::string & addition) {
     }
 }
 
-std::vector<Backup::FileInfo> Backup::Traverser::traverse(const std::string & path) {
+namespace {
+
+// 文件系统类型名称与 statfs 魔数 (linux/magic.h)
+struct FsType {
+    const char * name;
+    uint64_t magic;
+};
+
+const FsType FS_TYPES[] = {
+    {"proc", 0x9fa0},          {"sysfs", 0x62656572},      {"tmpfs", 0x01021994},
+    {"devtmpfs", 0x01021994},  {"ramfs", 0x858458f6},      {"devpts", 0x1cd1},
+    {"cgroup", 0x27e0eb},      {"cgroup2", 0x63677270},    {"debugfs", 0x64626720},
+    {"tracefs", 0x74726163},   {"securityfs", 0x73636673}, {"pstore", 0x6165676c},
+    {"bpf", 0xcafe4a11},       {"mqueue", 0x19800202},     {"configfs", 0x62656570},
+    {"hugetlbfs", 0x958458f6}, {"autofs", 0x0187},         {"binfmt_misc", 0x42494e4d},
+    {"efivarfs", 0xde5e81e4},  {"rpc_pipefs", 0x67596969}, {"nsfs", 0x6e736673},
+    {"fusectl", 0x65735543},   {"fuse", 0x65735546},       {"overlay", 0x794c7630},
+    {"nfs", 0x6969},           {"nfs4", 0x6969},           {"cifs", 0xff534d42},
+    {"smb2", 0xfe534d42},      {"smb", 0x517b},            {"ceph", 0x00c36400},
+};
+
+// 解析文件系统类型名称，非 Linux 平台按名称比较（f_fstypename），以名称在表中的下标表示
+uint64_t fsTypeOf(const std::string & name) {
+    for (size_t i = 0; i < sizeof(FS_TYPES) / sizeof(FS_TYPES[0]); ++i) {
+        if (name == FS_TYPES[i].name) {
+#ifdef __linux__
+            return FS_TYPES[i].magic;
+#else
+            return i;
+#endif
+        }
+    }
+    throw std::runtime_error("未知的文件系统类型: " + name);
+}
+
+} // namespace
+
+std::vector<std::string> Traverser::pseudoFileSystems() {
+    return {"proc", "sysfs", "devtmpfs", "devpts", "cgroup", "cgroup2", "debugfs", "tracefs", "securityfs",
+            "pstore", "bpf", "mqueue", "configfs", "hugetlbfs", "autofs", "binfmt_misc", "efivarfs",
+            "rpc_pipefs", "nsfs", "fusectl"};
+}
+
+bool Traverser::shouldDescend(int dirFd, dev_t parentDevice, dev_t & device) const {
+    struct stat dirStat;
+    if (fstat(dirFd, &dirStat) != 0) {
+        throw std::runtime_error("Cannot stat directory");
+    }
+    device = dirStat.st_dev;
+    if (device == parentDevice) return true;    // 不是挂载点
+    if (m_options.oneFileSystem && device != m_rootDevice) return false;
+    if (m_excludedFsTypes.empty()) return true;
+
+    struct statfs fsStat;
+    if (fstatfs(dirFd, &fsStat) != 0) return true;
+#ifdef __linux__
+    uint64_t type = static_cast<uint64_t>(fsStat.f_type) & 0xffffffffu;
+    return std::find(m_excludedFsTypes.begin(), m_excludedFsTypes.end(), type) == m_excludedFsTypes.end();
+#else
+    for (uint64_t i : m_excludedFsTypes) {
+        if (std::strcmp(fsStat.f_fstypename, FS_TYPES[i].name) == 0) return false;
+    }
+    return true;
+#endif
+}
+
+std::vector<FileInfo> Traverser::traverse(const std::string & path) {
     std::vector<FileInfo> files;
+    traverseInto(path, [&files](FileInfo && info, uint32_t) {
+        files.push_back(std::move(info));
+        return static_cast<uint32_t>(files.size() - 1);
+    });
+    return files;
+}
+
+void Traverser::traverse(const std::string & path, const Visitor & visitor) {
+    traverseInto(path, [&visitor](FileInfo && info, uint32_t) {
+        visitor(info);
+        return FileList::NO_PARENT;
+    });
+}
 
+void Traverser::traverse(const std::string & path, FileList & list) {
+    list = FileList();
+    list.setRoot(path);
+    traverseInto(path, [&list](FileInfo && info, uint32_t parent) {
+        return list.append(info, parent);
+    });
+}
+
+void Traverser::traverseInto(const std::string & path, const EntrySink & sink) {
     // 检查路径是否存在
     struct stat pathStat;
     if (lstat(path.c_str(), &pathStat) == -1) {
         throw std::runtime_error("Cannot open path: " + path);
     }
+    m_rootDevice = pathStat.st_dev;
+    m_peakBuffered = 0;
+    m_excludedFsTypes.clear();
+    for (const auto & name : m_options.excludeFsTypes) m_excludedFsTypes.push_back(fsTypeOf(name));
 
     if (S_ISDIR(pathStat.st_mode)) {
-        // 目录：递归遍历
-        traverseHelper(path, path, files);
+        unsigned int threads = m_options.threads;
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        if (threads > 1) {
+            // 目录：多线程并行遍历
+            traverseParallel(path, threads, sink);
+        } else {
+            // 目录：递归遍历
+            int rootFd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (rootFd < 0) {
+                throw std::runtime_error("Cannot open directory: " + path);
+            }
+            try {
+                traverseHelper(rootFd, path, "", FileList::NO_PARENT, m_rootDevice, sink);
+            } catch (...) {
+                close(rootFd);
+                throw;
+            }
+            close(rootFd);
+        }
     } else {
         // 非目录：直接收集该路径的元数据
-        files.push_back(getFileInfo(path, path));
+        sink(getFileInfo(path, path), FileList::NO_PARENT);
     }
-    return files;
 }
 
-void Traverser::traverseHelper(const std::string & currentDir, const std::string & rootDir, std::vector<FileInfo> & files) {
-    DIR *dir = opendir(currentDir.c_str());
-    if (!dir) {
+void Traverser::traverseHelper(int dirFd, const std::string & currentDir, const std::string & relativeDir, uint32_t parent,
+                               dev_t device, const EntrySink & sink) {
+    std::vector<FileInfo> entries;
+    scanDirectory(dirFd, currentDir, relativeDir, entries);
+
+    for (auto & fileInfo : entries) {
+        if (fileInfo.type != FileType::DIRECTORY) {
+            sink(std::move(fileInfo), parent);
+            continue;
+        }
+
+        // 目录条目交给 sink 之前先保留子目录的路径
+        std::string childDir = fileInfo.absolutePath;
+        std::string childRelative = fileInfo.relativePath;
+        uint32_t token = sink(std::move(fileInfo), parent);
+
+        const char * name = childRelative.c_str() + (relativeDir.empty() ? 0 : relativeDir.size() + 1);
+        int childFd = openat(dirFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (childFd < 0) {
+            throw std::runtime_error("Cannot open directory: " + childDir);
+        }
+        try {
+            // 挂载点：按选项决定是否进入，不进入时只保留目录条目本身
+            dev_t childDevice = device;
+            if (checksMounts() && !shouldDescend(childFd, device, childDevice)) {
+                close(childFd);
+                continue;
+            }
+            traverseHelper(childFd, childDir, childRelative, token, childDevice, sink);
+        } catch (...) {
+            close(childFd);
+            throw;
+        }
+        close(childFd);
+    }
+}
+
+namespace {
+
+// 目录项读取：Linux 下直接以大缓冲区调用 getdents64，其他平台使用 fdopendir/readdir
+class DirStream {
+public:
+    explicit DirStream(int dirFd) {
+#ifdef __linux__
+        m_fd = dirFd;
+        if (lseek(m_fd, 0, SEEK_SET) < 0) m_failed = true;
+#else
+        int fd = dup(dirFd);
+        m_dir = (fd >= 0) ? fdopendir(fd) : nullptr;
+        if (!m_dir) {
+            if (fd >= 0) close(fd);
+            m_failed = true;
+        } else {
+            rewinddir(m_dir);
+        }
+#endif
+    }
+
+    ~DirStream() {
+#ifndef __linux__
+        if (m_dir) closedir(m_dir);
+#endif
+    }
+
+    DirStream(const DirStream &) = delete;
+    DirStream & operator=(const DirStream &) = delete;
+
+    bool failed() const { return m_failed; }
+
+    // 读取下一个条目，目录读完时返回 false，读取出错时抛出异常
+    bool next(const char *& name, unsigned char & type) {
+#ifdef __linux__
+        struct LinuxDirent64 {
+            uint64_t d_ino;
+            int64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[];
+        };
+        // 每个线程复用一块缓冲区：单次系统调用取回数百个条目。
+        // scanDirectory 读完一个目录才会递归，同一线程内的读取不会交错
+        static thread_local std::vector<char> buffer(64 * 1024);
+        if (m_pos >= m_len) {
+            long n = syscall(SYS_getdents64, m_fd, buffer.data(), buffer.size());
+            if (n < 0) throw std::runtime_error("getdents64 failed");
+            if (n == 0) return false;
+            m_len = static_cast<size_t>(n);
+            m_pos = 0;
+        }
+        const LinuxDirent64 * entry = reinterpret_cast<const LinuxDirent64 *>(buffer.data() + m_pos);
+        m_pos += entry->d_reclen;
+        name = entry->d_name;
+        type = entry->d_type;
+        return true;
+#else
+        struct dirent * entry = readdir(m_dir);
+        if (!entry) return false;
+        name = entry->d_name;
+        type = entry->d_type;
+        return true;
+#endif
+    }
+
+private:
+    bool m_failed = false;
+#ifdef __linux__
+    int m_fd = -1;
+    size_t m_pos = 0;
+    size_t m_len = 0;
+#else
+    DIR * m_dir = nullptr;
+#endif
+};
+
+} // namespace
+
+void Traverser::scanDirectory(int dirFd, const std::string & currentDir, const std::string & relativeDir, std::vector<FileInfo> & entries) {
+    DirStream dir(dirFd);
+    if (dir.failed()) {
         throw std::runtime_error("Cannot open directory: " + currentDir);
     }
 
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        std::string entryName = entry->d_name;
-        if (entryName == "." || entryName == "..") {
+    bool hasExcludes = m_options.filter && m_options.filter->hasExcludes();
+    const char * entryName;
+    unsigned char entryType;
+    while (dir.next(entryName, entryType)) {
+        if (entryName[0] == '.' && (entryName[1] == '\0' || (entryName[1] == '.' && entryName[2] == '\0'))) {
             continue;
         }
-        if (entryName == ".DS_Store") {
+        if (std::strcmp(entryName, ".DS_Store") == 0) {
             continue; // 跳过 .DS_Store 文件
         }
 
-        std::string fullPath = joinPaths(currentDir, entryName);
-        
-        Backup::FileInfo fileInfo = getFileInfo(fullPath, rootDir);
-        files.push_back(fileInfo);
+        // 相对路径由父目录拼接得到，无需再从完整路径中截取
+        std::string relativePath = relativeDir.empty() ? std::string(entryName) : relativeDir + "/" + entryName;
 
-        if (fileInfo.type == FileType::DIRECTORY) {
-            traverseHelper(fullPath, rootDir, files);
+        // 排除规则在 stat 之前求值，目录类型优先取自 d_type
+        struct stat fileStat;
+        bool haveStat = false;
+        if (hasExcludes) {
+            bool isDirectory;
+            if (entryType != DT_UNKNOWN) {
+                isDirectory = (entryType == DT_DIR);
+            } else {
+                haveStat = fstatat(dirFd, entryName, &fileStat, AT_SYMLINK_NOFOLLOW) == 0;
+                isDirectory = haveStat && S_ISDIR(fileStat.st_mode);
+            }
+            if (m_options.filter->excluded(relativePath, isDirectory)) {
+                continue;
+            }
         }
+
+        FileInfo info;
+        info.absolutePath = joinPaths(currentDir, entryName);
+        info.relativePath = std::move(relativePath);
+
+        if (!m_options.statDirectories && entryType == DT_DIR) {
+            // 调用方不需要目录的元数据
+            info.type = FileType::DIRECTORY;
+            info.size = 0;
+            info.permissions = S_IFDIR;
+            info.lastModified = 0;
+            info.UID = 0;
+            info.GID = 0;
+            info.deviceMajor = 0;
+            info.deviceMinor = 0;
+            entries.push_back(std::move(info));
+            continue;
+        }
+
+        if (!haveStat && fstatat(dirFd, entryName, &fileStat, AT_SYMLINK_NOFOLLOW) == -1) {
+            throw std::runtime_error("Cannot stat file: " + info.absolutePath);
+        }
+        fillFileInfo(info, fileStat, dirFd, entryName);
+        entries.push_back(std::move(info));
     }
 
-    closedir(dir);
+    if (m_options.sortEntries) {
+        std::sort(entries.begin(), entries.end(), [](const FileInfo & a, const FileInfo & b) {
+            return a.relativePath < b.relativePath;
+        });
+    }
 }
 
-FileInfo Traverser::getFileInfo(const std::string & fullPath, const std::string & rootDir) {
-    FileInfo info;
-    info.absolutePath = fullPath;
+namespace {
+
+// 一个目录的扫描结果；子目录的结果挂在对应条目下，输出时按先序展开
+struct DirNode {
+    enum State { QUEUED, CLAIMED, READY };
+
+    DirNode(std::string p, std::string rel, dev_t device)
+        : path(std::move(p)), relativePath(std::move(rel)), parentDevice(device) {}
+
+    std::string path;
+    std::string relativePath;
+    dev_t parentDevice;                                 // 父目录所在的设备（用于判定挂载点）
+    std::atomic<int> state{QUEUED};                     // 由取得 CLAIMED 的线程扫描；READY 由 readyMutex 保护通知
+    std::vector<FileInfo> entries;
+    std::vector<std::shared_ptr<DirNode>> children;     // 与 entries 一一对应，非目录为空
+};
+
+// 工作窃取队列：所有者从尾部取（深度优先，局部性好），窃取者从头部取（通常是更大的子树）
+class WorkStealingDeque {
+public:
+    void push(std::shared_ptr<DirNode> task) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+
+    bool pop(std::shared_ptr<DirNode> & task) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_tasks.empty()) return false;
+        task = std::move(m_tasks.back());
+        m_tasks.pop_back();
+        return true;
+    }
+
+    bool steal(std::shared_ptr<DirNode> & task) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_tasks.empty()) return false;
+        task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::deque<std::shared_ptr<DirNode>> m_tasks;
+};
+
+} // namespace
+
+void Traverser::traverseParallel(const std::string & rootDir, unsigned int threads, const EntrySink & sink) {
+    auto root = std::make_shared<DirNode>(rootDir, "", m_rootDevice);
+    std::vector<WorkStealingDeque> deques(threads);
+    std::atomic<size_t> pending{1};       // 已入队但尚未被取出处理的目录数
+    std::atomic<size_t> queued{1};        // 仍在队列中的目录数；增加时持有 idleMutex，空闲线程据此等待
+    std::atomic<bool> aborted{false};
+    std::mutex idleMutex;
+    std::condition_variable idle;
+    std::mutex readyMutex;
+    std::condition_variable readyCv;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    // 已扫描、尚未交给 sink 的条目数：达到上限时工作线程暂停领取新目录，
+    // 扫描远快于下游（压缩、加密）时内存不随文件总数增长
+    const size_t limit = m_options.maxBufferedEntries;
+    std::atomic<size_t> buffered{0};
+    std::atomic<size_t> peak{0};
+    std::mutex budgetMutex;
+    std::condition_variable budgetCv;
+
+    deques[0].push(root);
+
+    auto fail = [&](std::exception_ptr e) {
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = e;
+            aborted = true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(budgetMutex);
+            budgetCv.notify_all();
+        }
+        std::lock_guard<std::mutex> lock(readyMutex);
+        readyCv.notify_all();
+    };
+
+    // 扫描一个已取得 CLAIMED 的目录，子目录放入 deques[queue]
+    auto scanNode = [&](DirNode & node, unsigned int queue) {
+        // 每个目录只解析一次完整路径，目录内的条目都相对该 fd 访问
+        int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (node.relativePath.empty() ? 0 : O_NOFOLLOW);
+        int dirFd = open(node.path.c_str(), flags);
+        if (dirFd < 0) {
+            throw std::runtime_error("Cannot open directory: " + node.path);
+        }
+        dev_t device = node.parentDevice;
+        try {
+            // 挂载点：按选项决定是否进入，不进入时该目录没有子条目
+            bool descend = node.relativePath.empty() || !checksMounts() ||
+                           shouldDescend(dirFd, node.parentDevice, device);
+            if (descend) scanDirectory(dirFd, node.path, node.relativePath, node.entries);
+        } catch (...) {
+            close(dirFd);
+            throw;
+        }
+        close(dirFd);
+        node.children.resize(node.entries.size());
+        // 逆序入队：所有者从尾部先取到第一个子目录，与输出顺序一致
+        size_t pushed = 0;
+        for (size_t i = node.entries.size(); i-- > 0;) {
+            if (node.entries[i].type != FileType::DIRECTORY) continue;
+            node.children[i] = std::make_shared<DirNode>(node.entries[i].absolutePath, node.entries[i].relativePath, device);
+            ++pending;
+            deques[queue].push(node.children[i]);
+            ++pushed;
+        }
+        if (pushed > 0) {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            queued += pushed;
+            idle.notify_all();
+        }
+        size_t now = buffered += node.entries.size();
+        for (size_t seen = peak; now > seen && !peak.compare_exchange_weak(seen, now);) {}
 
+        std::lock_guard<std::mutex> lock(readyMutex);
+        node.state = DirNode::READY;
+        readyCv.notify_all();
+    };
+
+    auto worker = [&](unsigned int self) {
+        std::shared_ptr<DirNode> task;
+        while (!aborted && pending > 0) {
+            bool found = deques[self].pop(task);
+            for (unsigned int k = 1; !found && k < threads; ++k) {
+                found = deques[(self + k) % threads].steal(task);
+            }
+            if (!found) {
+                std::unique_lock<std::mutex> lock(idleMutex);
+                idle.wait(lock, [&] { return aborted || pending == 0 || queued > 0; });
+                continue;
+            }
+            --queued;
+
+            // 缓冲已满时等待调用线程输出；调用线程需要的目录由它自己扫描，不会因此死锁
+            if (limit > 0) {
+                std::unique_lock<std::mutex> lock(budgetMutex);
+                budgetCv.wait(lock, [&] { return aborted || buffered < limit || task->state != DirNode::QUEUED; });
+            }
+            int expected = DirNode::QUEUED;
+            if (!aborted && task->state.compare_exchange_strong(expected, DirNode::CLAIMED)) {
+                try {
+                    scanNode(*task, self);
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+            task.reset();
+            if (--pending == 0 || aborted) {
+                std::lock_guard<std::mutex> lock(idleMutex);
+                idle.notify_all();
+            }
+        }
+    };
+
+    // 调用线程按先序输出：下一个目录尚未被领取时自己扫描，已被领取时等待其完成，
+    // 然后立即交给 sink；已输出的子树随即释放，sink 只在调用线程中被调用
+    std::function<void(DirNode &, uint32_t)> emit = [&](DirNode & node, uint32_t parent) {
+        // 自行扫描期间计入 pending，工作线程不会因队列暂时为空而退出
+        ++pending;
+        int expected = DirNode::QUEUED;
+        bool claimed = node.state.compare_exchange_strong(expected, DirNode::CLAIMED);
+        if (claimed) scanNode(node, 0);
+        if (--pending == 0) {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            idle.notify_all();
+        }
+        if (!claimed) {
+            std::unique_lock<std::mutex> lock(readyMutex);
+            readyCv.wait(lock, [&] { return node.state == DirNode::READY || aborted; });
+            if (node.state != DirNode::READY) return;
+        }
+        for (size_t i = 0; i < node.entries.size() && !aborted; ++i) {
+            uint32_t token = sink(std::move(node.entries[i]), parent);
+            if (buffered.fetch_sub(1) == limit) {
+                std::lock_guard<std::mutex> lock(budgetMutex);
+                budgetCv.notify_all();
+            }
+            if (node.children[i]) {
+                emit(*node.children[i], token);
+                if (aborted) return;
+                node.children[i].reset();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t) workers.emplace_back(worker, t);
+    try {
+        emit(*root, FileList::NO_PARENT);
+    } catch (...) {
+        // sink 抛出异常：停止扫描
+        fail(std::current_exception());
+    }
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        idle.notify_all();
+    }
+    for (auto & w : workers) w.join();
+    m_peakBuffered = peak;
+    if (error) std::rethrow_exception(error);
+}
+
+std::string Traverser::relativePathOf(const std::string & fullPath, const std::string & rootDir) {
+    std::string relativePath;
     if (fullPath.find(rootDir) == 0) {
-        info.relativePath = fullPath.substr(rootDir.length()); // 移除 rootDir 前缀 (fullPath = rootDir + relativePath)
-        if (!info.relativePath.empty() && info.relativePath[0] == '/') {
-            info.relativePath = info.relativePath.substr(1); // 移除开头的 "/"
+        relativePath = fullPath.substr(rootDir.length()); // 移除 rootDir 前缀 (fullPath = rootDir + relativePath)
+        if (!relativePath.empty() && relativePath[0] == '/') {
+            relativePath = relativePath.substr(1); // 移除开头的 "/"
         }
     } else {
-        info.relativePath = fullPath; // Fallback to absolute path if rootDir is not a prefix
+        relativePath = fullPath; // Fallback to absolute path if rootDir is not a prefix
     }
+    return relativePath;
+}
+
+FileInfo Traverser::getFileInfo(const std::string & fullPath, const std::string & rootDir) {
+    FileInfo info;
+    info.absolutePath = fullPath;
+    info.relativePath = relativePathOf(fullPath, rootDir);
     // 当根就是文件本身时，relativePath 可能为空，这会导致打包时 name 为空，无法还原
     if (info.relativePath.empty()) {
         info.relativePath = std::filesystem::path(fullPath).filename().string();
@@ -96,30 +588,39 @@ FileInfo Traverser::getFileInfo(const std::string & fullPath, const std::string
     if (lstat(fullPath.c_str(), &fileStat) == -1) {
         throw std::runtime_error("Cannot stat file: " + fullPath);
     }
+    fillFileInfo(info, fileStat, AT_FDCWD, fullPath.c_str());
+    return info;
+}
+
+FileInfo Traverser::statEntry(const std::string & rootDir, const std::string & relativePath) {
+    FileInfo info = getFileInfo((std::filesystem::path(rootDir) / relativePath).string(), rootDir);
+    info.relativePath = relativePath;
+    return info;
+}
+
+void Traverser::fillFileInfo(FileInfo & info, const struct stat & fileStat, int dirFd, const char * name) const {
     info.size = fileStat.st_size;
     info.permissions = fileStat.st_mode;
     info.lastModified = fileStat.st_mtime;
     info.UID = fileStat.st_uid;
     info.GID = fileStat.st_gid;
+    info.inode = fileStat.st_ino;
+#ifdef __APPLE__
+    info.mtimeNs = static_cast<int64_t>(fileStat.st_mtimespec.tv_sec) * 1000000000LL + fileStat.st_mtimespec.tv_nsec;
+    info.ctimeNs = static_cast<int64_t>(fileStat.st_ctimespec.tv_sec) * 1000000000LL + fileStat.st_ctimespec.tv_nsec;
+#else
+    info.mtimeNs = static_cast<int64_t>(fileStat.st_mtim.tv_sec) * 1000000000LL + fileStat.st_mtim.tv_nsec;
+    info.ctimeNs = static_cast<int64_t>(fileStat.st_ctim.tv_sec) * 1000000000LL + fileStat.st_ctim.tv_nsec;
+#endif
     
     // 获取设备号（对于设备文件）
     info.deviceMajor = major(fileStat.st_rdev);
     info.deviceMinor = minor(fileStat.st_rdev);
 
-    // 获取用户名
-    struct passwd *pw = getpwuid(fileStat.st_uid);
-    if (pw != nullptr) {
-        info.userName = pw->pw_name;
-    } else {
-        info.userName = std::to_string(fileStat.st_uid); // 如果无法获取用户名，使用UID
-    }
-
-    // 获取组名
-    struct group *gr = getgrgid(fileStat.st_gid);
-    if (gr != nullptr) {
-        info.groupName = gr->gr_name;
-    } else {
-        info.groupName = std::to_string(fileStat.st_gid); // 如果无法获取组名，使用GID
+    // 用户名/组名经由缓存解析，每个 uid/gid 只查询一次 NSS
+    if (m_options.resolveNames) {
+        info.userName = NameCache::instance().userName(fileStat.st_uid);
+        info.groupName = NameCache::instance().groupName(fileStat.st_gid);
     }
 
     // 确定文件类型
@@ -131,7 +632,7 @@ FileInfo Traverser::getFileInfo(const std::string & fullPath, const std::string
         info.type = FileType::SYMLINK;
         // 读取符号链接的目标
         char linkBuf[PATH_MAX];
-        ssize_t len = readlink(fullPath.c_str(), linkBuf, sizeof(linkBuf) - 1);
+        ssize_t len = readlinkat(dirFd, name, linkBuf, sizeof(linkBuf) - 1);
         if (len != -1) {
             linkBuf[len] = '\0';
             info.linkTarget = linkBuf;
@@ -149,7 +650,5 @@ FileInfo Traverser::getFileInfo(const std::string & fullPath, const std::string
     } else {
         info.type = FileType::UNKNOWN;
     }
-
-    return info;
 }
 } // namespace Backup
\ No newline at end of file
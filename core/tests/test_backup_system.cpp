@@ -4,7 +4,13 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <chrono>
 #include "../include/backup_system.h" // 假设 BackupSystem 头文件路径
+#include "../include/traverser.h"
+#include "../include/packer.h"
+#include "../include/compressor.h"
+#include "../include/encryptor.h"
+#include "../include/pipeline.h"
 
 using namespace Backup;
 
@@ -287,4 +293,363 @@ TEST_F(BackupSystemTest, BackupWithNameKeywords) {
     EXPECT_FALSE(std::filesystem::exists(real_dstDir + "/file1.txt"));            // 原有的文件也不包含
 
     std::cout << "[Test Info] Keyword to Regex conversion test passed." << std::endl;
-}
\ No newline at end of file
+}
+// 10. 流水线：跨越多个数据块的备份与还原
+TEST_F(BackupSystemTest, MultiChunkPipelineRoundTrip) {
+    // 约 3.5MB 的半随机数据，跨越多个 1MB 数据块
+    std::string big;
+    big.reserve(3500 * 1024);
+    uint32_t seed = 12345;
+    while (big.size() < 3500 * 1024) {
+        seed = seed * 1103515245 + 12345;
+        big += "line " + std::to_string(seed % 1000) + " of generated content\n";
+    }
+    createFile(srcDir + "/subdir/big.txt", big);
+
+    BackupSystem bs;
+    bs.setPassword("PipelinePass");
+    ASSERT_TRUE(bs.backup(srcDir, backupFile));
+    EXPECT_FALSE(std::filesystem::exists(backupFile + ".part"));
+
+    // 新格式以 "FBK2" 开头
+    EXPECT_EQ(readFile(backupFile).substr(0, 4), "FBK2");
+
+    EXPECT_TRUE(bs.verify(backupFile));
+    ASSERT_TRUE(bs.restore(backupFile, dstDir));
+    EXPECT_TRUE(compareDirectories(srcDir, dstDir));
+}
+
+// 10b. 流水线：文件清单超过内存上限时暂存到临时文件，清单内容不变且不留下临时文件
+TEST_F(BackupSystemTest, ManifestSpillsBeyondMemoryLimit) {
+    for (int i = 0; i < 300; ++i) createFile(srcDir + "/subdir/entry_" + std::to_string(i) + ".txt", std::to_string(i));
+    std::vector<FileInfo> files = Traverser().traverse(srcDir);
+
+    PipelineOptions inMemory;
+    inMemory.chunkSize = 4096;
+    PipelineStats base = BackupPipeline(CompressionAlgorithm::LZSS, nullptr, inMemory).run(files, backupFile);
+    EXPECT_EQ(base.manifestSpilled, 0u);
+
+    PipelineOptions spilling = inMemory;
+    spilling.manifestMemory = 1024;
+    std::string spilledFile = testRoot + "/spilled.dat";
+    PipelineStats stats = BackupPipeline(CompressionAlgorithm::LZSS, nullptr, spilling).run(files, spilledFile);
+    EXPECT_GT(stats.manifestSpilled, 0u);
+    EXPECT_EQ(stats.entries, base.entries);
+    EXPECT_EQ(stats.manifestBytes, base.manifestBytes);
+
+    std::vector<ManifestEntry> expected = readManifest(backupFile, nullptr);
+    std::vector<ManifestEntry> actual = readManifest(spilledFile, nullptr);
+    ASSERT_EQ(actual.size(), expected.size());
+    ASSERT_EQ(actual.size(), files.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(actual[i].path, expected[i].path);
+        EXPECT_EQ(actual[i].headerOffset, expected[i].headerOffset);
+        EXPECT_EQ(actual[i].hasHash, expected[i].hasHash);
+        EXPECT_EQ(actual[i].sha256, expected[i].sha256);
+    }
+
+    for (const auto& entry : std::filesystem::directory_iterator(testRoot)) {
+        EXPECT_EQ(entry.path().filename().string().find(".manifest"), std::string::npos) << entry.path();
+    }
+}
+
+// 11. 流式还原：损坏的数据块必须导致还原失败，而不是静默截断
+TEST_F(BackupSystemTest, CorruptedChunkFailsRestore) {
+    std::string big(2500 * 1024, '\0');
+    for (size_t i = 0; i < big.size(); ++i) big[i] = static_cast<char>((i * 7919) % 251);
+    createFile(srcDir + "/big.bin", big);
+
+    BackupSystem bs;
+    ASSERT_TRUE(bs.backup(srcDir, backupFile));
+
+    // 破坏中间某个块的数据
+    {
+        std::fstream f(backupFile, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(std::filesystem::file_size(backupFile) / 2);
+        f.put(0x5A);
+        f.put(0xA5);
+    }
+    EXPECT_THROW(bs.restore(backupFile, dstDir), std::runtime_error);
+}
+
+// 12. 兼容性：旧的整体格式（整文件压缩 + 加密）仍可还原
+TEST_F(BackupSystemTest, LegacyFormatStillRestores) {
+    // 按旧流程手工生成备份：打包 -> 整体压缩 -> 整体加密
+    Traverser traverser;
+    auto files = traverser.traverse(srcDir);
+    std::string rootName = std::filesystem::path(srcDir).filename().string();
+    for (auto& f : files) f.relativePath = rootName + "/" + f.relativePath;
+
+    std::vector<uint8_t> tarData;
+    Packer packer;
+    packer.pack(files, [&](const char* data, size_t len) {
+        tarData.insert(tarData.end(), data, data + len);
+    });
+
+    Compressor compressor;
+    Encryptor encryptor;
+    encryptor.init("LegacyPass");
+    auto stored = encryptor.encrypt(compressor.compress(tarData, CompressionAlgorithm::LZSS));
+    {
+        std::ofstream out(backupFile, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(stored.data()), stored.size());
+    }
+
+    BackupSystem bs;
+    bs.setPassword("LegacyPass");
+    EXPECT_TRUE(bs.verify(backupFile));
+    ASSERT_TRUE(bs.restore(backupFile, dstDir));
+    EXPECT_TRUE(compareDirectories(srcDir, dstDir));
+    // 旧格式的条目按 readdir 顺序排列，比对前先排序
+    EXPECT_TRUE(bs.diff(backupFile, srcDir, true).identical());
+}
+
+// 13. 流式验证：DEEP 模式按文件清单比对每个文件的哈希
+TEST_F(BackupSystemTest, DeepVerifyHashesEveryFile) {
+    BackupSystem bs;
+    bs.setPassword("DeepPass");
+    ASSERT_TRUE(bs.backup(srcDir, backupFile));
+
+    VerifyReport full = bs.verify(backupFile, VerifyMode::FULL);
+    EXPECT_EQ(full.filesHashed, 0u);
+    EXPECT_GT(full.chunksChecked, 0u);
+
+    VerifyReport deep = bs.verify(backupFile, VerifyMode::DEEP);
+    EXPECT_EQ(deep.filesHashed, 3u);           // file1.txt, file2.log, subdir/file3.bin
+    EXPECT_EQ(deep.entries, full.entries);
+    EXPECT_EQ(deep.chunksChecked, deep.chunksTotal);
+}
+
+// 13b. 流式验证：文件清单跨越多个块时逐块读取，条目跨块边界也能正确解码
+TEST_F(BackupSystemTest, DeepVerifyStreamsManifestChunks) {
+    for (int i = 0; i < 200; ++i) createFile(srcDir + "/subdir/manifest_" + std::to_string(i) + ".txt", std::to_string(i));
+    std::vector<FileInfo> files = Traverser().traverse(srcDir);
+
+    PipelineOptions options;
+    options.chunkSize = 1000;   // 不是条目大小的整数倍，许多条目跨越块边界
+    BackupPipeline(CompressionAlgorithm::LZSS, nullptr, options).run(files, backupFile);
+
+    ArchiveReader reader(backupFile, nullptr);
+    ASSERT_GT(reader.footer().manifestChunks, 5u);
+    ManifestReader manifest(reader);
+    EXPECT_EQ(manifest.count(), files.size());
+    ManifestEntry entry;
+    size_t read = 0;
+    while (manifest.next(entry)) {
+        EXPECT_EQ(entry.path, files[read].relativePath);
+        ++read;
+    }
+    EXPECT_EQ(read, files.size());
+
+    BackupSystem bs;
+    VerifyReport deep = bs.verify(backupFile, VerifyMode::DEEP);
+    EXPECT_EQ(deep.entries, files.size());
+    EXPECT_GT(deep.filesHashed, 200u);
+
+    // 抽样验证与块一起顺序前进读取清单：全部抽取时每个完整落在块内的头部都被比对
+    VerifyReport all = bs.verify(backupFile, VerifyMode::SAMPLE, 1.0);
+    EXPECT_EQ(all.chunksChecked, all.chunksTotal);
+    EXPECT_GT(all.entries, files.size() / 3);   // 每项占 1024 字节，约一半的头部跨越块边界
+    VerifyReport some = bs.verify(backupFile, VerifyMode::SAMPLE, 0.1);
+    EXPECT_LT(some.entries, all.entries);
+}
+
+// 14. 流式验证：损坏的数据块导致验证失败
+TEST_F(BackupSystemTest, VerifyDetectsCorruptedChunk) {
+    std::string big(2500 * 1024, '\0');
+    for (size_t i = 0; i < big.size(); ++i) big[i] = static_cast<char>((i * 7919) % 251);
+    createFile(srcDir + "/big.bin", big);
+
+    BackupSystem bs;
+    ASSERT_TRUE(bs.backup(srcDir, backupFile));
+    {
+        std::fstream f(backupFile, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(std::filesystem::file_size(backupFile) / 2);
+        f.put(0x5A);
+    }
+    EXPECT_THROW(bs.verify(backupFile, VerifyMode::FULL), std::runtime_error);
+}
+
+// 15. 抽样验证：只解码部分块，但结构（索引）损坏总能被发现
+TEST_F(BackupSystemTest, SampleVerifyChecksSubsetOfChunks) {
+    std::string big(4500 * 1024, '\0');
+    for (size_t i = 0; i < big.size(); ++i) big[i] = static_cast<char>((i * 7919) % 251);
+    createFile(srcDir + "/big.bin", big);
+
+    BackupSystem bs;
+    bs.setCompressionAlgorithm(static_cast<int>(CompressionAlgorithm::HUFFMAN));
+    ASSERT_TRUE(bs.backup(srcDir, backupFile));
+
+    VerifyReport report = bs.verify(backupFile, VerifyMode::SAMPLE, 0.2);
+    EXPECT_GE(report.chunksTotal, 5u);
+    EXPECT_GE(report.chunksChecked, 1u);
+    EXPECT_LT(report.chunksChecked, report.chunksTotal);
+    EXPECT_NEAR(report.coverage, static_cast<double>(report.chunksChecked) / report.chunksTotal, 1e-9);
+
+    EXPECT_THROW(bs.verify(backupFile, VerifyMode::SAMPLE, 0.0), std::runtime_error);
+
+    // 破坏尾部索引中的一个字节
+    {
+        std::fstream f(backupFile, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(std::filesystem::file_size(backupFile) - 48 - 20);
+        f.put(0x7F);
+    }
+    EXPECT_THROW(bs.verify(backupFile, VerifyMode::SAMPLE, 0.01), std::runtime_error);
+}
+
+// 16. 比对：不还原即可得到新增、删除与修改的路径
+TEST_F(BackupSystemTest, DiffAgainstSource) {
+    BackupSystem bs;
+    ASSERT_TRUE(bs.backup(srcDir, backupFile));
+
+    std::string root = std::filesystem::path(srcDir).filename().string();
+    DiffReport clean = bs.diff(backupFile, srcDir, true);
+    EXPECT_TRUE(clean.identical());
+    EXPECT_EQ(clean.hashed, 3u);
+
+    createFile(srcDir + "/file1.txt", "Content of file 1 -- edited");
+    std::filesystem::remove(srcDir + "/file2.log");
+    createFile(srcDir + "/subdir/new.txt", "new");
+
+    DiffReport report = bs.diff(backupFile, srcDir);
+    ASSERT_EQ(report.entries.size(), 3u);
+    EXPECT_EQ(report.entries[0].path, root + "/file1.txt");
+    EXPECT_EQ(report.entries[0].kind, DiffKind::CHANGED);
+    EXPECT_EQ(report.entries[0].detail, "size");
+    EXPECT_EQ(report.entries[1].path, root + "/file2.log");
+    EXPECT_EQ(report.entries[1].kind, DiffKind::REMOVED);
+    EXPECT_EQ(report.entries[2].path, root + "/subdir/new.txt");
+    EXPECT_EQ(report.entries[2].kind, DiffKind::ADDED);
+}
+
+// 16b. 比对按先序归并：字符串顺序与遍历顺序不同的名称（"a-b" < "a/x"）也能对齐
+TEST_F(BackupSystemTest, DiffMergesInTraversalOrder) {
+    for (const char* dir : {"a", "a-b", "a.c", "a/x", "ab"}) std::filesystem::create_directories(srcDir + "/" + dir);
+    for (const char* file : {"a/1.txt", "a/x/2.txt", "a-b/3.txt", "a.c/4.txt", "ab/5.txt", "a0.txt"}) {
+        createFile(srcDir + "/" + file, file);
+    }
+    BackupSystem bs;
+    ASSERT_TRUE(bs.backup(srcDir, backupFile));
+    DiffReport clean = bs.diff(backupFile, srcDir, true);
+    EXPECT_TRUE(clean.identical());
+    EXPECT_EQ(clean.hashed, 9u);
+
+    std::string root = std::filesystem::path(srcDir).filename().string();
+    std::filesystem::remove(srcDir + "/a/x/2.txt");
+    createFile(srcDir + "/a-b/new.txt", "new");
+    DiffReport report = bs.diff(backupFile, srcDir);
+    ASSERT_EQ(report.entries.size(), 2u);
+    EXPECT_EQ(report.entries[0].path, root + "/a-b/new.txt");
+    EXPECT_EQ(report.entries[0].kind, DiffKind::ADDED);
+    EXPECT_EQ(report.entries[1].path, root + "/a/x/2.txt");
+    EXPECT_EQ(report.entries[1].kind, DiffKind::REMOVED);
+
+    EXPECT_THROW(bs.diff(backupFile, srcDir + "/missing"), std::runtime_error);
+}
+
+// 17. 增量备份：只包含变化的文件与墓碑，按链还原得到最新状态
+TEST_F(BackupSystemTest, DeltaChainRestore) {
+    BackupSystem bs;
+    bs.setPassword("delta");
+    std::string full = testRoot + "/full.bin";
+    std::string delta1 = testRoot + "/d1.bin";
+    std::string delta2 = testRoot + "/d2.bin";
+    ASSERT_TRUE(bs.backup(srcDir, full));
+
+    createFile(srcDir + "/file1.txt", "Content of file 1 -- edited");
+    std::filesystem::create_directories(srcDir + "/fresh");
+    createFile(srcDir + "/fresh/new.txt", "new");
+    std::filesystem::remove_all(srcDir + "/subdir");
+    ASSERT_TRUE(bs.backupDelta(srcDir, {"file1.txt", "fresh/new.txt"}, {"subdir/file3.bin"}, delta1));
+
+    createFile(srcDir + "/file2.log", "Log data... more");
+    std::filesystem::remove(srcDir + "/fresh/new.txt");
+    ASSERT_TRUE(bs.backupDelta(srcDir, {"file2.log", "fresh/new.txt"}, {}, delta2));
+
+    EXPECT_FALSE(bs.isDeltaArchive(full));
+    EXPECT_TRUE(bs.isDeltaArchive(delta1));
+    EXPECT_LT(std::filesystem::file_size(delta2), std::filesystem::file_size(full));
+
+    // 链必须从完整备份开始
+    EXPECT_THROW(bs.restoreChain({delta1, delta2}, dstDir), std::runtime_error);
+
+    ASSERT_TRUE(bs.restoreChain({full, delta1, delta2}, dstDir));
+    std::string restored = dstDir + "/" + std::filesystem::path(srcDir).filename().string();
+    EXPECT_EQ(readFile(restored + "/file1.txt"), "Content of file 1 -- edited");
+    EXPECT_EQ(readFile(restored + "/file2.log"), "Log data... more");
+    EXPECT_FALSE(std::filesystem::exists(restored + "/subdir"));
+    EXPECT_FALSE(std::filesystem::exists(restored + "/fresh/new.txt"));
+    EXPECT_FALSE(std::filesystem::exists(restored + "/.fbk_tombstones"));
+    EXPECT_TRUE(compareDirectories(srcDir, dstDir));
+}
+
+// 17c. 增量备份由头部标记判定：源目录中名为 .fbk_tombstones 的普通文件不会让完整备份被当作增量备份
+TEST_F(BackupSystemTest, TombstoneNamedFileIsNotDelta) {
+    createFile(srcDir + "/zz/.fbk_tombstones", std::string("file1.txt\0file2.log\0", 20));
+    createFile(srcDir + "/.fbk_tombstones", std::string("file1.txt\0file2.log\0", 20));
+    BackupSystem bs;
+    std::string full = testRoot + "/full.bin";
+    std::string second = testRoot + "/second.bin";
+    ASSERT_TRUE(bs.backup(srcDir, full));
+    ASSERT_TRUE(bs.backup(srcDir, second));
+    EXPECT_FALSE(bs.isDeltaArchive(full));
+
+    // 完整备份不能作为增量应用，其中的同名文件不会删除任何路径
+    EXPECT_THROW(bs.restoreChain({full, second}, dstDir), std::runtime_error);
+    std::string restored = dstDir + "/" + std::filesystem::path(srcDir).filename().string();
+    EXPECT_EQ(readFile(restored + "/file1.txt"), "Content of file 1");
+    EXPECT_TRUE(std::filesystem::exists(restored + "/file2.log"));
+
+    std::filesystem::remove_all(dstDir);
+    std::filesystem::create_directories(dstDir);
+    ASSERT_TRUE(bs.restoreChain({full}, dstDir));
+    EXPECT_TRUE(compareDirectories(srcDir, dstDir));
+}
+
+// 17b. 墓碑中的绝对路径或 ".." 不能删除还原目录之外的文件
+TEST_F(BackupSystemTest, DeltaRejectsEscapingTombstones) {
+    std::string victim = testRoot + "/victim";
+    std::filesystem::create_directories(victim);
+    createFile(victim + "/keep.txt", "keep");
+
+    BackupSystem bs;
+    std::string full = testRoot + "/full.bin";
+    ASSERT_TRUE(bs.backup(srcDir, full));
+    std::vector<std::string> malicious = {
+        "../../victim",
+        "subdir/../../../victim",
+        std::filesystem::absolute(victim).string(),
+        ".",
+    };
+    for (size_t i = 0; i < malicious.size(); ++i) {
+        std::string delta = testRoot + "/evil" + std::to_string(i) + ".bin";
+        ASSERT_TRUE(bs.backupDelta(srcDir, {}, {malicious[i]}, delta));
+        std::filesystem::remove_all(dstDir);
+        std::filesystem::create_directories(dstDir);
+        EXPECT_THROW(bs.restoreChain({full, delta}, dstDir), std::runtime_error) << malicious[i];
+        EXPECT_EQ(readFile(victim + "/keep.txt"), "keep") << malicious[i];
+    }
+}
+
+// 18. 资源限制：读取带宽按令牌桶限速，结果与不限速时一致
+TEST_F(BackupSystemTest, ResourcePolicyLimitsBandwidth) {
+    std::string data(1536 * 1024, '\0');
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<char>((i * 2654435761u) >> 11);
+    createFile(srcDir + "/big.bin", data);
+
+    BackupSystem bs;
+    ResourcePolicy policy;
+    policy.maxThreads = 1;
+    policy.ioBytesPerSec = 1024 * 1024;
+    policy.maxLoadPerCpu = 1000.0;  // 阈值足够高，只验证检查路径
+    bs.setResourcePolicy(policy);
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(bs.backup(srcDir, backupFile));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    // 1.5 MB 在 1 MB/s 下（允许 1/4 秒突发）至少需要约 1.25 秒
+    EXPECT_GE(elapsed, std::chrono::milliseconds(1100));
+
+    ASSERT_TRUE(bs.restore(backupFile, dstDir));
+    EXPECT_TRUE(compareDirectories(srcDir, dstDir));
+}
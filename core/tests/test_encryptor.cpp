@@ -3,6 +3,7 @@
 #include <string>
 #include <random>
 #include <algorithm>
+#include <cstring>
 #include "../include/encryptor.h"
 
 using namespace Backup;
@@ -159,4 +160,37 @@ TEST_F(EncryptorTest, DeterministicEncryption) {
 
     // 由于使用了固定盐和固定 IV 生成逻辑，密文应该完全一致
     EXPECT_EQ(c1, c2) << "Encryption should be deterministic with fixed salt/IV derivation logic.";
-}
\ No newline at end of file
+}
+// 8. 分块加密：每个块使用独立的 IV，且可按块序号独立解密
+TEST_F(EncryptorTest, ChunkRoundTripWithDistinctIVs) {
+    encryptor.init("ChunkPass");
+    auto input = generateRandomData(4096);
+
+    auto c0 = encryptor.encryptChunk(input.data(), input.size(), 0);
+    auto c1 = encryptor.encryptChunk(input.data(), input.size(), 1);
+    EXPECT_NE(c0, c1) << "Same plaintext in different chunks should produce different ciphertext.";
+
+    EXPECT_EQ(encryptor.decryptChunk(c1.data(), c1.size(), 1), input);
+    EXPECT_EQ(encryptor.decryptChunk(c0.data(), c0.size(), 0), input);
+
+    // 用错误的块序号解密：要么抛出异常，要么得到错误结果
+    try {
+        EXPECT_NE(encryptor.decryptChunk(c0.data(), c0.size(), 1), input);
+    } catch (const std::runtime_error&) {
+    }
+}
+
+// 9. 密钥校验值：相同密码一致，不同密码不同
+TEST_F(EncryptorTest, KeyCheckDistinguishesPasswords) {
+    Encryptor a, b, c;
+    a.init("PasswordA");
+    b.init("PasswordA");
+    c.init("PasswordB");
+
+    uint8_t ka[8], kb[8], kc[8];
+    a.keyCheck(ka);
+    b.keyCheck(kb);
+    c.keyCheck(kc);
+    EXPECT_EQ(0, std::memcmp(ka, kb, 8));
+    EXPECT_NE(0, std::memcmp(ka, kc, 8));
+}
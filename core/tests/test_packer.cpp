@@ -112,3 +112,70 @@ TEST_F(PackerTest, PackAndUnpackComplexStructure) {
     EXPECT_TRUE(std::filesystem::is_symlink(link3));
     EXPECT_EQ(std::filesystem::read_symlink(link3).string(), "../../root_file.txt");
 }
+
+TEST_F(PackerTest, TarWalkerValidatesStructure) {
+    Backup::Traverser traverser;
+    auto files = traverser.traverse(srcDir);
+
+    std::vector<uint8_t> tarData;
+    Backup::Packer packer;
+    packer.pack(files, [&](const char* data, size_t len) {
+        tarData.insert(tarData.end(), data, data + len);
+    });
+
+    // 以不对齐的小段喂入，条目数与内容字节数应与文件列表一致
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+    Backup::TarWalker::Callbacks callbacks;
+    callbacks.onEntry = [&](const Backup::TarEntry&, uint64_t) { ++entries; };
+    callbacks.onData = [&](const uint8_t*, size_t len) { bytes += len; };
+    Backup::TarWalker walker(callbacks);
+    for (size_t pos = 0; pos < tarData.size(); pos += 77) {
+        walker.feed(tarData.data() + pos, std::min<size_t>(77, tarData.size() - pos));
+    }
+    EXPECT_NO_THROW(walker.finish());
+    EXPECT_EQ(entries, files.size());
+
+    uint64_t expectedBytes = 0;
+    for (const auto& f : files) {
+        if (f.type == Backup::FileType::REGULAR) expectedBytes += f.size;
+    }
+    EXPECT_EQ(bytes, expectedBytes);
+
+    // 截断的流
+    Backup::TarWalker truncated;
+    truncated.feed(tarData.data(), tarData.size() - 512);
+    EXPECT_THROW(truncated.finish(), std::runtime_error);
+
+    // 头部校验和错误
+    std::vector<uint8_t> corrupted = tarData;
+    corrupted[0] ^= 0x01;
+    Backup::TarWalker broken;
+    EXPECT_THROW(broken.feed(corrupted.data(), corrupted.size()), std::runtime_error);
+}
+
+TEST_F(PackerTest, ReadOrderKeepsArchiveIdentical) {
+    // 较大的文件超过批次上限，会打断批次并直接流式写入
+    createFile(srcDir + "/level1/big.bin", std::string(200 * 1024, 'b'));
+    for (int i = 0; i < 30; ++i) {
+        createFile(srcDir + "/level1/level2/small_" + std::to_string(i) + ".txt", std::string(i * 37, 'a' + i % 26));
+    }
+
+    Backup::TraverseOptions options;
+    options.sortEntries = true;
+    auto files = Backup::Traverser(options).traverse(srcDir);
+
+    auto packWith = [&](Backup::ReadOrder order) {
+        std::vector<uint8_t> tarData;
+        Backup::Packer packer;
+        packer.setReadOrder(order, 7, 64 * 1024);
+        packer.pack(files, [&](const char* data, size_t len) {
+            tarData.insert(tarData.end(), data, data + len);
+        });
+        return tarData;
+    };
+
+    std::vector<uint8_t> expected = packWith(Backup::ReadOrder::TRAVERSAL);
+    EXPECT_EQ(packWith(Backup::ReadOrder::INODE), expected);
+    EXPECT_EQ(packWith(Backup::ReadOrder::PHYSICAL), expected);
+}
@@ -0,0 +1,477 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "metadata_index.h"
+#include "traverser.h"
+#include "change_watcher.h"
+#include "scheduler.h"
+#include <thread>
+#include <chrono>
+
+class SchedulerTest : public ::testing::Test {
+protected:
+    std::string testRoot = "./sandbox_scheduler";
+
+    void SetUp() override {
+        if (std::filesystem::exists(testRoot)) std::filesystem::remove_all(testRoot);
+        std::filesystem::create_directories(testRoot + "/src");
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(testRoot);
+    }
+
+    void createFile(const std::string& path, const std::string& content) {
+        std::ofstream out(path);
+        out << content;
+        out.close();
+    }
+
+    // 等待监视器报告满足条件的变化（最多 5 秒）
+    template <typename Pred>
+    Backup::ChangeSet waitForChanges(Backup::ChangeWatcher& watcher, Pred done) {
+        Backup::ChangeSet all;
+        for (int i = 0; i < 500; ++i) {
+            Backup::ChangeSet part = watcher.takeChanges();
+            all.paths.insert(part.paths.begin(), part.paths.end());
+            all.rescan = all.rescan || part.rescan;
+            if (done(all)) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return all;
+    }
+
+    // 一轮完整扫描，返回是否有变化
+    bool scan(Backup::MetadataIndex& index) {
+        bool changed = false;
+        index.beginScan();
+        Backup::Traverser().traverse(testRoot + "/src", [&](Backup::FileInfo& f) {
+            if (f.type == Backup::FileType::DIRECTORY) return;
+            if (index.update(f.relativePath, Backup::MetadataIndex::recordOf(f))) changed = true;
+        });
+        if (index.endScan() > 0) changed = true;
+        return changed;
+    }
+};
+
+// 1. 记录的插入、更新、删除与扩容
+TEST_F(SchedulerTest, MetadataIndexBasicOperations) {
+    Backup::MetadataIndex index(testRoot + "/index");
+    EXPECT_TRUE(index.empty());
+
+    Backup::MetadataRecord record;
+    for (int i = 0; i < 5000; ++i) {
+        record.size = i;
+        record.mtimeNs = i * 1000;
+        EXPECT_TRUE(index.update("file_" + std::to_string(i), record));
+    }
+    EXPECT_EQ(index.size(), 5000u);
+
+    Backup::MetadataRecord found;
+    ASSERT_TRUE(index.find("file_4321", found));
+    EXPECT_EQ(found.size, 4321u);
+    EXPECT_EQ(found.mtimeNs, 4321000);
+    EXPECT_FALSE(index.find("missing", found));
+
+    // 元数据不变时不算变化，内容哈希保留；变化后哈希失效
+    Backup::Sha256Digest digest{};
+    digest[0] = 0xab;
+    index.setContentHash("file_7", digest);
+    record.size = 7;
+    record.mtimeNs = 7000;
+    EXPECT_FALSE(index.update("file_7", record));
+    ASSERT_TRUE(index.find("file_7", found));
+    EXPECT_TRUE(found.hasHash);
+    EXPECT_EQ(found.sha256[0], 0xab);
+    record.mtimeNs = 7001;
+    EXPECT_TRUE(index.update("file_7", record));
+    ASSERT_TRUE(index.find("file_7", found));
+    EXPECT_FALSE(found.hasHash);
+
+    EXPECT_TRUE(index.remove("file_7"));
+    EXPECT_FALSE(index.remove("file_7"));
+    EXPECT_FALSE(index.find("file_7", found));
+    EXPECT_EQ(index.size(), 4999u);
+}
+
+// 2. 索引持久化：重新打开后无需遍历即可比较，能发现停机期间的变化
+TEST_F(SchedulerTest, MetadataIndexPersistsAcrossRuns) {
+    for (int i = 0; i < 50; ++i) createFile(testRoot + "/src/f" + std::to_string(i), "data");
+    std::filesystem::create_directories(testRoot + "/src/sub");
+    createFile(testRoot + "/src/sub/nested", "nested");
+
+    {
+        Backup::MetadataIndex index(testRoot + "/index");
+        EXPECT_TRUE(scan(index));
+        EXPECT_FALSE(scan(index));
+        EXPECT_EQ(index.size(), 51u);
+        index.sync(true);
+    }
+
+    // "重启"期间的修改与删除
+    createFile(testRoot + "/src/sub/nested", "changed content");
+    std::filesystem::remove(testRoot + "/src/f3");
+
+    Backup::MetadataIndex reopened(testRoot + "/index");
+    EXPECT_EQ(reopened.size(), 51u);
+    EXPECT_TRUE(scan(reopened));
+    EXPECT_EQ(reopened.size(), 50u);
+    EXPECT_FALSE(scan(reopened));
+
+    // 损坏的索引文件被拒绝
+    {
+        std::ofstream out(testRoot + "/bad_index", std::ios::binary);
+        out << std::string(200, 'x');
+    }
+    EXPECT_THROW(Backup::MetadataIndex(testRoot + "/bad_index"), std::runtime_error);
+}
+
+// 3. 事件驱动监视：新文件、新目录中的文件、修改与移出目录
+TEST_F(SchedulerTest, ChangeWatcherReportsEvents) {
+    if (!Backup::ChangeWatcher::supported()) GTEST_SKIP() << "no event-driven watcher on this platform";
+    std::string src = testRoot + "/src";
+    std::filesystem::create_directories(src + "/existing");
+    createFile(src + "/existing/old.txt", "old");
+
+    std::atomic<int> notified{0};
+    Backup::ChangeWatcher watcher(src, [&] { ++notified; });
+    ASSERT_TRUE(watcher.start());
+    EXPECT_EQ(watcher.watchCount(), 2u);
+    EXPECT_FALSE(watcher.hasChanges());
+
+    createFile(src + "/existing/old.txt", "modified");
+    createFile(src + "/new.txt", "new");
+    auto changes = waitForChanges(watcher, [](const Backup::ChangeSet& c) {
+        return c.paths.count("existing/old.txt") && c.paths.count("new.txt");
+    });
+    EXPECT_TRUE(changes.paths.count("existing/old.txt"));
+    EXPECT_TRUE(changes.paths.count("new.txt"));
+    EXPECT_FALSE(changes.rescan);
+    EXPECT_GT(notified.load(), 0);
+
+    // 新目录自动加入监视，其中的文件（包括监视建立之前写入的）都被报告
+    std::filesystem::create_directories(src + "/fresh/deeper");
+    createFile(src + "/fresh/deeper/a.txt", "a");
+    changes = waitForChanges(watcher, [](const Backup::ChangeSet& c) { return c.paths.count("fresh/deeper/a.txt") > 0; });
+    EXPECT_TRUE(changes.paths.count("fresh/deeper/a.txt"));
+    createFile(src + "/fresh/deeper/b.txt", "b");
+    changes = waitForChanges(watcher, [](const Backup::ChangeSet& c) { return c.paths.count("fresh/deeper/b.txt") > 0; });
+    EXPECT_TRUE(changes.paths.count("fresh/deeper/b.txt"));
+
+    // 目录被移出监视范围时要求完整重新扫描
+    std::filesystem::rename(src + "/fresh", testRoot + "/moved_out");
+    changes = waitForChanges(watcher, [](const Backup::ChangeSet& c) { return c.rescan; });
+    EXPECT_TRUE(changes.rescan);
+
+    watcher.stop();
+    EXPECT_FALSE(watcher.active());
+}
+
+// 4. 去抖：突发写入只触发一次备份
+TEST_F(SchedulerTest, BurstWritesAreCoalesced) {
+    std::string src = testRoot + "/src";
+    createFile(src + "/seed.txt", "seed");
+
+    testing::internal::CaptureStdout();
+    {
+        Backup::BackupScheduler scheduler;
+        int id = scheduler.addRealtimeTask(src, testRoot + "/dst", "burst", 5);
+        Backup::DebounceOptions debounce;
+        debounce.quietMs = 300;
+        debounce.maxDelayMs = 10000;
+        debounce.minIntervalMs = 0;
+        scheduler.setTaskDebounce(id, debounce);
+        scheduler.start();
+
+        for (int i = 0; i < 40; ++i) {
+            createFile(src + "/out_" + std::to_string(i) + ".o", std::string(100, 'x'));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+        scheduler.stop();
+    }
+    std::string output = testing::internal::GetCapturedStdout();
+
+    size_t runs = 0;
+    for (size_t pos = output.find("Running task"); pos != std::string::npos; pos = output.find("Running task", pos + 1)) ++runs;
+    EXPECT_EQ(runs, 1u) << output;
+}
+
+// 5. 实时任务只备份变化的文件，并能还原到任意时间点
+TEST_F(SchedulerTest, RealtimeTaskWritesDeltas) {
+    std::string src = testRoot + "/src";
+    std::string dst = testRoot + "/dst";
+    createFile(src + "/keep.txt", "keep");
+    createFile(src + "/gone.txt", "gone");
+
+    Backup::BackupScheduler scheduler;
+    int id = scheduler.addRealtimeTask(src, dst, "rt", 5);
+    Backup::DebounceOptions debounce;
+    debounce.quietMs = 100;
+    debounce.minIntervalMs = 0;
+    scheduler.setTaskDebounce(id, debounce);
+    scheduler.start();
+
+    auto waitForBackups = [&](size_t count) {
+        for (int i = 0; i < 500 && Backup::BackupScheduler::listBackups(dst, "rt").size() < count; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return Backup::BackupScheduler::listBackups(dst, "rt");
+    };
+
+    // 第一次变化：尚无完整备份
+    createFile(src + "/first.txt", "1");
+    auto backups = waitForBackups(1);
+    ASSERT_EQ(backups.size(), 1u);
+    EXPECT_FALSE(backups[0].delta);
+
+    // 之后的变化：增量备份
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    createFile(src + "/second.txt", "2");
+    std::filesystem::remove(src + "/gone.txt");
+    backups = waitForBackups(2);
+    ASSERT_EQ(backups.size(), 2u);
+    EXPECT_TRUE(backups[1].delta);
+    scheduler.stop();
+
+    // 最新时间点：完整备份 + 增量
+    EXPECT_EQ(Backup::BackupScheduler::backupChain(dst, "rt").size(), 2u);
+    ASSERT_TRUE(scheduler.restoreTask(id, 0, testRoot + "/latest"));
+    EXPECT_TRUE(std::filesystem::exists(testRoot + "/latest/src/second.txt"));
+    EXPECT_FALSE(std::filesystem::exists(testRoot + "/latest/src/gone.txt"));
+
+    // 第一次备份的时间点：只有完整备份
+    ASSERT_TRUE(scheduler.restoreTask(id, backups[0].time, testRoot + "/earlier"));
+    EXPECT_TRUE(std::filesystem::exists(testRoot + "/earlier/src/gone.txt"));
+    EXPECT_FALSE(std::filesystem::exists(testRoot + "/earlier/src/second.txt"));
+}
+
+// 6. 备份在工作线程中执行：执行期间修改设置不被阻塞，多个任务并行，stop() 取消正在执行的备份
+TEST_F(SchedulerTest, TasksRunOnWorkerPool) {
+    std::string src = testRoot + "/src";
+    std::string chunk(256 * 1024, '\0');
+    for (size_t i = 0; i < chunk.size(); ++i) chunk[i] = static_cast<char>((i * 2654435761u) >> 13);
+    for (int i = 0; i < 200; ++i) createFile(src + "/f" + std::to_string(i), chunk);
+
+    Backup::BackupScheduler scheduler(2);
+    int a = scheduler.addScheduledTask(src, testRoot + "/dst_a", "a", 3600, 5);
+    int b = scheduler.addScheduledTask(src, testRoot + "/dst_b", "b", 3600, 5);
+    testing::internal::CaptureStdout();
+    scheduler.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    auto callStart = std::chrono::steady_clock::now();
+    scheduler.setTaskPassword(a, "secret");
+    scheduler.setTaskCompressionAlgorithm(b, 1);
+    scheduler.addScheduledTask(src, testRoot + "/dst_c", "c", 3600, 5);
+    auto callTime = std::chrono::steady_clock::now() - callStart;
+    EXPECT_LT(callTime, std::chrono::milliseconds(100));
+
+    scheduler.stop();
+    std::string output = testing::internal::GetCapturedStdout();
+    EXPECT_NE(output.find("Running task 1"), std::string::npos);
+    EXPECT_NE(output.find("Running task 2"), std::string::npos);
+
+    // 被取消的备份不留下不完整的文件
+    for (const char* dir : {"/dst_a", "/dst_b"}) {
+        for (const auto& entry : std::filesystem::directory_iterator(testRoot + dir)) {
+            EXPECT_NE(entry.path().extension(), ".part") << entry.path();
+        }
+    }
+}
+
+// 7. 定时任务按单调时钟的固定频率运行，不依赖轮询
+TEST_F(SchedulerTest, ScheduledTasksRunAtFixedRate) {
+    std::string src = testRoot + "/src";
+    createFile(src + "/a.txt", "a");
+
+    testing::internal::CaptureStdout();
+    {
+        Backup::BackupScheduler scheduler;
+        scheduler.addScheduledTask(src, testRoot + "/dst", "tick", 1, 10);
+        scheduler.addScheduledTask(src, testRoot + "/dst_idle", "idle", 3600, 10);
+        scheduler.start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+        scheduler.stop();
+    }
+    std::string output = testing::internal::GetCapturedStdout();
+
+    size_t ticks = 0, idle = 0;
+    for (size_t pos = output.find("Running task 1:"); pos != std::string::npos; pos = output.find("Running task 1:", pos + 1)) ++ticks;
+    for (size_t pos = output.find("Running task 2:"); pos != std::string::npos; pos = output.find("Running task 2:", pos + 1)) ++idle;
+    EXPECT_EQ(ticks, 3u) << output;   // 0s, 1s, 2s
+    EXPECT_EQ(idle, 1u) << output;
+}
+
+// 8. 同一目录或子目录上的实时任务共享一个快照，变化按任务源目录分发
+TEST_F(SchedulerTest, OverlappingTasksShareSnapshot) {
+    std::string src = testRoot + "/src";
+    std::filesystem::create_directories(src + "/nested");
+    createFile(src + "/top.txt", "top");
+    createFile(src + "/nested/inner.txt", "inner");
+
+    testing::internal::CaptureStdout();
+    {
+        Backup::BackupScheduler scheduler;
+        Backup::DebounceOptions debounce;
+        debounce.quietMs = 100;
+        debounce.minIntervalMs = 0;
+        int whole = scheduler.addRealtimeTask(src, testRoot + "/dst_whole", "whole", 5);
+        int again = scheduler.addRealtimeTask(src + "/", testRoot + "/dst_again", "again", 5);
+        int nested = scheduler.addRealtimeTask(src + "/nested", testRoot + "/dst_nested", "nested", 5);
+        for (int id : {whole, again, nested}) scheduler.setTaskDebounce(id, debounce);
+        scheduler.start();
+
+        // 只改动子目录之外的文件：嵌套任务不受影响
+        createFile(src + "/top.txt", "top changed");
+        for (int i = 0; i < 250 && Backup::BackupScheduler::listBackups(testRoot + "/dst_again", "again").empty(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        EXPECT_EQ(Backup::BackupScheduler::listBackups(testRoot + "/dst_whole", "whole").size(), 1u);
+        EXPECT_EQ(Backup::BackupScheduler::listBackups(testRoot + "/dst_again", "again").size(), 1u);
+        EXPECT_TRUE(Backup::BackupScheduler::listBackups(testRoot + "/dst_nested", "nested").empty());
+
+        // 子目录中的变化同时触发嵌套任务
+        createFile(src + "/nested/inner.txt", "inner changed");
+        for (int i = 0; i < 250 && Backup::BackupScheduler::listBackups(testRoot + "/dst_nested", "nested").empty(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        EXPECT_EQ(Backup::BackupScheduler::listBackups(testRoot + "/dst_nested", "nested").size(), 1u);
+        scheduler.stop();
+    }
+    std::string output = testing::internal::GetCapturedStdout();
+
+    size_t shared = 0;
+    for (size_t pos = output.find("Sharing snapshot"); pos != std::string::npos; pos = output.find("Sharing snapshot", pos + 1)) ++shared;
+    EXPECT_EQ(shared, 2u) << output;
+    EXPECT_FALSE(std::filesystem::exists(testRoot + "/dst_again/.again.index"));
+}
+
+// 9. 状态文件：重启后定时任务不重复运行，实时任务沿用增量链并发现停机期间的变化
+TEST_F(SchedulerTest, WarmRestartResumesState) {
+    std::string src = testRoot + "/src";
+    std::string stateFile = testRoot + "/scheduler.state";
+    createFile(src + "/a.txt", "a");
+    Backup::DebounceOptions debounce;
+    debounce.quietMs = 100;
+    debounce.minIntervalMs = 0;
+
+    testing::internal::CaptureStdout();
+    {
+        Backup::BackupScheduler scheduler;
+        EXPECT_EQ(scheduler.loadState(stateFile), 0u);
+        int sched = scheduler.addScheduledTask(src, testRoot + "/dst_sched", "sched", 3600, 10);
+        scheduler.setTaskPassword(sched, "secret");
+        int rt = scheduler.addRealtimeTask(src, testRoot + "/dst_rt", "rt", 10);
+        scheduler.setTaskDebounce(rt, debounce);
+        scheduler.start();
+        createFile(src + "/a.txt", "a changed");
+        for (int i = 0; i < 250 && (Backup::BackupScheduler::listBackups(testRoot + "/dst_sched", "sched").empty() ||
+                                    Backup::BackupScheduler::listBackups(testRoot + "/dst_rt", "rt").empty()); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        scheduler.stop();
+    }
+    ASSERT_EQ(Backup::BackupScheduler::listBackups(testRoot + "/dst_sched", "sched").size(), 1u);
+    ASSERT_EQ(Backup::BackupScheduler::listBackups(testRoot + "/dst_rt", "rt").size(), 1u);
+
+    // 停机期间的变化
+    createFile(src + "/b.txt", "b");
+
+    {
+        Backup::BackupScheduler scheduler;
+        ASSERT_EQ(scheduler.loadState(stateFile), 2u);
+        std::vector<Backup::TaskState> states = scheduler.taskStates();
+        ASSERT_EQ(states.size(), 2u);
+        EXPECT_EQ(states[0].intervalSeconds, 3600);
+        EXPECT_TRUE(std::filesystem::exists(states[0].lastArchive));
+        EXPECT_EQ(states[1].debounce.quietMs, 100);
+        // 密码不保存：加密任务必须重新设置非空密码
+        EXPECT_TRUE(states[0].encrypted);
+        EXPECT_THROW(scheduler.setTaskPassword(states[0].id, ""), std::runtime_error);
+        scheduler.setTaskPassword(states[0].id, "secret");
+        EXPECT_EQ(scheduler.addScheduledTask(src, testRoot + "/dst_new", "new", 3600, 10), 3);
+
+        scheduler.start();
+        for (int i = 0; i < 250 && Backup::BackupScheduler::listBackups(testRoot + "/dst_rt", "rt").size() < 2; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        scheduler.stop();
+    }
+    std::string output = testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(Backup::BackupScheduler::listBackups(testRoot + "/dst_sched", "sched").size(), 1u) << output;
+    std::vector<Backup::BackupFileEntry> rt = Backup::BackupScheduler::listBackups(testRoot + "/dst_rt", "rt");
+    ASSERT_EQ(rt.size(), 2u) << output;
+    EXPECT_TRUE(rt[1].delta) << output;
+}
+
+// 10. 运行时间超过间隔：默认策略等待下一个时间点，补跑策略依次追赶
+TEST(SchedulerOverlapTest, NextScheduledRunFollowsOverlapPolicy) {
+    using std::chrono::seconds;
+    using Backup::BackupScheduler;
+    const auto t0 = std::chrono::steady_clock::time_point() + std::chrono::hours(1);
+    Backup::OverlapOptions overlap;
+    uint64_t skipped = 0;
+
+    // 按时结束：下一次就是网格上的下一个时间点
+    EXPECT_EQ(BackupScheduler::nextScheduledRun(t0, t0 + seconds(5), 10, overlap, skipped), t0 + seconds(10));
+    EXPECT_EQ(BackupScheduler::nextScheduledRun(t0, t0 + seconds(10), 10, overlap, skipped), t0 + seconds(10));
+    EXPECT_EQ(skipped, 0u);
+
+    // COALESCE：错过的时间点全部合并，等待下一个未来的时间点
+    EXPECT_EQ(BackupScheduler::nextScheduledRun(t0, t0 + seconds(35), 10, overlap, skipped), t0 + seconds(40));
+    EXPECT_EQ(skipped, 3u);
+
+    // SKIP_IF_LATE：只在最近的时间点仍在最大延迟之内时补跑
+    overlap.policy = Backup::OverlapPolicy::SKIP_IF_LATE;
+    overlap.maxLagSeconds = 2;
+    skipped = 0;
+    EXPECT_EQ(BackupScheduler::nextScheduledRun(t0, t0 + seconds(31), 10, overlap, skipped), t0 + seconds(30));
+    EXPECT_EQ(skipped, 2u);
+    skipped = 0;
+    EXPECT_EQ(BackupScheduler::nextScheduledRun(t0, t0 + seconds(35), 10, overlap, skipped), t0 + seconds(40));
+    EXPECT_EQ(skipped, 3u);
+
+    // QUEUE：逐个补跑，只丢弃落后超过最大延迟的时间点
+    overlap.policy = Backup::OverlapPolicy::QUEUE;
+    overlap.maxLagSeconds = 15;
+    skipped = 0;
+    EXPECT_EQ(BackupScheduler::nextScheduledRun(t0, t0 + seconds(20), 10, overlap, skipped), t0 + seconds(10));
+    EXPECT_EQ(skipped, 0u);
+    EXPECT_EQ(BackupScheduler::nextScheduledRun(t0, t0 + seconds(40), 10, overlap, skipped), t0 + seconds(30));
+    EXPECT_EQ(skipped, 2u);
+}
+
+TEST_F(SchedulerTest, LateScheduledRunIsCoalesced) {
+    std::string src = testRoot + "/src";
+    createFile(src + "/big.dat", std::string(300 * 1024, 'x'));
+
+    // 限速使首次备份超过 1 秒的间隔，结束时至少错过一个时间点
+    Backup::ResourcePolicy slow;
+    slow.ioBytesPerSec = 200 * 1024;
+
+    Backup::ScheduleStats stats;
+    testing::internal::CaptureStdout();
+    {
+        Backup::BackupScheduler scheduler;
+        int id = scheduler.addScheduledTask(src, testRoot + "/dst", "coalesce", 1, 10);
+        scheduler.setTaskResourcePolicy(id, slow);
+        scheduler.start();
+        for (int i = 0; i < 100 && scheduler.scheduleStats(id).skippedRuns == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        stats = scheduler.scheduleStats(id);
+        scheduler.stop();
+    }
+    std::string output = testing::internal::GetCapturedStdout();
+
+    EXPECT_GE(stats.runs, 1u) << output;
+    EXPECT_GE(stats.skippedRuns, 1u) << output;
+    EXPECT_LT(stats.maxLagMs, 1000) << output;   // 不会在超时后紧接着补跑
+}
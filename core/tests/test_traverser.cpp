@@ -3,7 +3,11 @@
 #include <fstream>
 #include <string>
 #include <algorithm>
+#include <thread>
+#include <chrono>
+#include <sys/stat.h>
 #include "traverser.h"
+#include "name_cache.h"
 
 // 每次测试前创建环境，测试后清理环境
 class TraverserTest : public ::testing::Test {
@@ -136,3 +140,307 @@ TEST_F(TraverserTest, EmptyDirectory) {
     // 预期结果应为空
     EXPECT_EQ(results.size(), 0);
 }
+
+// 6. 排除规则在遍历时剪枝：被排除的目录不会被打开
+TEST_F(TraverserTest, ExcludeRulesPruneSubtrees) {
+    std::filesystem::create_directories(testRoot + "/node_modules/pkg");
+    createFile(testRoot + "/node_modules/pkg/index.js", "js");
+    std::filesystem::create_directories(testRoot + "/subdir/.cache");
+    createFile(testRoot + "/subdir/.cache/blob", "cache");
+    createFile(testRoot + "/subdir/keep.tmp", "keep");
+    createFile(testRoot + "/subdir/drop.tmp", "drop");
+
+    // 无法进入的目录：若没有剪枝，遍历会因 opendir 失败而抛出异常
+    std::filesystem::create_directories(testRoot + "/locked/.cache");
+    std::filesystem::permissions(testRoot + "/locked/.cache", std::filesystem::perms::none);
+
+    Backup::Filter filter;
+    filter.excludePatterns = {"node_modules/", ".cache", "*.tmp", "!keep.tmp", "/file_a.txt"};
+    Backup::TraverseOptions options;
+    options.filter = std::make_shared<const Backup::CompiledFilter>(filter);
+
+    Backup::Traverser traverser(options);
+    std::vector<Backup::FileInfo> results;
+    ASSERT_NO_THROW(results = traverser.traverse(testRoot));
+    std::filesystem::permissions(testRoot + "/locked/.cache", std::filesystem::perms::owner_all);
+
+    EXPECT_EQ(findByRelPath(results, "node_modules"), nullptr);
+    EXPECT_EQ(findByRelPath(results, "node_modules/pkg/index.js"), nullptr);
+    EXPECT_EQ(findByRelPath(results, "subdir/.cache"), nullptr);
+    EXPECT_EQ(findByRelPath(results, "subdir/drop.tmp"), nullptr);
+    EXPECT_EQ(findByRelPath(results, "file_a.txt"), nullptr);
+    EXPECT_NE(findByRelPath(results, "subdir/keep.tmp"), nullptr);
+    EXPECT_NE(findByRelPath(results, "subdir/file_b.log"), nullptr);
+    EXPECT_NE(findByRelPath(results, "locked"), nullptr);
+}
+
+// 7. 编译后的过滤器：关键词自动机、后缀集合与通配匹配
+TEST_F(TraverserTest, CompiledFilterMatching) {
+    Backup::KeywordMatcher keywords({"alpha", "(v1+2)", "he"});
+    EXPECT_TRUE(keywords.search("project_alpha_v1.code"));
+    EXPECT_TRUE(keywords.search("calc(v1+2).cpp"));
+    EXPECT_TRUE(keywords.search("ushers"));
+    EXPECT_FALSE(keywords.search("project_beta_v2.code"));
+
+    EXPECT_TRUE(Backup::globMatch("docs/**/*.md", "docs/a/b/readme.md"));
+    EXPECT_TRUE(Backup::globMatch("docs/**/*.md", "docs/readme.md"));
+    EXPECT_FALSE(Backup::globMatch("docs/*.md", "docs/a/readme.md"));
+    EXPECT_TRUE(Backup::globMatch("build-[0-9]?", "build-7x"));
+    EXPECT_FALSE(Backup::globMatch("build-[!0-9]", "build-7"));
+
+    Backup::Filter filter;
+    filter.suffixes = {".log", ".txt"};
+    filter.minSize = 2;
+    Backup::CompiledFilter compiled(filter);
+
+    Backup::FileInfo file;
+    file.type = Backup::FileType::REGULAR;
+    file.size = 10;
+    file.lastModified = 0;
+    file.relativePath = "subdir/file_b.log";
+    EXPECT_TRUE(compiled.matches(file));
+    file.relativePath = "subdir/file_b.bin";
+    EXPECT_FALSE(compiled.matches(file));
+    file.relativePath = "a.txt";
+    file.size = 1;
+    EXPECT_FALSE(compiled.matches(file));
+}
+
+// 8. 并行遍历与单线程遍历结果一致（包括顺序）
+TEST_F(TraverserTest, ParallelTraversalMatchesSerial) {
+    for (int i = 0; i < 8; ++i) {
+        std::string dir = testRoot + "/tree/d" + std::to_string(i);
+        for (int j = 0; j < 6; ++j) {
+            std::string sub = dir + "/s" + std::to_string(j);
+            std::filesystem::create_directories(sub);
+            for (int k = 0; k < 5; ++k) createFile(sub + "/f" + std::to_string(k), "x");
+        }
+    }
+
+    Backup::TraverseOptions serialOptions;
+    serialOptions.sortEntries = true;
+    auto serial = Backup::Traverser(serialOptions).traverse(testRoot);
+
+    Backup::TraverseOptions parallelOptions = serialOptions;
+    parallelOptions.threads = 8;
+    for (int run = 0; run < 3; ++run) {
+        auto parallel = Backup::Traverser(parallelOptions).traverse(testRoot);
+        ASSERT_EQ(parallel.size(), serial.size());
+        for (size_t i = 0; i < serial.size(); ++i) {
+            EXPECT_EQ(parallel[i].relativePath, serial[i].relativePath);
+        }
+    }
+
+    // 错误同样会被报告
+    parallelOptions.threads = 4;
+    EXPECT_THROW(Backup::Traverser(parallelOptions).traverse(testRoot + "/missing"), std::runtime_error);
+}
+
+// 9. 不 stat 目录时只返回路径与类型，文件元数据不受影响
+TEST_F(TraverserTest, SkipDirectoryStat) {
+    Backup::TraverseOptions options;
+    options.statDirectories = false;
+    auto results = Backup::Traverser(options).traverse(testRoot);
+
+    const Backup::FileInfo* dir = findByRelPath(results, "subdir");
+    ASSERT_NE(dir, nullptr);
+    EXPECT_EQ(dir->type, Backup::FileType::DIRECTORY);
+    EXPECT_EQ(dir->absolutePath, testRoot + "/subdir");
+
+    const Backup::FileInfo* file = findByRelPath(results, "subdir/file_b.log");
+    ASSERT_NE(file, nullptr);
+    EXPECT_EQ(file->size, 5u);
+    EXPECT_GT(file->lastModified, 0);
+}
+
+// 10. 用户名/组名缓存与延迟解析
+TEST_F(TraverserTest, NameResolutionCacheAndLazyMode) {
+    Backup::Traverser eager;
+    auto resolved = eager.traverse(testRoot);
+    const Backup::FileInfo* file = findByRelPath(resolved, "file_a.txt");
+    ASSERT_NE(file, nullptr);
+    EXPECT_FALSE(file->userName.empty());
+    EXPECT_EQ(Backup::NameCache::instance().userName(file->UID), file->userName);
+    EXPECT_EQ(Backup::NameCache::instance().groupName(file->GID), file->groupName);
+
+    Backup::TraverseOptions options;
+    options.resolveNames = false;
+    auto lazy = Backup::Traverser(options).traverse(testRoot);
+    const Backup::FileInfo* lazyFile = findByRelPath(lazy, "file_a.txt");
+    ASSERT_NE(lazyFile, nullptr);
+    EXPECT_TRUE(lazyFile->userName.empty());
+    EXPECT_TRUE(lazyFile->groupName.empty());
+}
+
+// 11. 紧凑文件列表与 FileInfo 列表内容一致，且占用更少内存
+TEST_F(TraverserTest, CompactFileListMatchesVector) {
+    std::filesystem::create_symlink("file_a.txt", testRoot + "/link_a");
+    for (int i = 0; i < 20; ++i) {
+        std::string dir = testRoot + "/tree/d" + std::to_string(i);
+        std::filesystem::create_directories(dir);
+        for (int k = 0; k < 20; ++k) createFile(dir + "/file_" + std::to_string(k) + ".dat", "x");
+    }
+
+    Backup::TraverseOptions options;
+    options.sortEntries = true;
+    Backup::Traverser traverser(options);
+    auto files = traverser.traverse(testRoot);
+    Backup::FileList list;
+    traverser.traverse(testRoot, list);
+
+    ASSERT_EQ(list.size(), files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        Backup::FileInfo info = list.at(i);
+        EXPECT_EQ(info.relativePath, files[i].relativePath);
+        EXPECT_EQ(info.absolutePath, files[i].absolutePath);
+        EXPECT_EQ(info.type, files[i].type);
+        EXPECT_EQ(info.size, files[i].size);
+        EXPECT_EQ(info.lastModified, files[i].lastModified);
+        EXPECT_EQ(info.permissions, files[i].permissions);
+        EXPECT_EQ(info.UID, files[i].UID);
+        EXPECT_EQ(info.GID, files[i].GID);
+        EXPECT_EQ(info.userName, files[i].userName);
+        EXPECT_EQ(info.groupName, files[i].groupName);
+        EXPECT_EQ(info.linkTarget, files[i].linkTarget);
+        EXPECT_EQ(info.deviceMajor, files[i].deviceMajor);
+        EXPECT_EQ(info.deviceMinor, files[i].deviceMinor);
+        EXPECT_EQ(info.inode, files[i].inode);
+        EXPECT_EQ(info.mtimeNs, files[i].mtimeNs);
+        EXPECT_EQ(info.ctimeNs, files[i].ctimeNs);
+    }
+
+    size_t vectorBytes = files.capacity() * sizeof(Backup::FileInfo);
+    for (const auto& f : files) {
+        vectorBytes += f.relativePath.capacity() + f.absolutePath.capacity() + f.userName.capacity() + f.groupName.capacity();
+    }
+    EXPECT_LT(list.memoryUsage() * 3, vectorBytes);
+
+    // 前缀只影响相对路径
+    list.setPathPrefix("root");
+    EXPECT_EQ(list.relativePath(0), "root/" + files[0].relativePath);
+    EXPECT_EQ(list.absolutePath(0), files[0].absolutePath);
+
+    // 过滤掉目录时，其中保留的文件路径不变
+    Backup::FileList filtered = list.filter([](const Backup::FileInfo& f) { return f.type != Backup::FileType::DIRECTORY; });
+    size_t regular = 0;
+    for (const auto& f : files) regular += (f.type != Backup::FileType::DIRECTORY);
+    ASSERT_EQ(filtered.size(), regular);
+    std::vector<std::string> expected;
+    for (const auto& f : files) {
+        if (f.type != Backup::FileType::DIRECTORY) expected.push_back("root/" + f.relativePath);
+    }
+    for (size_t i = 0; i < filtered.size(); ++i) EXPECT_EQ(filtered.relativePath(i), expected[i]);
+}
+
+// 12. 流式遍历：访问者按先序收到与列表相同的条目，访问者的异常会停止遍历
+TEST_F(TraverserTest, StreamingVisitor) {
+    for (int i = 0; i < 10; ++i) {
+        std::string dir = testRoot + "/stream/d" + std::to_string(i);
+        std::filesystem::create_directories(dir + "/inner");
+        for (int k = 0; k < 10; ++k) createFile(dir + "/inner/f" + std::to_string(k), "x");
+    }
+
+    for (unsigned int threads : {1u, 6u}) {
+        Backup::TraverseOptions options;
+        options.sortEntries = true;
+        options.threads = threads;
+        Backup::Traverser traverser(options);
+        auto expected = traverser.traverse(testRoot);
+
+        std::vector<std::string> visited;
+        std::thread::id caller = std::this_thread::get_id();
+        bool sameThread = true;
+        traverser.traverse(testRoot, [&](Backup::FileInfo& info) {
+            sameThread = sameThread && std::this_thread::get_id() == caller;
+            visited.push_back(std::move(info.relativePath));
+        });
+        EXPECT_TRUE(sameThread);
+        ASSERT_EQ(visited.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) EXPECT_EQ(visited[i], expected[i].relativePath);
+
+        size_t count = 0;
+        EXPECT_THROW(traverser.traverse(testRoot, [&](Backup::FileInfo&) {
+            if (++count == 5) throw std::runtime_error("stop");
+        }), std::runtime_error);
+        EXPECT_EQ(count, 5u);
+    }
+}
+
+// 13. 不跨越文件系统 / 按类型排除文件系统（依赖 /dev/pts 是独立的挂载点）
+TEST_F(TraverserTest, FileSystemBoundaries) {
+    Backup::TraverseOptions options;
+    options.excludeFsTypes = {"no_such_fs"};
+    EXPECT_THROW(Backup::Traverser(options).traverse(testRoot), std::runtime_error);
+
+    // 普通目录树不受影响
+    options.excludeFsTypes = Backup::Traverser::pseudoFileSystems();
+    options.oneFileSystem = true;
+    EXPECT_EQ(Backup::Traverser(options).traverse(testRoot).size(), Backup::Traverser().traverse(testRoot).size());
+
+    struct stat devStat, ptsStat;
+    if (stat("/dev", &devStat) != 0 || stat("/dev/pts", &ptsStat) != 0 || devStat.st_dev == ptsStat.st_dev) {
+        GTEST_SKIP() << "/dev/pts is not a separate mount";
+    }
+    auto underPts = [](const std::vector<Backup::FileInfo>& files) {
+        bool mountPoint = false;
+        size_t inside = 0;
+        for (const auto& f : files) {
+            if (f.relativePath == "pts") mountPoint = true;
+            if (f.relativePath.rfind("pts/", 0) == 0) ++inside;
+        }
+        EXPECT_TRUE(mountPoint);
+        return inside;
+    };
+
+    for (unsigned int threads : {1u, 4u}) {
+        Backup::TraverseOptions oneFs;
+        oneFs.threads = threads;
+        oneFs.oneFileSystem = true;
+        EXPECT_EQ(underPts(Backup::Traverser(oneFs).traverse("/dev")), 0u);
+
+        Backup::TraverseOptions byType;
+        byType.threads = threads;
+        byType.excludeFsTypes = {"devpts"};
+        EXPECT_EQ(underPts(Backup::Traverser(byType).traverse("/dev")), 0u);
+        EXPECT_GT(underPts(Backup::Traverser().traverse("/dev")), 0u);
+    }
+}
+
+// 14. 并行遍历的预读有界：访问者很慢时，已扫描未输出的条目不超过上限加正在扫描的目录
+TEST_F(TraverserTest, ParallelScanAheadIsBounded) {
+    const size_t perDir = 20;
+    for (int i = 0; i < 40; ++i) {
+        std::string dir = testRoot + "/wide/d" + std::to_string(i);
+        std::filesystem::create_directories(dir);
+        for (size_t k = 0; k < perDir; ++k) createFile(dir + "/f" + std::to_string(k), "x");
+    }
+
+    Backup::TraverseOptions options;
+    options.sortEntries = true;
+    auto expected = Backup::Traverser(options).traverse(testRoot);
+
+    options.threads = 4;
+    options.maxBufferedEntries = 50;
+    Backup::Traverser traverser(options);
+    std::vector<std::string> visited;
+    traverser.traverse(testRoot, [&](Backup::FileInfo& info) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        visited.push_back(std::move(info.relativePath));
+    });
+
+    ASSERT_EQ(visited.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) EXPECT_EQ(visited[i], expected[i].relativePath);
+    // 每个线程至多在达到上限前领取一个目录，调用线程自行扫描时再多一个
+    size_t largestDir = 40;     // wide/ 下有 40 个子目录
+    EXPECT_GT(traverser.peakBufferedEntries(), 0u);
+    EXPECT_LE(traverser.peakBufferedEntries(), options.maxBufferedEntries + (options.threads + 1) * largestDir);
+    EXPECT_LT(traverser.peakBufferedEntries(), expected.size() / 2);
+
+    // 不限时整棵树都可能被预读
+    options.maxBufferedEntries = 0;
+    Backup::Traverser unbounded(options);
+    unbounded.traverse(testRoot, [&](Backup::FileInfo&) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    });
+    EXPECT_GT(unbounded.peakBufferedEntries(), traverser.peakBufferedEntries());
+}
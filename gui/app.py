@@ -27,7 +27,7 @@ from PyQt6.QtWidgets import (QApplication, QMainWindow, QWidget, QVBoxLayout,
                              QHBoxLayout, QLabel, QLineEdit, QPushButton, 
                              QTabWidget, QFileDialog, QComboBox, QCheckBox, 
                              QGroupBox, QProgressBar, QMessageBox, QDateEdit,
-                             QSpinBox, QTextEdit)
+                             QSpinBox, QTextEdit, QInputDialog)
 from PyQt6.QtCore import Qt, QThread, pyqtSignal, QDate
 
 # --- 样式表 (美化) ---
@@ -130,6 +130,13 @@ class MainWindow(QMainWindow):
 
         self.backup_system = core.BackupSystem()
         self.scheduler = core.BackupScheduler() 
+        # 从状态文件恢复上次的计划任务（密码不保存，加密任务需重新输入）
+        state_dir = os.path.join(os.path.expanduser("~"), ".filebackup")
+        os.makedirs(state_dir, exist_ok=True)
+        try:
+            self.scheduler.loadState(os.path.join(state_dir, "scheduler.state"))
+        except Exception as e:
+            print(f"[Init] Failed to load scheduler state: {e}")
         self.scheduler.start() 
         
         # 主布局
@@ -403,6 +410,7 @@ class MainWindow(QMainWindow):
         self.log_area = QTextEdit()
         self.log_area.setReadOnly(True)
         self.log_area.append("调度器已就绪。")
+        self.restore_scheduled_tasks()
         layout.addWidget(QLabel("任务运行日志:"))
         layout.addWidget(self.log_area)
 
@@ -527,6 +535,18 @@ class MainWindow(QMainWindow):
         self.scheduler.setTaskPassword(task_id, pwd)
         self.scheduler.setTaskCompressionAlgorithm(task_id, algo)
 
+    def restore_scheduled_tasks(self):
+        for t in self.scheduler.taskStates():
+            mode = "实时监控" if t.realtime else f"定时 (每 {t.intervalSeconds} 秒)"
+            self.log_area.append(f"恢复任务 ID: {t.id} [{mode}] {t.srcDir} -> {t.dstDir}")
+            if t.encrypted:
+                pwd, ok = QInputDialog.getText(self, "加密任务", f"请输入任务 {t.id} 的密码:",
+                                               QLineEdit.EchoMode.Password)
+                if ok and pwd:
+                    self.scheduler.setTaskPassword(t.id, pwd)
+                else:
+                    self.log_area.append(f"   任务 {t.id} 未输入密码，暂停执行")
+
     def start_worker(self, task, *args):
         self.lock_ui(True)
         self.status_label.setText(f"Status: Running {task}...")